@@ -0,0 +1,87 @@
+// Times TextSanitizer::escapeHtml against the five QString::replace passes it
+// replaced, and TextSanitizer::sanitize on its own, over a few kinds of chat
+// text.
+//
+//   kickchat-sanitizer-bench [iterations]
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <cstdio>
+#include "textsanitizer.h"
+
+namespace {
+// The escaping the overlay used before TextSanitizer
+QString escapeHtmlReplace(const QString& text)
+{
+    QString escaped = text;
+    escaped.replace("&", "&amp;");
+    escaped.replace("<", "&lt;");
+    escaped.replace(">", "&gt;");
+    escaped.replace("\"", "&quot;");
+    escaped.replace("'", "&#39;");
+    return escaped;
+}
+
+struct Corpus {
+    const char* name;
+    QStringList messages;
+};
+
+QList<Corpus> corpora()
+{
+    QList<Corpus> list;
+    list.append({ "plain", {
+        "lets go", "that was insane", "W stream", "what game is this", "gg",
+        "can you play the new map next round please", "first time here, hello everyone"
+    } });
+    list.append({ "markup", {
+        "<3 <3 <3", "you're cracked", "Q&A when?", "he said \"no way\"", "a > b && b > c"
+    } });
+    list.append({ "unicode", {
+        QString::fromUtf8("\xF0\x9F\x98\x82\xF0\x9F\x98\x82\xF0\x9F\x98\x82 lol"),
+        QString::fromUtf8("\xE3\x81\x93\xE3\x82\x93\xE3\x81\xAB\xE3\x81\xA1\xE3\x81\xAF"),
+        QString::fromUtf8("\xD9\x85\xD8\xB1\xD8\xAD\xD8\xA8\xD8\xA7 \xF0\x9F\x91\x8B\xF0\x9F\x8F\xBD"),
+        QString::fromUtf8("caf\xC3\xA9 na\xC3\xAFve")
+    } });
+    list.append({ "spam", {
+        QString(200, 'A'),
+        QString(60, 'x') + " " + QString(60, 'y'),
+        QString::fromUtf8("\xF0\x9F\x94\xA5").repeated(80)
+    } });
+    return list;
+}
+
+// Nanoseconds per message; the checksum keeps the calls from being optimized away
+template <typename Function>
+double timePerMessage(const QStringList& messages, int iterations, Function function, qint64* checksum)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        for (const QString& message : messages) {
+            *checksum += function(message).size();
+        }
+    }
+    return double(timer.nsecsElapsed()) / (qint64(iterations) * messages.size());
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    int iterations = args.size() > 1 ? qMax(1, args.at(1).toInt()) : 200000;
+
+    qint64 checksum = 0;
+    std::printf("%-8s %14s %14s %8s %14s\n", "corpus", "replace ns", "escapeHtml ns", "speedup", "sanitize ns");
+    for (const Corpus& corpus : corpora()) {
+        double replace = timePerMessage(corpus.messages, iterations, escapeHtmlReplace, &checksum);
+        double escape = timePerMessage(corpus.messages, iterations,
+                                       [](const QString& text) { return TextSanitizer::escapeHtml(text); }, &checksum);
+        double sanitize = timePerMessage(corpus.messages, iterations,
+                                         [](const QString& text) { return TextSanitizer::sanitize(text); }, &checksum);
+        std::printf("%-8s %14.1f %14.1f %7.2fx %14.1f\n", corpus.name, replace, escape, replace / escape, sanitize);
+    }
+    std::printf("(checksum %lld)\n", checksum);
+    return 0;
+}
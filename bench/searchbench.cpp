@@ -0,0 +1,104 @@
+// Times ChatSearchIndex::search over a synthetic session: term, prefix, from:
+// and time range queries against millions of indexed messages.
+//
+//   kickchat-search-bench [messages] [queries]
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QStringList>
+#include <cstdio>
+#include "chatsearchindex.h"
+
+namespace {
+const qint64 BaseMs = 1700000000000LL;
+
+// A few hundred words with a skewed frequency, like chat
+QStringList vocabulary()
+{
+    QStringList words = { "lol", "gg", "w", "lets", "go", "nice", "what", "game", "is", "this", "the", "chat",
+                          "hello", "everyone", "clip", "that", "insane", "pog", "first", "time", "here" };
+    for (int i = 0; i < 400; ++i) {
+        words.append(QString("word%1").arg(i));
+    }
+    return words;
+}
+
+// Deterministic so runs compare
+quint32 nextRandom(quint32* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+struct Query {
+    const char* name;
+    QString text;
+    QDateTime from;
+    QDateTime to;
+};
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    int messageCount = args.size() > 1 ? qMax(1, args.at(1).toInt()) : 2000000;
+    int queryCount = args.size() > 2 ? qMax(1, args.at(2).toInt()) : 200;
+
+    QStringList words = vocabulary();
+    ChatSearchIndex index;
+    QEventLoop loop;
+    QObject::connect(&index, &ChatSearchIndex::indexUpdated, &loop, [&](int documentCount) {
+        if (documentCount >= messageCount) {
+            loop.quit();
+        }
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    quint32 state = 1;
+    for (int i = 0; i < messageCount; ++i) {
+        QStringList text;
+        int length = 2 + nextRandom(&state) % 8;
+        for (int w = 0; w < length; ++w) {
+            // Squaring skews towards the front of the vocabulary
+            quint32 r = nextRandom(&state) % 1000;
+            text.append(words.at(int(r * r / 1000 * words.size() / 1000)));
+        }
+        index.addMessage(ChatMessage(QString("viewer%1").arg(nextRandom(&state) % 5000), text.join(' '), 0,
+                                     QDateTime::fromMSecsSinceEpoch(BaseMs + i * 50LL)));
+    }
+    loop.exec();
+    std::printf("indexed %d messages in %lld ms, about %lld MB\n", messageCount, timer.elapsed(),
+                index.memoryUsage() / (1024 * 1024));
+
+    QDateTime middle = QDateTime::fromMSecsSinceEpoch(BaseMs + messageCount / 2 * 50LL);
+    QList<Query> queries = {
+        { "common term", "lol", {}, {} },
+        { "rare term", "word399", {}, {} },
+        { "two terms", "lol gg", {}, {} },
+        { "short prefix", "w*", {}, {} },
+        { "long prefix", "word3*", {}, {} },
+        { "from:", "from:viewer42", {}, {} },
+        { "from: prefix", "from:viewer4*", {}, {} },
+        { "prefix + term", "word1* chat", {}, {} },
+        { "older half", "word2*", {}, middle },
+        { "one minute", "lol", middle, middle.addSecs(60) },
+        { "no match", "lol zzz", {}, {} },
+    };
+
+    qint64 checksum = 0;
+    std::printf("%-14s %12s %8s\n", "query", "us/query", "hits");
+    for (const Query& query : queries) {
+        int hits = 0;
+        timer.restart();
+        for (int i = 0; i < queryCount; ++i) {
+            QList<quint32> results = index.search(query.text, query.from, query.to);
+            hits = results.size();
+            checksum += results.isEmpty() ? 0 : results.first();
+        }
+        std::printf("%-14s %12.1f %8d\n", query.name, timer.nsecsElapsed() / 1000.0 / queryCount, hits);
+    }
+    std::printf("(checksum %lld)\n", checksum);
+    return 0;
+}
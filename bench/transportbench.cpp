@@ -0,0 +1,301 @@
+// Replays a chat session through both transports over a local connection and
+// reports bytes on the wire and client-side CPU for each.
+//
+//   kickchat-transport-bench [frames.txt] [repeat]
+//
+// frames.txt holds raw Pusher frames, one per line (the --replay format, e.g.
+// recorded with a logging proxy). Without one, a synthetic session of
+// ChatMessageEvent frames is generated. The server pre-frames (and for
+// permessage-deflate pre-compresses) everything before the clock starts and
+// runs on its own thread, so the CPU figure is the receiving side only.
+#include <QCoreApplication>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QEventLoop>
+#include <QTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QAtomicInteger>
+#include <QDebug>
+#include <cstdio>
+#include <cstring>
+#include <zlib.h>
+#include "chattransport.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+const char* const AcceptGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+qint64 threadCpuNsecs()
+{
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    auto toNsecs = [](const FILETIME& time) {
+        return ((qint64(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+    };
+    return toNsecs(kernel) + toNsecs(user);
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+QByteArray frameHeader(int length, bool rsv1)
+{
+    QByteArray header;
+    header.append(static_cast<char>(0x80 | (rsv1 ? 0x40 : 0) | 0x1));
+    if (length < 126) {
+        header.append(static_cast<char>(length));
+    } else if (length < 65536) {
+        header.append(static_cast<char>(126));
+        header.append(static_cast<char>(length >> 8));
+        header.append(static_cast<char>(length & 0xFF));
+    } else {
+        header.append(static_cast<char>(127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            header.append(static_cast<char>((quint64(length) >> shift) & 0xFF));
+        }
+    }
+    return header;
+}
+
+QList<QByteArray> syntheticSession(int count)
+{
+    static const char* const Users[] = { "alice", "bob_the_builder", "xX_sniper_Xx", "mod_kate", "lurker42" };
+    static const char* const Lines[] = {
+        "KEKW", "that was insane", "LUL LUL LUL", "first time here, love the stream",
+        "[emote:37226:KEKW] [emote:37226:KEKW]", "gg", "who else is watching from Germany?",
+        "can you play the new map next?", "W", "chat is moving so fast nobody will see this"
+    };
+
+    QList<QByteArray> frames;
+    for (int i = 0; i < count; ++i) {
+        QJsonObject sender;
+        sender["id"] = 1000 + i % 5;
+        sender["username"] = Users[i % 5];
+        sender["identity"] = QJsonObject{{"color", "#FF9D00"}, {"badges", QJsonArray()}};
+
+        QJsonObject data;
+        data["id"] = QString("6f1c2b8e-0000-4000-8000-%1").arg(i, 12, 10, QChar('0'));
+        data["chatroom_id"] = 668;
+        data["content"] = Lines[(i * 7) % 10];
+        data["type"] = "message";
+        data["created_at"] = "2024-05-01T20:00:00+00:00";
+        data["sender"] = sender;
+
+        QJsonObject event;
+        event["event"] = "App\\Events\\ChatMessageEvent";
+        event["data"] = QString::fromUtf8(QJsonDocument(data).toJson(QJsonDocument::Compact));
+        event["channel"] = "chatrooms.668.v2";
+        frames.append(QJsonDocument(event).toJson(QJsonDocument::Compact));
+    }
+    return frames;
+}
+
+// Minimal WebSocket server: answers the upgrade (with permessage-deflate when
+// asked) and writes the whole pre-built session
+class BenchServer : public QObject {
+public:
+    BenchServer(const QList<QByteArray>& frames)
+    {
+        z_stream deflater;
+        std::memset(&deflater, 0, sizeof(deflater));
+        deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+        QByteArray compressed;
+        for (const QByteArray& frame : frames) {
+            m_plain += frameHeader(frame.size(), false) + frame;
+
+            compressed.resize(static_cast<int>(deflateBound(&deflater, frame.size())) + 16);
+            deflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(frame.constData()));
+            deflater.avail_in = static_cast<uInt>(frame.size());
+            deflater.next_out = reinterpret_cast<Bytef*>(compressed.data());
+            deflater.avail_out = static_cast<uInt>(compressed.size());
+            deflate(&deflater, Z_SYNC_FLUSH);
+            int length = compressed.size() - static_cast<int>(deflater.avail_out) - 4; // Strip 00 00 ff ff
+            m_deflated += frameHeader(length, true) + compressed.left(length);
+        }
+        deflateEnd(&deflater);
+
+        QObject::connect(&m_server, &QTcpServer::newConnection, this, [this]() {
+            QTcpSocket* socket = m_server.nextPendingConnection();
+            QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            QObject::connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onRequest(socket); });
+        });
+    }
+
+    quint16 listen()
+    {
+        m_server.listen(QHostAddress::LocalHost);
+        return m_server.serverPort();
+    }
+
+    qint64 lastWireBytes() const { return m_lastWireBytes; }
+
+private:
+    QTcpServer m_server;
+    QByteArray m_plain;
+    QByteArray m_deflated;
+    QAtomicInteger<qint64> m_lastWireBytes;
+
+    void onRequest(QTcpSocket* socket)
+    {
+        QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+        socket->setProperty("request", request);
+        if (!request.contains("\r\n\r\n") || socket->property("answered").toBool()) {
+            return;
+        }
+        socket->setProperty("answered", true);
+
+        QByteArray key;
+        bool deflate = false;
+        for (const QByteArray& line : request.split('\n')) {
+            QByteArray lower = line.trimmed().toLower();
+            if (lower.startsWith("sec-websocket-key:")) {
+                key = line.mid(line.indexOf(':') + 1).trimmed();
+            } else if (lower.startsWith("sec-websocket-extensions:") && lower.contains("permessage-deflate")) {
+                deflate = true;
+            }
+        }
+
+        QByteArray response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n";
+        response += "Sec-WebSocket-Accept: "
+            + QCryptographicHash::hash(key + AcceptGuid, QCryptographicHash::Sha1).toBase64() + "\r\n";
+        if (deflate) {
+            response += "Sec-WebSocket-Extensions: permessage-deflate\r\n";
+        }
+        response += "\r\n";
+
+        const QByteArray& session = deflate ? m_deflated : m_plain;
+        socket->write(response);
+        socket->write(session);
+        m_lastWireBytes.storeRelaxed(response.size() + session.size());
+    }
+};
+
+struct Result {
+    qint64 wallNsecs;
+    qint64 cpuNsecs;
+    qint64 wireBytes;
+    qint64 messageBytes;
+    int messages;
+};
+
+bool run(ChatTransport::Kind kind, const QUrl& url, int expected, BenchServer* server, Result* result)
+{
+    ChatTransport* transport = ChatTransport::create(kind);
+    QEventLoop loop;
+    int received = 0;
+    qint64 messageBytes = 0;
+    bool failed = false;
+
+    QObject::connect(transport, &ChatTransport::frameReceived, &loop, [&](const QByteArray& frame) {
+        messageBytes += frame.size();
+        if (++received == expected) {
+            loop.quit();
+        }
+    });
+    QObject::connect(transport, &ChatTransport::errorOccurred, &loop, [&](const QString& message) {
+        qWarning().noquote() << "Transport error:" << message;
+        failed = true;
+        loop.quit();
+    });
+    QTimer::singleShot(120000, &loop, [&]() {
+        qWarning("Timed out");
+        failed = true;
+        loop.quit();
+    });
+
+    QElapsedTimer wall;
+    wall.start();
+    qint64 cpuStart = threadCpuNsecs();
+    transport->open(url);
+    loop.exec();
+
+    result->cpuNsecs = threadCpuNsecs() - cpuStart;
+    result->wallNsecs = wall.nsecsElapsed();
+    result->wireBytes = server->lastWireBytes();
+    result->messageBytes = messageBytes;
+    result->messages = received;
+
+    transport->close();
+    delete transport;
+    return !failed;
+}
+
+void print(const char* name, const Result& result)
+{
+    std::printf("%-8s %8d msgs %12lld wire bytes %12lld message bytes %6.1f%% %9.1f ms wall %9.1f ms cpu %7.0f ns/msg\n",
+                name, result.messages, result.wireBytes, result.messageBytes,
+                100.0 * result.wireBytes / qMax<qint64>(1, result.messageBytes),
+                result.wallNsecs / 1e6, result.cpuNsecs / 1e6,
+                double(result.cpuNsecs) / qMax(1, result.messages));
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+
+    QList<QByteArray> frames;
+    if (args.size() > 1) {
+        QFile file(args.at(1));
+        if (!file.open(QIODevice::ReadOnly)) {
+            qCritical().noquote() << "Cannot open" << args.at(1) << ":" << file.errorString();
+            return 1;
+        }
+        for (const QByteArray& line : file.readAll().split('\n')) {
+            if (!line.trimmed().isEmpty()) {
+                frames.append(line.trimmed());
+            }
+        }
+    } else {
+        std::printf("No session file given, using a synthetic session\n");
+        frames = syntheticSession(5000);
+    }
+
+    int repeat = args.size() > 2 ? qMax(1, args.at(2).toInt()) : 1;
+    QList<QByteArray> session;
+    for (int i = 0; i < repeat; ++i) {
+        session += frames;
+    }
+
+    QThread serverThread;
+    BenchServer* server = new BenchServer(session);
+    server->moveToThread(&serverThread);
+    QObject::connect(&serverThread, &QThread::finished, server, &QObject::deleteLater);
+    serverThread.start();
+
+    quint16 port = 0;
+    QMetaObject::invokeMethod(server, [server, &port]() { port = server->listen(); }, Qt::BlockingQueuedConnection);
+    QUrl url(QString("ws://127.0.0.1:%1/").arg(port));
+
+    Result qt;
+    Result deflate;
+    bool ok = run(ChatTransport::QtWebSocket, url, session.size(), server, &qt)
+        && run(ChatTransport::DeflateWebSocket, url, session.size(), server, &deflate);
+
+    serverThread.quit();
+    serverThread.wait();
+
+    if (!ok) {
+        return 1;
+    }
+
+    print("qt", qt);
+    print("deflate", deflate);
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "admissioncontroller.h"
+
+namespace {
+const double MinRate = 2.0;       // Never sample ordinary chat below this many rows/s
+const double BurstSeconds = 1.0;  // Token bucket depth, in seconds of admitted rate
+const double DecreaseFactor = 0.7;
+const double IncreaseStep = 1.0;
+const qint64 RateWindowMs = 1000;
+}
+
+AdmissionController::AdmissionController()
+    : m_maxRate(20)
+    , m_renderBudget(0.25)
+    , m_rate(20.0)
+    , m_tokens(20.0)
+    , m_lastRefillMs(-1)
+    , m_windowStartMs(-1)
+    , m_windowArrivals(0)
+    , m_windowSuppressed(0)
+    , m_arrivalRate(0.0)
+    , m_suppressedLastWindow(0)
+    , m_suppressedTotal(0)
+{
+}
+
+void AdmissionController::setMaxRate(int messagesPerSecond)
+{
+    m_maxRate = qMax(1, messagesPerSecond);
+    m_rate = qMin(m_rate, static_cast<double>(m_maxRate));
+    if (m_rate < MinRate) {
+        m_rate = qMin(MinRate, static_cast<double>(m_maxRate));
+    }
+}
+
+int AdmissionController::maxRate() const
+{
+    return m_maxRate;
+}
+
+void AdmissionController::setRenderBudget(double fraction)
+{
+    m_renderBudget = qBound(0.05, fraction, 1.0);
+}
+
+bool AdmissionController::admit(const ChatMessage& message, qint64 nowMs)
+{
+    rollWindow(nowMs);
+    refill(nowMs);
+    ++m_windowArrivals;
+
+    if (isPriority(message)) {
+        // Priority rows always show, but they still eat into the budget
+        m_tokens = qMax(m_tokens - 1.0, -m_rate * BurstSeconds);
+        return true;
+    }
+
+    if (m_tokens >= 1.0) {
+        m_tokens -= 1.0;
+        return true;
+    }
+
+    ++m_windowSuppressed;
+    ++m_suppressedTotal;
+    return false;
+}
+
+void AdmissionController::recordFrame(qint64 renderNs, int intervalMs)
+{
+    double budgetNs = intervalMs * 1e6 * m_renderBudget;
+
+    if (renderNs > budgetNs) {
+        m_rate = qMax(MinRate, m_rate * DecreaseFactor);
+    } else if (renderNs < budgetNs / 2) {
+        m_rate = qMin(static_cast<double>(m_maxRate), m_rate + IncreaseStep);
+    }
+}
+
+void AdmissionController::tick(qint64 nowMs)
+{
+    rollWindow(nowMs);
+}
+
+bool AdmissionController::isPriority(const ChatMessage& message)
+{
+    return message.isHighlighted() ||
+           (message.roles() & (ChatMessage::Broadcaster | ChatMessage::Moderator));
+}
+
+bool AdmissionController::isThrottling() const
+{
+    return m_windowSuppressed > 0 || m_suppressedLastWindow > 0;
+}
+
+double AdmissionController::arrivalRate() const
+{
+    return m_arrivalRate;
+}
+
+double AdmissionController::admitRate() const
+{
+    return m_rate;
+}
+
+quint64 AdmissionController::suppressedCount() const
+{
+    return m_suppressedTotal;
+}
+
+quint64 AdmissionController::suppressedRecently() const
+{
+    return m_suppressedLastWindow + m_windowSuppressed;
+}
+
+void AdmissionController::refill(qint64 nowMs)
+{
+    if (m_lastRefillMs < 0 || nowMs < m_lastRefillMs) {
+        m_lastRefillMs = nowMs;
+        return;
+    }
+
+    m_tokens = qMin(m_tokens + (nowMs - m_lastRefillMs) * m_rate / 1000.0, m_rate * BurstSeconds);
+    m_lastRefillMs = nowMs;
+}
+
+void AdmissionController::rollWindow(qint64 nowMs)
+{
+    if (m_windowStartMs < 0) {
+        m_windowStartMs = nowMs;
+        return;
+    }
+
+    qint64 elapsed = nowMs - m_windowStartMs;
+    if (elapsed < RateWindowMs) {
+        return;
+    }
+
+    // Smooth the arrival rate so a single quiet second does not reset it
+    double windowRate = m_windowArrivals * 1000.0 / elapsed;
+    m_arrivalRate = m_arrivalRate * 0.5 + windowRate * 0.5;
+    m_suppressedLastWindow = elapsed < 2 * RateWindowMs ? m_windowSuppressed : 0;
+
+    m_windowStartMs = nowMs;
+    m_windowArrivals = 0;
+    m_windowSuppressed = 0;
+}
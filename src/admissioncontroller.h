@@ -0,0 +1,61 @@
+#ifndef ADMISSIONCONTROLLER_H
+#define ADMISSIONCONTROLLER_H
+
+#include <QtGlobal>
+#include "chatmessage.h"
+
+// Decides which new chat rows get on screen when chat arrives faster than the
+// overlay can render or anyone can read it.
+//
+// Ordinary messages pass through a token bucket whose rate adapts to the
+// measured render cost (multiplicative decrease when a frame blows the budget,
+// additive increase otherwise) and never exceeds the configured readable rate.
+// Because tokens refill evenly, the admitted subset is an even sample of the
+// flood. Priority messages (broadcaster, moderators, highlights and mentions)
+// are always admitted and only borrow from the ordinary budget.
+class AdmissionController {
+public:
+    AdmissionController();
+
+    void setMaxRate(int messagesPerSecond);
+    int maxRate() const;
+
+    // Fraction of each display tick that rendering may use before admission backs off
+    void setRenderBudget(double fraction);
+
+    bool admit(const ChatMessage& message, qint64 nowMs);
+    void recordFrame(qint64 renderNs, int intervalMs);
+
+    // Lets rate estimates decay while no messages arrive
+    void tick(qint64 nowMs);
+
+    static bool isPriority(const ChatMessage& message);
+
+    bool isThrottling() const;
+    double arrivalRate() const;
+    // Ordinary rows per second the render budget currently allows
+    double admitRate() const;
+    quint64 suppressedCount() const;
+    quint64 suppressedRecently() const;
+
+private:
+    int m_maxRate;
+    double m_renderBudget;
+    double m_rate;
+    double m_tokens;
+    qint64 m_lastRefillMs;
+
+    // Per-second rate estimation
+    qint64 m_windowStartMs;
+    int m_windowArrivals;
+    quint64 m_windowSuppressed;
+    double m_arrivalRate;
+    quint64 m_suppressedLastWindow;
+
+    quint64 m_suppressedTotal;
+
+    void refill(qint64 nowMs);
+    void rollWindow(qint64 nowMs);
+};
+
+#endif // ADMISSIONCONTROLLER_H
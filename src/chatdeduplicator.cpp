@@ -0,0 +1,127 @@
+#include "chatdeduplicator.h"
+
+namespace {
+const quint64 FnvOffsetBasis = 14695981039346656037ULL;
+const quint64 FnvPrime = 1099511628211ULL;
+
+inline quint64 fnvAppend(quint64 hash, quint64 value)
+{
+    return (hash ^ value) * FnvPrime;
+}
+}
+
+ChatDeduplicator::ChatDeduplicator()
+    : m_windowSeconds(10)
+{
+}
+
+void ChatDeduplicator::setWindow(int seconds)
+{
+    m_windowSeconds = qMax(0, seconds);
+    if (m_windowSeconds == 0) {
+        clear();
+    }
+}
+
+int ChatDeduplicator::window() const
+{
+    return m_windowSeconds;
+}
+
+qint64 ChatDeduplicator::find(quint64 key, qint64 timestampMs)
+{
+    if (m_windowSeconds <= 0 || key == 0) {
+        return -1;
+    }
+
+    expire(timestampMs);
+
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return -1;
+    }
+
+    it->lastSeenMs = qMax(it->lastSeenMs, timestampMs);
+    return it->sequence;
+}
+
+void ChatDeduplicator::remember(quint64 key, qint64 sequence, qint64 timestampMs)
+{
+    if (m_windowSeconds <= 0 || key == 0) {
+        return;
+    }
+
+    bool known = m_entries.contains(key);
+    m_entries.insert(key, Entry{sequence, timestampMs});
+
+    // Known keys already have a queue entry that will be re-armed when it comes due
+    if (!known) {
+        m_expiryQueue.enqueue(Expiry{timestampMs + m_windowSeconds * 1000LL, key});
+    }
+}
+
+void ChatDeduplicator::clear()
+{
+    m_entries.clear();
+    m_expiryQueue.clear();
+}
+
+void ChatDeduplicator::expire(qint64 nowMs)
+{
+    qint64 windowMs = m_windowSeconds * 1000LL;
+
+    while (!m_expiryQueue.isEmpty() && m_expiryQueue.head().expiresMs <= nowMs) {
+        Expiry expiry = m_expiryQueue.dequeue();
+
+        auto it = m_entries.find(expiry.key);
+        if (it == m_entries.end()) {
+            continue;
+        }
+
+        // Repeats slid the window forward, so check again later
+        if (it->lastSeenMs + windowMs > nowMs) {
+            m_expiryQueue.enqueue(Expiry{it->lastSeenMs + windowMs, expiry.key});
+        } else {
+            m_entries.erase(it);
+        }
+    }
+}
+
+quint64 ChatDeduplicator::contentKey(const QString& text)
+{
+    quint64 hash = FnvOffsetBasis;
+    quint64 wordHash = FnvOffsetBasis;
+    quint64 previousWordHash = 0;
+    char16_t previousUnit = 0;
+    bool inWord = false;
+    bool empty = true;
+
+    // Hash words one at a time so an immediately repeated word can be skipped
+    for (int i = 0; i <= text.size(); ++i) {
+        QChar ch = i < text.size() ? text.at(i) : QChar(' ');
+        bool separator = ch.isSpace() || ch.isPunct();
+
+        if (!separator) {
+            char16_t unit = ch.toCaseFolded().unicode();
+            if (!inWord || unit != previousUnit) {
+                wordHash = fnvAppend(wordHash, unit);
+            }
+            previousUnit = unit;
+            inWord = true;
+        } else if (inWord) {
+            if (wordHash != previousWordHash) {
+                hash = fnvAppend(hash, wordHash);
+                previousWordHash = wordHash;
+                empty = false;
+            }
+            wordHash = FnvOffsetBasis;
+            inWord = false;
+        }
+    }
+
+    if (empty) {
+        return 0;
+    }
+
+    return hash == 0 ? 1 : hash;
+}
@@ -0,0 +1,47 @@
+#ifndef CHATDEDUPLICATOR_H
+#define CHATDEDUPLICATOR_H
+
+#include <QString>
+#include <QHash>
+#include <QQueue>
+
+// Sliding-window duplicate detection for raids and copypasta.
+// Messages are keyed on a hash of their normalized content (case-folded,
+// punctuation ignored, repeated characters and repeated words collapsed), so
+// "KEKW KEKW KEKW" and "kekw kekw" count as the same message.
+class ChatDeduplicator {
+public:
+    ChatDeduplicator();
+
+    // Repeats within this many seconds of the previous one collapse; 0 disables
+    void setWindow(int seconds);
+    int window() const;
+
+    // Returns the sequence number of the live message with this key, or -1.
+    // A hit extends the window from the time of this repeat.
+    qint64 find(quint64 key, qint64 timestampMs);
+    void remember(quint64 key, qint64 sequence, qint64 timestampMs);
+    void clear();
+
+    // Returns 0 for content with nothing to compare (e.g. whitespace only)
+    static quint64 contentKey(const QString& text);
+
+private:
+    struct Entry {
+        qint64 sequence;
+        qint64 lastSeenMs;
+    };
+
+    struct Expiry {
+        qint64 expiresMs;
+        quint64 key;
+    };
+
+    int m_windowSeconds;
+    QHash<quint64, Entry> m_entries;
+    QQueue<Expiry> m_expiryQueue;
+
+    void expire(qint64 nowMs);
+};
+
+#endif // CHATDEDUPLICATOR_H
@@ -0,0 +1,183 @@
+#include "chatfanoutserver.h"
+#include "chatjson.h"
+#include <QLoggingCategory>
+#include <QDebug>
+
+Q_LOGGING_CATEGORY(lcFanout, "kickchat.fanout")
+
+namespace {
+// Only this much is handed to a socket at a time; the rest waits in our queue
+// as references to the shared buffers
+const qint64 SocketHighWatermark = 64 * 1024;
+}
+
+ChatFanoutServer::ChatFanoutServer(QObject* parent)
+    : QObject(parent)
+    , m_webSocketServer("KickChatOverlay", QWebSocketServer::NonSecureMode)
+    , m_webSocketSubscribers(0)
+    , m_maxQueuedBytes(4 * 1024 * 1024)
+{
+    connect(&m_webSocketServer, &QWebSocketServer::newConnection, this, &ChatFanoutServer::onNewWebSocketConnection);
+    connect(&m_localServer, &QLocalServer::newConnection, this, &ChatFanoutServer::onNewLocalConnection);
+}
+
+ChatFanoutServer::~ChatFanoutServer()
+{
+    m_webSocketServer.close();
+    m_localServer.close();
+
+    const QList<QObject*> sockets = m_subscribers.keys();
+    for (QObject* socket : sockets) {
+        removeSubscriber(socket);
+    }
+}
+
+bool ChatFanoutServer::listenWebSocket(quint16 port, const QHostAddress& address)
+{
+    if (!m_webSocketServer.listen(address, port)) {
+        qWarning() << "Fan-out WebSocket server failed to listen:" << m_webSocketServer.errorString();
+        return false;
+    }
+
+    qCDebug(lcFanout) << "Serving chat on ws://" + address.toString() + ":" + QString::number(m_webSocketServer.serverPort());
+    return true;
+}
+
+bool ChatFanoutServer::listenLocal(const QString& name)
+{
+    // A stale socket file from a crashed run would make listen() fail
+    QLocalServer::removeServer(name);
+
+    if (!m_localServer.listen(name)) {
+        qWarning() << "Fan-out local server failed to listen:" << m_localServer.errorString();
+        return false;
+    }
+
+    qCDebug(lcFanout) << "Serving chat on local socket" << m_localServer.fullServerName();
+    return true;
+}
+
+void ChatFanoutServer::setMaxQueuedBytes(qint64 bytes)
+{
+    m_maxQueuedBytes = qMax<qint64>(SocketHighWatermark, bytes);
+}
+
+int ChatFanoutServer::subscriberCount() const
+{
+    return m_subscribers.size();
+}
+
+void ChatFanoutServer::publish(const ChatMessage& message)
+{
+    if (m_subscribers.isEmpty()) {
+        return;
+    }
+
+    // Serialize once; every queue below holds a reference to these same buffers
+    Payload payload;
+    payload.line.reserve(256);
+    ChatJson::appendMessage(payload.line, message);
+    if (m_webSocketSubscribers > 0) {
+        payload.text = QString::fromUtf8(payload.line);
+    }
+    payload.line.append('\n');
+
+    QList<QObject*> slowSockets;
+    for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+        Subscriber* subscriber = it.value();
+
+        if (subscriber->queuedBytes + payload.line.size() > m_maxQueuedBytes) {
+            slowSockets.append(it.key());
+            continue;
+        }
+
+        subscriber->queue.enqueue(payload);
+        subscriber->queuedBytes += payload.line.size();
+        drain(subscriber);
+    }
+
+    for (QObject* socket : slowSockets) {
+        qWarning() << "Disconnecting fan-out client that fell behind";
+        removeSubscriber(socket);
+    }
+}
+
+void ChatFanoutServer::onNewWebSocketConnection()
+{
+    while (QWebSocket* socket = m_webSocketServer.nextPendingConnection()) {
+        addSubscriber(socket, socket, nullptr);
+        connect(socket, &QWebSocket::disconnected, this, [this, socket]() { removeSubscriber(socket); });
+        connect(socket, &QWebSocket::bytesWritten, this, [this, socket]() {
+            if (Subscriber* subscriber = m_subscribers.value(socket)) {
+                drain(subscriber);
+            }
+        });
+    }
+}
+
+void ChatFanoutServer::onNewLocalConnection()
+{
+    while (QLocalSocket* socket = m_localServer.nextPendingConnection()) {
+        addSubscriber(socket, nullptr, socket);
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() { removeSubscriber(socket); });
+        connect(socket, &QLocalSocket::bytesWritten, this, [this, socket]() {
+            if (Subscriber* subscriber = m_subscribers.value(socket)) {
+                drain(subscriber);
+            }
+        });
+    }
+}
+
+void ChatFanoutServer::addSubscriber(QObject* socket, QWebSocket* webSocket, QLocalSocket* localSocket)
+{
+    Subscriber* subscriber = new Subscriber;
+    subscriber->webSocket = webSocket;
+    subscriber->localSocket = localSocket;
+    subscriber->queuedBytes = 0;
+    m_subscribers.insert(socket, subscriber);
+    if (webSocket) {
+        ++m_webSocketSubscribers;
+    }
+
+    qCDebug(lcFanout) << "Fan-out client connected," << m_subscribers.size() << "subscribers";
+}
+
+void ChatFanoutServer::removeSubscriber(QObject* socket)
+{
+    Subscriber* subscriber = m_subscribers.take(socket);
+    if (!subscriber) {
+        return;
+    }
+
+    socket->disconnect(this);
+    if (subscriber->webSocket) {
+        --m_webSocketSubscribers;
+        subscriber->webSocket->abort();
+    } else {
+        subscriber->localSocket->abort();
+    }
+    socket->deleteLater();
+    delete subscriber;
+
+    qCDebug(lcFanout) << "Fan-out client removed," << m_subscribers.size() << "subscribers";
+}
+
+void ChatFanoutServer::drain(Subscriber* subscriber)
+{
+    while (!subscriber->queue.isEmpty() && pendingSocketBytes(subscriber) < SocketHighWatermark) {
+        Payload payload = subscriber->queue.dequeue();
+        subscriber->queuedBytes -= payload.line.size();
+
+        if (subscriber->webSocket) {
+            subscriber->webSocket->sendTextMessage(payload.text);
+        } else {
+            subscriber->localSocket->write(payload.line);
+        }
+    }
+}
+
+qint64 ChatFanoutServer::pendingSocketBytes(const Subscriber* subscriber)
+{
+    return subscriber->webSocket ? subscriber->webSocket->bytesToWrite()
+                                 : subscriber->localSocket->bytesToWrite();
+}
@@ -0,0 +1,71 @@
+#ifndef CHATFANOUTSERVER_H
+#define CHATFANOUTSERVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QQueue>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QWebSocketServer>
+#include <QWebSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include "chatmessage.h"
+
+// Rebroadcasts decoded chat to local consumers (browser sources, TTS bots,
+// loggers) so they share one upstream connection and one decode.
+//
+// Each message is serialized once into an implicitly shared buffer that every
+// subscriber's queue references. Queues are bounded per client: a consumer
+// that falls too far behind is disconnected instead of growing memory or
+// slowing everyone else down.
+//
+// WebSocket clients get one JSON text frame per message; local socket
+// clients (Unix domain socket / Windows named pipe) get NDJSON.
+class ChatFanoutServer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ChatFanoutServer(QObject* parent = nullptr);
+    ~ChatFanoutServer();
+
+    bool listenWebSocket(quint16 port, const QHostAddress& address = QHostAddress::LocalHost);
+    bool listenLocal(const QString& name);
+
+    void setMaxQueuedBytes(qint64 bytes);
+    int subscriberCount() const;
+
+public slots:
+    void publish(const ChatMessage& message);
+
+private slots:
+    void onNewWebSocketConnection();
+    void onNewLocalConnection();
+
+private:
+    // Both members are implicitly shared, so queueing one is a reference count bump
+    struct Payload {
+        QByteArray line; // NDJSON line for stream sockets
+        QString text;    // Same JSON for WebSocket text frames (built only if needed)
+    };
+
+    struct Subscriber {
+        QWebSocket* webSocket;
+        QLocalSocket* localSocket;
+        QQueue<Payload> queue;
+        qint64 queuedBytes;
+    };
+
+    QWebSocketServer m_webSocketServer;
+    QLocalServer m_localServer;
+    QHash<QObject*, Subscriber*> m_subscribers;
+    int m_webSocketSubscribers;
+    qint64 m_maxQueuedBytes;
+
+    void addSubscriber(QObject* socket, QWebSocket* webSocket, QLocalSocket* localSocket);
+    void removeSubscriber(QObject* socket);
+    void drain(Subscriber* subscriber);
+    static qint64 pendingSocketBytes(const Subscriber* subscriber);
+};
+
+#endif // CHATFANOUTSERVER_H
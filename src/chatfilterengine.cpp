@@ -0,0 +1,241 @@
+#include "chatfilterengine.h"
+#include <QThreadPool>
+#include <QQueue>
+#include <QVarLengthArray>
+#include <QLoggingCategory>
+#include <QDebug>
+
+Q_LOGGING_CATEGORY(lcChatFilter, "kickchat.filter")
+
+ChatFilterEngine::ChatFilterEngine()
+    : m_slot(std::make_shared<Slot>())
+{
+}
+
+ChatFilterEngine::~ChatFilterEngine()
+{
+    // An in-flight compile only holds the slot, so it finishes harmlessly
+}
+
+void ChatFilterEngine::setRules(const Rules& rules)
+{
+    m_rules = rules;
+
+    int generation = m_slot->generation.fetchAndAddOrdered(1) + 1;
+
+    // The very first rules are compiled inline so nothing slips through unfiltered at startup
+    if (!std::atomic_load(&m_slot->automaton)) {
+        std::atomic_store(&m_slot->automaton, compile(rules));
+        return;
+    }
+    std::weak_ptr<Slot> weakSlot = m_slot;
+
+    QThreadPool::globalInstance()->start([weakSlot, rules, generation]() {
+        std::shared_ptr<const Automaton> automaton = compile(rules);
+
+        std::shared_ptr<Slot> slot = weakSlot.lock();
+        // Drop the result if the engine is gone or newer rules were queued meanwhile
+        if (slot && slot->generation.loadAcquire() == generation) {
+            std::atomic_store(&slot->automaton, automaton);
+            qCDebug(lcChatFilter) << "Filter automaton rebuilt with" << automaton->nodes.size() << "states";
+        }
+    });
+}
+
+ChatFilterEngine::Rules ChatFilterEngine::rules() const
+{
+    return m_rules;
+}
+
+ChatFilterEngine::Actions ChatFilterEngine::apply(ChatMessage& message) const
+{
+    std::shared_ptr<const Automaton> automaton = std::atomic_load(&m_slot->automaton);
+    if (!automaton || automaton->nodes.size() <= 1) {
+        return Pass;
+    }
+
+    const QString text = message.message();
+    Actions actions = Pass;
+    int state = 0;
+
+    // Original code unit index of every folded unit, to map matches back for masking
+    QVarLengthArray<int, 256> foldedOrigin;
+    QVarLengthArray<QPair<int, int>, 8> maskRanges;
+    QString folded;
+
+    for (int i = 0; i < text.size();) {
+        int begin = i;
+        char32_t codePoint = text.at(i).unicode();
+        if (QChar::isHighSurrogate(codePoint) && i + 1 < text.size() && text.at(i + 1).isLowSurrogate()) {
+            codePoint = QChar::surrogateToUcs4(text.at(i), text.at(i + 1));
+            ++i;
+        }
+        ++i;
+
+        folded.clear();
+        foldCodePoint(codePoint, folded);
+
+        for (QChar unit : folded) {
+            foldedOrigin.append(begin);
+            state = automaton->step(state, unit.unicode());
+
+            const Node& node = automaton->nodes.at(state);
+            if (node.actions == Pass) {
+                continue;
+            }
+
+            actions |= node.actions;
+            if (actions & Drop) {
+                return actions; // Nothing else matters for a dropped message
+            }
+            if (node.maskLength > 0) {
+                int start = foldedOrigin.at(foldedOrigin.size() - node.maskLength);
+                maskRanges.append(qMakePair(start, i));
+            }
+        }
+    }
+
+    if (!maskRanges.isEmpty()) {
+        QString masked = text;
+        for (const QPair<int, int>& range : maskRanges) {
+            for (int pos = range.first; pos < range.second; ++pos) {
+                if (!masked.at(pos).isSpace()) {
+                    masked[pos] = '*';
+                }
+            }
+        }
+        message.setMessage(masked);
+    }
+
+    if (actions & Highlight) {
+        message.setHighlighted(true);
+    }
+
+    return actions;
+}
+
+QString ChatFilterEngine::foldText(const QString& text)
+{
+    QString folded;
+    folded.reserve(text.size());
+
+    for (int i = 0; i < text.size(); ++i) {
+        char32_t codePoint = text.at(i).unicode();
+        if (text.at(i).isHighSurrogate() && i + 1 < text.size() && text.at(i + 1).isLowSurrogate()) {
+            codePoint = QChar::surrogateToUcs4(text.at(i), text.at(i + 1));
+            ++i;
+        }
+        foldCodePoint(codePoint, folded);
+    }
+
+    return folded;
+}
+
+void ChatFilterEngine::foldCodePoint(char32_t codePoint, QString& out)
+{
+    // ASCII needs no table lookups
+    if (codePoint < 0x80) {
+        out.append(QChar(static_cast<char16_t>(codePoint >= 'A' && codePoint <= 'Z' ? codePoint + 32 : codePoint)));
+        return;
+    }
+
+    // Compatibility decomposition turns fullwidth/stylised letters into plain ones;
+    // dropping the marks afterwards makes matching accent-insensitive
+    int start = out.size();
+    QString decomposed = QString::fromUcs4(&codePoint, 1).normalized(QString::NormalizationForm_KD);
+    for (QChar ch : decomposed) {
+        QChar::Category category = ch.category();
+        if (category == QChar::Mark_NonSpacing || category == QChar::Mark_Enclosing ||
+            category == QChar::Other_Format) {
+            continue;
+        }
+        out.append(ch);
+    }
+
+    // Case folding can change length, so fold the tail we just appended as a whole
+    QString tail = out.mid(start).toCaseFolded();
+    out.truncate(start);
+    out.append(tail);
+}
+
+int ChatFilterEngine::Automaton::step(int state, char16_t unit) const
+{
+    for (;;) {
+        auto it = transitions.constFind((quint64(state) << 16) | unit);
+        if (it != transitions.cend()) {
+            return it.value();
+        }
+        if (state == 0) {
+            return 0;
+        }
+        state = nodes.at(state).fail;
+    }
+}
+
+std::shared_ptr<const ChatFilterEngine::Automaton> ChatFilterEngine::compile(const Rules& rules)
+{
+    auto automaton = std::make_shared<Automaton>();
+    automaton->nodes.append(Node{0, 0, Pass});
+
+    auto addPhrases = [&automaton](const QStringList& phrases, Action action) {
+        for (const QString& phrase : phrases) {
+            QString pattern = foldText(phrase.trimmed());
+            if (pattern.isEmpty()) {
+                continue;
+            }
+
+            int state = 0;
+            for (QChar unit : pattern) {
+                quint64 key = (quint64(state) << 16) | unit.unicode();
+                auto it = automaton->transitions.constFind(key);
+                if (it != automaton->transitions.cend()) {
+                    state = it.value();
+                } else {
+                    automaton->nodes.append(Node{0, 0, Pass});
+                    state = automaton->nodes.size() - 1;
+                    automaton->transitions.insert(key, state);
+                }
+            }
+
+            Node& node = automaton->nodes[state];
+            node.actions |= action;
+            if (action == Mask) {
+                node.maskLength = qMax(node.maskLength, static_cast<int>(pattern.size()));
+            }
+        }
+    };
+
+    addPhrases(rules.blockedPhrases, Drop);
+    addPhrases(rules.maskedPhrases, Mask);
+    addPhrases(rules.highlightPhrases, Highlight);
+
+    // Collect the children of every state so failure links can be built breadth-first
+    QVector<QVector<QPair<char16_t, int>>> children(automaton->nodes.size());
+    for (auto it = automaton->transitions.cbegin(); it != automaton->transitions.cend(); ++it) {
+        children[static_cast<int>(it.key() >> 16)].append(qMakePair(char16_t(it.key() & 0xFFFF), it.value()));
+    }
+
+    QQueue<int> queue;
+    for (const QPair<char16_t, int>& child : children.at(0)) {
+        automaton->nodes[child.second].fail = 0;
+        queue.enqueue(child.second);
+    }
+
+    while (!queue.isEmpty()) {
+        int state = queue.dequeue();
+        for (const QPair<char16_t, int>& child : children.at(state)) {
+            int fail = automaton->step(automaton->nodes.at(state).fail, child.first);
+            Node& node = automaton->nodes[child.second];
+            node.fail = fail;
+
+            // Inherit outputs of shorter phrases that end at the same position
+            const Node& failNode = automaton->nodes.at(fail);
+            node.actions |= failNode.actions;
+            node.maskLength = qMax(node.maskLength, failNode.maskLength);
+
+            queue.enqueue(child.second);
+        }
+    }
+
+    return automaton;
+}
@@ -0,0 +1,74 @@
+#ifndef CHATFILTERENGINE_H
+#define CHATFILTERENGINE_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QAtomicInt>
+#include <memory>
+#include "chatmessage.h"
+
+// Multi-pattern keyword filter applied once per message on the ingest path.
+// All blocked, masked and highlight phrases are compiled into one Aho-Corasick
+// automaton over case-folded, compatibility-decomposed text (accents and
+// zero-width characters are ignored), so a message is classified in a single
+// linear pass no matter how many phrases are configured.
+class ChatFilterEngine {
+public:
+    enum Action {
+        Pass = 0x0,
+        Highlight = 0x1,
+        Mask = 0x2,
+        Drop = 0x4
+    };
+    Q_DECLARE_FLAGS(Actions, Action)
+
+    struct Rules {
+        QStringList blockedPhrases;   // Message is dropped
+        QStringList maskedPhrases;    // Matching text is replaced with '*'
+        QStringList highlightPhrases; // Message is highlighted
+    };
+
+    ChatFilterEngine();
+    ~ChatFilterEngine();
+
+    // Compiles the rules on a worker thread; the running automaton keeps serving
+    // messages until the new one is swapped in
+    void setRules(const Rules& rules);
+    Rules rules() const;
+
+    // Classifies the message, masking its text and setting its highlight flag as needed
+    Actions apply(ChatMessage& message) const;
+
+    static QString foldText(const QString& text);
+
+private:
+    struct Node {
+        int fail;
+        int maskLength; // Longest masked phrase ending here, in folded units
+        Actions actions;
+    };
+
+    struct Automaton {
+        QVector<Node> nodes;
+        QHash<quint64, int> transitions; // (state << 16 | unit) -> state
+
+        int step(int state, char16_t unit) const;
+    };
+
+    struct Slot {
+        std::shared_ptr<const Automaton> automaton;
+        QAtomicInt generation;
+    };
+
+    std::shared_ptr<Slot> m_slot;
+    Rules m_rules;
+
+    static std::shared_ptr<const Automaton> compile(const Rules& rules);
+    static void foldCodePoint(char32_t codePoint, QString& out);
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(ChatFilterEngine::Actions)
+
+#endif // CHATFILTERENGINE_H
@@ -0,0 +1,128 @@
+#include "chatjson.h"
+
+namespace {
+const char HexDigits[] = "0123456789abcdef";
+
+void appendEscapedControl(QByteArray& out, char16_t unit)
+{
+    char escape[6] = { '\\', 'u', '0', '0', HexDigits[(unit >> 4) & 0xF], HexDigits[unit & 0xF] };
+    out.append(escape, 6);
+}
+}
+
+namespace ChatJson {
+
+void appendString(QByteArray& out, const QString& value)
+{
+    out.append('"');
+
+    const QChar* data = value.constData();
+    const int size = value.size();
+    for (int i = 0; i < size; ++i) {
+        char16_t unit = data[i].unicode();
+
+        if (unit < 0x80) {
+            switch (unit) {
+            case '"': out.append("\\\"", 2); break;
+            case '\\': out.append("\\\\", 2); break;
+            case '\n': out.append("\\n", 2); break;
+            case '\r': out.append("\\r", 2); break;
+            case '\t': out.append("\\t", 2); break;
+            default:
+                if (unit < 0x20) {
+                    appendEscapedControl(out, unit);
+                } else {
+                    out.append(static_cast<char>(unit));
+                }
+            }
+            continue;
+        }
+
+        char32_t codePoint = unit;
+        if (QChar::isHighSurrogate(unit) && i + 1 < size && data[i + 1].isLowSurrogate()) {
+            codePoint = QChar::surrogateToUcs4(unit, data[i + 1].unicode());
+            ++i;
+        } else if (QChar::isSurrogate(unit)) {
+            codePoint = 0xFFFD; // Lone surrogate, not representable in UTF-8
+        }
+
+        char bytes[4];
+        int length;
+        if (codePoint < 0x800) {
+            bytes[0] = static_cast<char>(0xC0 | (codePoint >> 6));
+            bytes[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            length = 2;
+        } else if (codePoint < 0x10000) {
+            bytes[0] = static_cast<char>(0xE0 | (codePoint >> 12));
+            bytes[1] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            bytes[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            length = 3;
+        } else {
+            bytes[0] = static_cast<char>(0xF0 | (codePoint >> 18));
+            bytes[1] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            bytes[2] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            bytes[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            length = 4;
+        }
+        out.append(bytes, length);
+    }
+
+    out.append('"');
+}
+
+void appendMessage(QByteArray& out, const ChatMessage& message)
+{
+    out.append("{\"ts\":", 6);
+    out.append(QByteArray::number(message.timestamp().toMSecsSinceEpoch()));
+    if (!message.messageId().isEmpty()) {
+        out.append(",\"id\":", 6);
+        appendString(out, message.messageId());
+    }
+    if (message.senderId() != 0) {
+        out.append(",\"user_id\":", 11);
+        out.append(QByteArray::number(message.senderId()));
+    }
+    out.append(",\"user\":", 8);
+    appendString(out, message.username());
+    out.append(",\"color\":\"#", 11);
+    quint32 rgb = message.usernameColor();
+    for (int shift = 20; shift >= 0; shift -= 4) {
+        out.append(HexDigits[(rgb >> shift) & 0xF]);
+    }
+    out.append("\",\"text\":", 9);
+    appendString(out, message.message());
+
+    ChatMessage::Roles roles = message.roles();
+    if (roles != ChatMessage::NoRole) {
+        out.append(",\"roles\":[", 10);
+        bool first = true;
+        auto appendRole = [&out, &first](const char* name) {
+            if (!first) {
+                out.append(',');
+            }
+            out.append('"').append(name).append('"');
+            first = false;
+        };
+        if (roles & ChatMessage::Broadcaster) {
+            appendRole("broadcaster");
+        }
+        if (roles & ChatMessage::Moderator) {
+            appendRole("moderator");
+        }
+        if (roles & ChatMessage::Vip) {
+            appendRole("vip");
+        }
+        if (roles & ChatMessage::Subscriber) {
+            appendRole("subscriber");
+        }
+        out.append(']');
+    }
+
+    if (message.isHighlighted()) {
+        out.append(",\"highlight\":true", 17);
+    }
+
+    out.append('}');
+}
+
+}
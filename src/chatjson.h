@@ -0,0 +1,20 @@
+#ifndef CHATJSON_H
+#define CHATJSON_H
+
+#include <QByteArray>
+#include <QString>
+#include "chatmessage.h"
+
+// Hand-rolled JSON encoding for decoded chat messages. Appends straight into
+// the caller's buffer (UTF-16 to escaped UTF-8 in one pass) so streaming
+// outputs can reuse preallocated buffers without temporary strings.
+//
+// {"ts":1700000000000,"id":"...","user_id":42,"user":"name","color":"#aabbcc","text":"hi","roles":["moderator"],"highlight":true}
+namespace ChatJson {
+
+void appendMessage(QByteArray& out, const ChatMessage& message);
+void appendString(QByteArray& out, const QString& value);
+
+}
+
+#endif // CHATJSON_H
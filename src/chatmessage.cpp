@@ -1,30 +1,190 @@
 #include "chatmessage.h"
+#include "clock.h"
+
+class ChatMessageData : public QSharedData {
+public:
+    QString username;
+    QString message;
+    quint32 usernameColor;
+    QDateTime timestamp;
+    QDateTime receivedAt;
+    bool highlighted;
+    int repeatCount;
+    ChatMessage::Roles roles;
+    QString messageId;
+    qint64 senderId;
+    bool deleted;
+    QStringList emotes;
+};
 
 ChatMessage::ChatMessage(const QString& username, const QString& message, 
-                         const QColor& usernameColor, const QDateTime& timestamp)
-    : m_username(username)
-    , m_message(message)
-    , m_usernameColor(usernameColor)
-    , m_timestamp(timestamp)
+                         quint32 usernameColor, const QDateTime& timestamp)
+    : d(new ChatMessageData)
 {
+    d->username = username;
+    d->message = message;
+    d->usernameColor = usernameColor & 0xFFFFFF;
+    d->timestamp = timestamp.isValid() ? timestamp : Clock::instance()->now();
+    d->receivedAt = d->timestamp;
+    d->highlighted = false;
+    d->repeatCount = 1;
+    d->roles = NoRole;
+    d->senderId = 0;
+    d->deleted = false;
 }
 
+ChatMessage::ChatMessage(const ChatMessage& other) = default;
+ChatMessage& ChatMessage::operator=(const ChatMessage& other) = default;
+ChatMessage::~ChatMessage() = default;
+
 QString ChatMessage::username() const
 {
-    return m_username;
+    return d->username;
 }
 
 QString ChatMessage::message() const
 {
-    return m_message;
+    return d->message;
+}
+
+quint32 ChatMessage::usernameColor() const
+{
+    return d->usernameColor;
 }
 
-QColor ChatMessage::usernameColor() const
+QString ChatMessage::usernameColorName() const
 {
-    return m_usernameColor;
+    return QString("#%1").arg(d->usernameColor, 6, 16, QLatin1Char('0'));
 }
 
 QDateTime ChatMessage::timestamp() const
 {
-    return m_timestamp;
-} 
\ No newline at end of file
+    return d->timestamp;
+}
+
+QDateTime ChatMessage::receivedAt() const
+{
+    return d->receivedAt;
+}
+
+bool ChatMessage::isHighlighted() const
+{
+    return d->highlighted;
+}
+
+int ChatMessage::repeatCount() const
+{
+    return d->repeatCount;
+}
+
+qint64 ChatMessage::memoryUsage() const
+{
+    // QString keeps a small header in front of its UTF-16 payload
+    const qint64 stringHeader = 24;
+    qint64 bytes = static_cast<qint64>(sizeof(ChatMessageData))
+        + 3 * stringHeader
+        + (d->username.capacity() + d->message.capacity() + d->messageId.capacity()) * static_cast<qint64>(sizeof(QChar));
+    for (const QString& emote : d->emotes) {
+        bytes += static_cast<qint64>(sizeof(QString)) + stringHeader + emote.capacity() * static_cast<qint64>(sizeof(QChar));
+    }
+    return bytes;
+}
+
+ChatMessage::Roles ChatMessage::roles() const
+{
+    return d->roles;
+}
+
+QString ChatMessage::messageId() const
+{
+    return d->messageId;
+}
+
+qint64 ChatMessage::senderId() const
+{
+    return d->senderId;
+}
+
+bool ChatMessage::isDeleted() const
+{
+    return d->deleted;
+}
+
+QStringList ChatMessage::emotes() const
+{
+    return d->emotes;
+}
+
+void ChatMessage::setUsername(const QString& username)
+{
+    d->username = username;
+}
+
+void ChatMessage::setMessage(const QString& message)
+{
+    d->message = message;
+}
+
+void ChatMessage::setHighlighted(bool highlighted)
+{
+    d->highlighted = highlighted;
+}
+
+void ChatMessage::setRepeatCount(int count)
+{
+    d->repeatCount = count;
+}
+
+void ChatMessage::setRoles(Roles roles)
+{
+    d->roles = roles;
+}
+
+void ChatMessage::setMessageId(const QString& id)
+{
+    d->messageId = id;
+}
+
+void ChatMessage::setSenderId(qint64 id)
+{
+    d->senderId = id;
+}
+
+void ChatMessage::setDeleted(bool deleted)
+{
+    d->deleted = deleted;
+}
+
+void ChatMessage::setReceivedAt(const QDateTime& receivedAt)
+{
+    d->receivedAt = receivedAt;
+}
+
+void ChatMessage::setEmotes(const QStringList& emotes)
+{
+    d->emotes = emotes;
+}
+
+bool ChatMessage::parseColor(const QString& name, quint32* rgb)
+{
+    if (!name.startsWith('#') || (name.size() != 4 && name.size() != 7)) {
+        return false;
+    }
+
+    bool ok;
+    quint32 value = name.mid(1).toUInt(&ok, 16);
+    if (!ok) {
+        return false;
+    }
+
+    if (name.size() == 4) {
+        // #rgb doubles each digit
+        quint32 r = (value >> 8) & 0xF;
+        quint32 g = (value >> 4) & 0xF;
+        quint32 b = value & 0xF;
+        value = (r * 0x11) << 16 | (g * 0x11) << 8 | (b * 0x11);
+    }
+
+    *rgb = value;
+    return true;
+}
@@ -2,25 +2,73 @@
 #define CHATMESSAGE_H
 
 #include <QString>
-#include <QColor>
 #include <QDateTime>
+#include <QStringList>
+#include <QSharedDataPointer>
 
+class ChatMessageData;
+
+// Implicitly shared: copies are a reference count bump, so a message can sit in
+// the shared store, several overlay views and the search index at once without
+// being duplicated. Setters detach, so per-view edits (masking, repeat counts)
+// never leak into other views.
 class ChatMessage {
 public:
+    enum Role {
+        NoRole = 0x0,
+        Broadcaster = 0x1,
+        Moderator = 0x2,
+        Vip = 0x4,
+        Subscriber = 0x8
+    };
+    Q_DECLARE_FLAGS(Roles, Role)
+
+    // Colors are 0xRRGGBB; the core stays free of QtGui
     ChatMessage(const QString& username, const QString& message, 
-                const QColor& usernameColor = QColor(255, 255, 255), 
-                const QDateTime& timestamp = QDateTime::currentDateTime());
+                quint32 usernameColor = 0xFFFFFF, 
+                const QDateTime& timestamp = QDateTime()); // Invalid means Clock::now()
+    ChatMessage(const ChatMessage& other);
+    ChatMessage& operator=(const ChatMessage& other);
+    ~ChatMessage();
 
     QString username() const;
     QString message() const;
-    QColor usernameColor() const;
+    quint32 usernameColor() const;
+    QString usernameColorName() const; // "#rrggbb"
     QDateTime timestamp() const;
+    // When this process got the message; differs from timestamp() for history
+    // fetched on connect. Rows expire by this, display and search use timestamp().
+    QDateTime receivedAt() const;
+    bool isHighlighted() const;
+    int repeatCount() const;
+    Roles roles() const;
+    QString messageId() const;
+    qint64 senderId() const;
+    bool isDeleted() const;
+    // Names of the [emote:<id>:<name>] tokens in the text, filled in on ingest
+    QStringList emotes() const;
+
+    // Approximate heap bytes behind this message, counted once however many copies share it
+    qint64 memoryUsage() const;
+
+    void setUsername(const QString& username);
+    void setMessage(const QString& message);
+    void setHighlighted(bool highlighted);
+    void setRepeatCount(int count);
+    void setRoles(Roles roles);
+    void setMessageId(const QString& id);
+    void setSenderId(qint64 id);
+    void setDeleted(bool deleted);
+    void setReceivedAt(const QDateTime& receivedAt);
+    void setEmotes(const QStringList& emotes);
+
+    // Accepts "#rgb" and "#rrggbb"
+    static bool parseColor(const QString& name, quint32* rgb);
 
 private:
-    QString m_username;
-    QString m_message;
-    QColor m_usernameColor;
-    QDateTime m_timestamp;
+    QSharedDataPointer<ChatMessageData> d;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(ChatMessage::Roles)
+
 #endif // CHATMESSAGE_H 
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "chatmessagestore.h"
+#include "memorybudget.h"
+#include <QDebug>
+
+namespace {
+// The ring never shrinks below this many messages under memory pressure
+const int MinimumCapacity = 100;
+}
+
+ChatMessageStore::ChatMessageStore(KickChatClient* client, MemoryBudget* budget, int capacity, QObject* parent)
+    : QObject(parent)
+    , m_client(client)
+    , m_memoryBudget(budget)
+    , m_statistics(nullptr)
+    , m_capacity(qMax(1, capacity))
+    , m_maxCapacity(m_capacity)
+    , m_origin(0)
+    , m_nextSequence(0)
+    , m_bytes(0)
+{
+    m_ring.reserve(m_capacity);
+    connect(m_client, &KickChatClient::messageReceived, this, &ChatMessageStore::onMessageReceived);
+    connect(m_client, &KickChatClient::messageDeleted, this, &ChatMessageStore::removeMessage);
+    connect(m_client, &KickChatClient::userBanned, this, &ChatMessageStore::removeUserMessages);
+
+    if (m_memoryBudget) {
+        m_memoryBudget->registerConsumer(this, "Search index", MemoryBudget::SearchIndex,
+                                         [this]() { return m_searchIndex.memoryUsage(); },
+                                         [this](qint64 bytes) { return m_searchIndex.releaseOldest(bytes); });
+        m_memoryBudget->registerConsumer(this, "Message store", MemoryBudget::MessageStore,
+                                         [this]() { return memoryUsage(); },
+                                         [this](qint64 bytes) { return shrinkOldest(bytes); });
+        connect(m_memoryBudget, &MemoryBudget::underBudget, this, &ChatMessageStore::regrow);
+    }
+}
+
+KickChatClient* ChatMessageStore::client() const
+{
+    return m_client;
+}
+
+ChatSearchIndex* ChatMessageStore::searchIndex()
+{
+    return &m_searchIndex;
+}
+
+MemoryBudget* ChatMessageStore::memoryBudget() const
+{
+    return m_memoryBudget;
+}
+
+void ChatMessageStore::setStatistics(ChatStatistics* statistics)
+{
+    m_statistics = statistics;
+}
+
+ChatStatistics* ChatMessageStore::statistics() const
+{
+    return m_statistics;
+}
+
+int ChatMessageStore::capacity() const
+{
+    return m_capacity;
+}
+
+int ChatMessageStore::size() const
+{
+    return m_ring.size();
+}
+
+qint64 ChatMessageStore::firstSequence() const
+{
+    return m_nextSequence - m_ring.size();
+}
+
+qint64 ChatMessageStore::nextSequence() const
+{
+    return m_nextSequence;
+}
+
+const ChatMessage& ChatMessageStore::at(qint64 sequence) const
+{
+    Q_ASSERT(sequence >= firstSequence() && sequence < m_nextSequence);
+    return m_ring.at(slotOf(sequence));
+}
+
+QList<ChatMessage> ChatMessageStore::tail(int count) const
+{
+    QList<ChatMessage> messages;
+    qint64 first = qMax(firstSequence(), m_nextSequence - qMax(0, count));
+    messages.reserve(static_cast<int>(m_nextSequence - first));
+
+    for (qint64 sequence = first; sequence < m_nextSequence; ++sequence) {
+        if (!at(sequence).isDeleted()) {
+            messages.append(at(sequence));
+        }
+    }
+
+    return messages;
+}
+
+qint64 ChatMessageStore::sequenceOf(const QString& messageId) const
+{
+    return m_sequenceById.value(messageId, -1);
+}
+
+void ChatMessageStore::removeMessage(const QString& messageId)
+{
+    qint64 sequence = sequenceOf(messageId);
+    if (sequence < 0) {
+        return;
+    }
+
+    m_ring[slotOf(sequence)].setDeleted(true);
+    emit messagesRemoved(QStringList() << messageId);
+}
+
+void ChatMessageStore::removeUserMessages(qint64 senderId)
+{
+    // A ban wave is many of these in a row; each one costs only that user's messages
+    QStringList removed;
+    const QList<qint64> sequences = m_sequencesBySender.value(senderId);
+    for (qint64 sequence : sequences) {
+        ChatMessage& message = m_ring[slotOf(sequence)];
+        if (!message.isDeleted()) {
+            message.setDeleted(true);
+            if (!message.messageId().isEmpty()) {
+                removed.append(message.messageId());
+            }
+        }
+    }
+
+    if (!removed.isEmpty()) {
+        emit messagesRemoved(removed);
+    }
+}
+
+void ChatMessageStore::forget(qint64 sequence)
+{
+    // Called for the oldest held sequence, which is also the front of its sender's list
+    const ChatMessage& message = at(sequence);
+
+    auto idIt = m_sequenceById.find(message.messageId());
+    if (idIt != m_sequenceById.end() && idIt.value() == sequence) {
+        m_sequenceById.erase(idIt);
+    }
+
+    auto it = m_sequencesBySender.find(message.senderId());
+    if (it != m_sequencesBySender.end()) {
+        if (!it->isEmpty() && it->first() == sequence) {
+            it->removeFirst();
+        }
+        if (it->isEmpty()) {
+            m_sequencesBySender.erase(it);
+        }
+    }
+}
+
+qint64 ChatMessageStore::memoryUsage() const
+{
+    return m_bytes + m_ring.capacity() * static_cast<qint64>(sizeof(ChatMessage));
+}
+
+qint64 ChatMessageStore::shrinkOldest(qint64 bytes)
+{
+    if (m_ring.size() <= MinimumCapacity) {
+        return 0;
+    }
+
+    // Work out how many of the oldest messages cover the request
+    qint64 first = firstSequence();
+    qint64 freed = 0;
+    int dropCount = 0;
+    while (freed < bytes && m_ring.size() - dropCount > MinimumCapacity) {
+        freed += at(first + dropCount).memoryUsage();
+        forget(first + dropCount);
+        ++dropCount;
+    }
+
+    qint64 before = memoryUsage();
+    m_bytes -= freed;
+    relayout(m_ring.size() - dropCount, m_ring.size() - dropCount);
+
+    qCDebug(lcMemory) << "Message store shrunk to" << m_capacity << "messages";
+    return before - memoryUsage();
+}
+
+void ChatMessageStore::regrow(qint64 headroomBytes)
+{
+    if (m_capacity >= m_maxCapacity) {
+        return;
+    }
+
+    // Spend only half the headroom so the next enforcement doesn't shrink it right back
+    qint64 perMessage = static_cast<qint64>(sizeof(ChatMessage))
+        + (m_ring.isEmpty() ? 0 : m_bytes / m_ring.size());
+    qint64 growBy = qMin<qint64>(m_maxCapacity - m_capacity, headroomBytes / 2 / perMessage);
+    if (growBy <= 0) {
+        return;
+    }
+
+    relayout(m_ring.size(), m_capacity + static_cast<int>(growBy));
+    qCDebug(lcMemory) << "Message store grown back to" << m_capacity << "messages";
+}
+
+void ChatMessageStore::relayout(int keepCount, int newCapacity)
+{
+    // Lay the newest keepCount messages out in order from slot 0; the origin
+    // keeps slot = (sequence - origin) % capacity true for what follows
+    QVector<ChatMessage> ring;
+    ring.reserve(newCapacity);
+    for (int i = 0; i < keepCount; ++i) {
+        ring.append(at(m_nextSequence - keepCount + i));
+    }
+
+    m_ring.swap(ring);
+    m_capacity = newCapacity;
+    m_origin = m_nextSequence - keepCount;
+}
+
+int ChatMessageStore::slotOf(qint64 sequence) const
+{
+    return static_cast<int>((sequence - m_origin) % m_capacity);
+}
+
+void ChatMessageStore::onMessageReceived(const ChatMessage& message)
+{
+    // A history page fetched again (reconnect, ingest helper restart) repeats
+    // messages already held, deleted ones included
+    if (!message.messageId().isEmpty() && m_sequenceById.contains(message.messageId())) {
+        return;
+    }
+
+    // Slot = (sequence - origin) % capacity, so the ring overwrites the oldest entry in place
+    if (m_ring.size() < m_capacity) {
+        m_ring.append(message);
+    } else {
+        forget(m_nextSequence - m_capacity);
+        ChatMessage& slot = m_ring[slotOf(m_nextSequence)];
+        m_bytes -= slot.memoryUsage();
+        slot = message;
+    }
+    m_bytes += message.memoryUsage();
+
+    if (!message.messageId().isEmpty()) {
+        m_sequenceById.insert(message.messageId(), m_nextSequence);
+    }
+    m_sequencesBySender[message.senderId()].append(m_nextSequence);
+    ++m_nextSequence;
+
+    // Moderators search what was actually said, so indexing happens before any view filters
+    m_searchIndex.addMessage(message);
+
+    emit messageAppended(message);
+}
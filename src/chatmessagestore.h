@@ -0,0 +1,91 @@
+#ifndef CHATMESSAGESTORE_H
+#define CHATMESSAGESTORE_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QStringList>
+#include "kickchatclient.h"
+#include "chatmessage.h"
+#include "chatsearchindex.h"
+
+class MemoryBudget;
+class ChatStatistics;
+
+// Single source of chat for every overlay window. Fed by one KickChatClient,
+// it keeps a bounded ring of recent messages plus the session search index.
+// Messages are stored once and handed out as implicitly shared references;
+// each window applies its own filters, limits and styling on top.
+//
+// Messages are also indexed by Kick message ID and by sender, so a deletion is
+// one hash lookup and a ban touches only that user's k messages. Removed
+// messages stay in the ring as tombstones (isDeleted()) to keep sequence
+// numbers dense; views are told which IDs went away. A message whose ID is
+// already held is not appended again.
+class ChatMessageStore : public QObject {
+    Q_OBJECT
+
+public:
+    // The store and its search index report to budget when one is given
+    explicit ChatMessageStore(KickChatClient* client, MemoryBudget* budget = nullptr,
+                              int capacity = 1000, QObject* parent = nullptr);
+
+    KickChatClient* client() const;
+    ChatSearchIndex* searchIndex();
+    MemoryBudget* memoryBudget() const;
+
+    // Session statistics fed from the client, shared for display (not owned)
+    void setStatistics(ChatStatistics* statistics);
+    ChatStatistics* statistics() const;
+
+    int capacity() const;
+    int size() const;
+
+    // Sequence numbers grow forever; [firstSequence(), nextSequence()) is held
+    qint64 firstSequence() const;
+    qint64 nextSequence() const;
+    const ChatMessage& at(qint64 sequence) const;
+
+    // Newest messages in arrival order, at most count of them (shallow copies);
+    // deleted messages are skipped
+    QList<ChatMessage> tail(int count) const;
+
+    // Sequence of the held message with this ID, or -1
+    qint64 sequenceOf(const QString& messageId) const;
+
+    void removeMessage(const QString& messageId);
+    void removeUserMessages(qint64 senderId);
+
+    qint64 memoryUsage() const;
+
+signals:
+    void messageAppended(const ChatMessage& message);
+    void messagesRemoved(const QStringList& messageIds);
+
+private slots:
+    void onMessageReceived(const ChatMessage& message);
+    void regrow(qint64 headroomBytes);
+
+private:
+    qint64 shrinkOldest(qint64 bytes);
+    void relayout(int keepCount, int newCapacity);
+    int slotOf(qint64 sequence) const;
+    void forget(qint64 sequence);
+
+    KickChatClient* m_client;
+    MemoryBudget* m_memoryBudget;
+    ChatStatistics* m_statistics;
+    ChatSearchIndex m_searchIndex;
+    QVector<ChatMessage> m_ring;
+    // Shrinks under memory pressure and grows back towards m_maxCapacity
+    int m_capacity;
+    int m_maxCapacity;
+    qint64 m_origin;
+    qint64 m_nextSequence;
+    qint64 m_bytes;
+    QHash<QString, qint64> m_sequenceById;
+    // Per sender, their held sequences in arrival order
+    QHash<qint64, QList<qint64>> m_sequencesBySender;
+};
+
+#endif // CHATMESSAGESTORE_H
@@ -1,5 +1,9 @@
 #include "chatoverlay.h"
 #include "ui_chatoverlay.h"
+#include "startupmetrics.h"
+#include "memorybudget.h"
+#include "chatstatistics.h"
+#include "textsanitizer.h"
 
 #include <QPainter>
 #include <QMouseEvent>
@@ -14,20 +18,44 @@
 #include <QDateTime>
 #include <QScreen>
 #include <QApplication>
-#include <QTimer>
 #include <QKeySequenceEdit>
 #include <QDialogButtonBox>
 #include <QFormLayout>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QPlainTextEdit>
+#include <QElapsedTimer>
+#include <QWindow>
+#include <QScrollBar>
+#include <QResizeEvent>
+#include <utility>
 
 #ifdef Q_OS_WIN
 #include <windows.h>
 #endif
 
-ChatOverlay::ChatOverlay(QWidget* parent)
+namespace {
+// Rough cost of a message QLabel, for memory accounting
+const qint64 EstimatedLabelBytes = 2048;
+
+// Row images are keyed by sequence for live rows; history rows, keyed by
+// document ID and focus, get the negative keys
+qint64 historyRowKey(quint32 docId, bool focused)
+{
+    return -2 * static_cast<qint64>(docId) - (focused ? 2 : 1);
+}
+}
+
+ChatOverlay::ChatOverlay(ChatMessageStore* store, int windowIndex, QWidget* parent)
     : QWidget(parent)
     , ui(new Ui::ChatOverlay)
+    , m_store(store)
+    , m_chatClient(store->client())
+    , m_windowIndex(windowIndex)
     , m_dragging(false)
     , m_displayNeedsUpdate(false)
+    , m_renderingSuspended(false)
+    , m_settingsBatchDepth(0)
     , m_clickThroughEnabled(false)
     , m_positionLocked(false)
     , m_toggleVisibilityShortcut(nullptr)
@@ -47,6 +75,31 @@ ChatOverlay::ChatOverlay(QWidget* parent)
     , m_clickThroughAction(nullptr)
     , m_lockPositionAction(nullptr)
     , m_setHotkeyAction(nullptr)
+    , m_searchAction(nullptr)
+    , m_liveChatAction(nullptr)
+    , m_filtersAction(nullptr)
+    , m_dedupAction(nullptr)
+    , m_floodLimitAction(nullptr)
+    , m_smoothingAction(nullptr)
+    , m_newWindowAction(nullptr)
+    , m_closeWindowAction(nullptr)
+    , m_memoryAction(nullptr)
+    , m_showStatsAction(nullptr)
+    , m_statsAction(nullptr)
+    , m_searchShortcut(nullptr)
+    , m_searchDialog(nullptr)
+    , m_searchEdit(nullptr)
+    , m_searchRangeCombo(nullptr)
+    , m_searchResults(nullptr)
+    , m_historyFirstDoc(0)
+    , m_historyFocusRow(-1)
+    , m_showingHistory(false)
+    , m_firstSequence(0)
+    , m_nextSequence(0)
+    , m_displayedFirstSequence(0)
+    , m_rebuildDisplay(true)
+    , m_statusText(tr("Disconnected"))
+    , m_showStatistics(false)
     , m_backgroundColor(0, 0, 0)
     , m_textColor(255, 255, 255)
     , m_opacity(0.7f)
@@ -60,29 +113,63 @@ ChatOverlay::ChatOverlay(QWidget* parent)
     setupContextMenu();
     setupShortcuts();
     
-    // Connect to chat client signals
-    connect(&m_chatClient, &KickChatClient::messageReceived, this, &ChatOverlay::onMessageReceived);
-    connect(&m_chatClient, &KickChatClient::connected, this, &ChatOverlay::onConnected);
-    connect(&m_chatClient, &KickChatClient::disconnected, this, &ChatOverlay::onDisconnected);
-    connect(&m_chatClient, &KickChatClient::error, this, &ChatOverlay::onError);
+    // Messages come through the shared store; connection state straight from the client
+    connect(m_store, &ChatMessageStore::messageAppended, this, &ChatOverlay::onMessageReceived);
+    connect(m_store, &ChatMessageStore::messagesRemoved, this, &ChatOverlay::onMessagesRemoved);
+    connect(m_chatClient, &KickChatClient::connected, this, &ChatOverlay::onConnected);
+    connect(m_chatClient, &KickChatClient::disconnected, this, &ChatOverlay::onDisconnected);
+    connect(m_chatClient, &KickChatClient::error, this, &ChatOverlay::onError);
+    connect(&m_rowRenderer, &RowRenderer::rowsReady, this, &ChatOverlay::onRowsReady);
+    m_rowRenderer.setWarmUpText(GlyphUsage::warmUpSlices());
     
     // Setup cleanup timer
-    connect(&m_cleanupTimer, &QTimer::timeout, this, &ChatOverlay::onCleanupTimer);
+    connect(&m_cleanupTimer, &ClockTimer::timeout, this, &ChatOverlay::onCleanupTimer);
     m_cleanupTimer.start(10000); // Check for old messages every 10 seconds
     
     // Setup display update timer
-    connect(&m_updateDisplayTimer, &QTimer::timeout, this, &ChatOverlay::onUpdateDisplayTimer);
+    connect(&m_updateDisplayTimer, &ClockTimer::timeout, this, &ChatOverlay::onUpdateDisplayTimer);
     m_updateDisplayTimer.setSingleShot(false);
     m_updateDisplayTimer.setInterval(m_updateInterval);
     m_updateDisplayTimer.start();
     
-    // Load saved settings
+    registerMemoryConsumers();
+    
+    // The client may already be mid-handshake if main() started it early
+    if (!m_chatClient->channelName().isEmpty()) {
+        m_channelName = m_chatClient->channelName();
+        setStatusText(tr("Connecting to %1...").arg(m_channelName));
+    }
+    
+    // Load saved settings, then a window opened mid-stream starts with what the
+    // store already holds; all of it is laid out once
+    ++m_settingsBatchDepth;
     onLoadSettings();
+    
+    const QList<ChatMessage> recent = m_store->tail(m_maxMessages);
+    for (const ChatMessage& message : recent) {
+        ChatMessage filtered = message;
+        if (!(m_filterEngine.apply(filtered) & ChatFilterEngine::Drop)) {
+            if (!filtered.messageId().isEmpty()) {
+                m_sequenceById.insert(filtered.messageId(), m_nextSequence);
+            }
+            m_messages.append(filtered);
+            ++m_nextSequence;
+        }
+    }
+    --m_settingsBatchDepth;
+    if (m_displayNeedsUpdate || !m_messages.isEmpty()) {
+        refreshDisplay();
+    }
+}
+
+int ChatOverlay::windowIndex() const
+{
+    return m_windowIndex;
 }
 
 ChatOverlay::~ChatOverlay()
 {
-    m_chatClient.disconnectFromChannel();
+    // The client is shared with other windows; its owner disconnects it
     
     // Clean up actions
     delete m_connectAction;
@@ -98,10 +185,22 @@ ChatOverlay::~ChatOverlay()
     delete m_clickThroughAction;
     delete m_lockPositionAction;
     delete m_setHotkeyAction;
+    delete m_searchAction;
+    delete m_liveChatAction;
+    delete m_filtersAction;
+    delete m_dedupAction;
+    delete m_floodLimitAction;
+    delete m_smoothingAction;
+    delete m_newWindowAction;
+    delete m_closeWindowAction;
+    delete m_memoryAction;
+    delete m_showStatsAction;
+    delete m_statsAction;
     
     // Clean up shortcuts
     delete m_toggleVisibilityShortcut;
     delete m_lockPositionShortcut;
+    delete m_searchShortcut;
     
     // Clean up widget pool
     while (!m_messageWidgetPool.isEmpty()) {
@@ -115,6 +214,10 @@ void ChatOverlay::setupUi()
 {
     ui->setupUi(this);
     
+    if (m_windowIndex > 0) {
+        setWindowTitle(tr("Kick Chat Overlay %1").arg(m_windowIndex + 1));
+    }
+    
     // Configure window flags for overlay
     setWindowFlags(Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::Tool);
     setAttribute(Qt::WA_TranslucentBackground);
@@ -124,8 +227,8 @@ void ChatOverlay::setupUi()
     QScreen* screen = QApplication::primaryScreen();
     if (screen) {
         QRect screenGeometry = screen->geometry();
-        int x = screenGeometry.width() - this->width() - 20;
-        int y = 20;
+        int x = screenGeometry.width() - this->width() - 20 - m_windowIndex * 40;
+        int y = 20 + m_windowIndex * 40;
         move(x, y);
     }
 }
@@ -134,6 +237,69 @@ void ChatOverlay::setupContextMenu()
 {
     setContextMenuPolicy(Qt::CustomContextMenu);
     
+    // Actions are created on the first right-click, keeping them off the startup path
+    connect(this, &QWidget::customContextMenuRequested, this, [this](const QPoint& pos) {
+        // Only show context menu if position is not locked
+        if (!m_positionLocked || !m_clickThroughEnabled) {
+            if (!m_connectAction) {
+                createContextMenuActions();
+            }
+            
+            QMenu contextMenu(tr("Chat Overlay Menu"), this);
+            
+            // Update action states
+            m_disconnectAction->setEnabled(m_chatClient->isConnected());
+            m_clickThroughAction->setChecked(m_clickThroughEnabled);
+            m_lockPositionAction->setChecked(m_positionLocked);
+            m_showStatsAction->setChecked(m_showStatistics);
+            
+            // Add actions to menu
+            contextMenu.addAction(m_connectAction);
+            contextMenu.addAction(m_disconnectAction);
+            contextMenu.addSeparator();
+            contextMenu.addAction(m_searchAction);
+            if (m_showingHistory) {
+                contextMenu.addAction(m_liveChatAction);
+            }
+            contextMenu.addSeparator();
+            contextMenu.addAction(m_bgColorAction);
+            contextMenu.addAction(m_textColorAction);
+            contextMenu.addAction(m_opacityAction);
+            contextMenu.addAction(m_fontSizeAction);
+            contextMenu.addAction(m_maxMsgAction);
+            contextMenu.addAction(m_durationAction);
+            contextMenu.addAction(m_filtersAction);
+            contextMenu.addAction(m_dedupAction);
+            contextMenu.addAction(m_floodLimitAction);
+            contextMenu.addAction(m_smoothingAction);
+            if (m_store->statistics()) {
+                contextMenu.addAction(m_showStatsAction);
+                contextMenu.addAction(m_statsAction);
+            }
+            contextMenu.addSeparator();
+            contextMenu.addAction(m_clickThroughAction);
+            contextMenu.addAction(m_lockPositionAction);
+            contextMenu.addAction(m_setHotkeyAction);
+            contextMenu.addSeparator();
+            contextMenu.addAction(m_newWindowAction);
+            if (m_windowIndex > 0) {
+                contextMenu.addAction(m_closeWindowAction);
+            }
+            contextMenu.addAction(m_saveAction);
+            if (m_store->memoryBudget()) {
+                contextMenu.addAction(m_memoryAction);
+            }
+            contextMenu.addSeparator();
+            contextMenu.addAction(m_exitAction);
+            
+            // Show the menu
+            contextMenu.exec(mapToGlobal(pos));
+        }
+    });
+}
+
+void ChatOverlay::createContextMenuActions()
+{
     // Create actions
     m_connectAction = new QAction("Connect to channel...", this);
     m_disconnectAction = new QAction("Disconnect", this);
@@ -148,9 +314,21 @@ void ChatOverlay::setupContextMenu()
     m_clickThroughAction = new QAction("Click-through mode", this);
     m_lockPositionAction = new QAction("Lock position", this);
     m_setHotkeyAction = new QAction("Configure hotkeys...", this);
+    m_searchAction = new QAction("Search history...", this);
+    m_liveChatAction = new QAction("Return to live chat", this);
+    m_filtersAction = new QAction("Edit filters and highlights...", this);
+    m_dedupAction = new QAction("Set duplicate window...", this);
+    m_floodLimitAction = new QAction("Set flood limit...", this);
+    m_smoothingAction = new QAction("Smooth bursts...", this);
+    m_newWindowAction = new QAction("New overlay window", this);
+    m_closeWindowAction = new QAction("Close this window", this);
+    m_memoryAction = new QAction("Memory usage...", this);
+    m_showStatsAction = new QAction("Show chat statistics", this);
+    m_statsAction = new QAction("Chat statistics...", this);
     
     m_clickThroughAction->setCheckable(true);
     m_lockPositionAction->setCheckable(true);
+    m_showStatsAction->setCheckable(true);
     
     // Connect action signals
     connect(m_connectAction, &QAction::triggered, this, [this]() {
@@ -219,44 +397,80 @@ void ChatOverlay::setupContextMenu()
     });
     
     connect(m_saveAction, &QAction::triggered, this, &ChatOverlay::onSaveSettings);
-    connect(m_exitAction, &QAction::triggered, this, &QWidget::close);
+    connect(m_newWindowAction, &QAction::triggered, this, &ChatOverlay::newWindowRequested);
+    connect(m_exitAction, &QAction::triggered, qApp, &QCoreApplication::quit);
+    connect(m_closeWindowAction, &QAction::triggered, this, &QWidget::close);
+    
+    connect(m_showStatsAction, &QAction::toggled, this, [this](bool checked) {
+        m_showStatistics = checked;
+        updateStatusLabel();
+    });
+    
+    connect(m_statsAction, &QAction::triggered, this, [this]() {
+        ChatStatistics* statistics = m_store->statistics();
+        qint64 now = Clock::instance()->nowMs();
+        QString text = tr("%1 msg/s, %2 msg/min\n").arg(statistics->messagesPerSecond(now), 0, 'f', 1)
+                                                   .arg(statistics->messagesPerMinute(now));
+        
+        for (int i = 0; i < ChatStatistics::WindowCount; ++i) {
+            ChatStatistics::Window window = static_cast<ChatStatistics::Window>(i);
+            QStringList chatters;
+            for (const ChatStatistics::Ranked& ranked : statistics->topChatters(window, now).mid(0, 5)) {
+                chatters << QString("%1 (%2)").arg(ranked.key).arg(ranked.count);
+            }
+            QStringList emotes;
+            for (const ChatStatistics::Ranked& ranked : statistics->topEmotes(window, now).mid(0, 5)) {
+                emotes << QString("%1 (%2)").arg(ranked.key).arg(ranked.count);
+            }
+            
+            text += tr("\nLast %1 min: %2 messages, ~%3 chatters\nTop chatters: %4\nTop emotes: %5\n")
+                .arg(ChatStatistics::windowMinutes(window))
+                .arg(statistics->messageCount(window, now))
+                .arg(statistics->uniqueChatters(window, now))
+                .arg(chatters.join(", "), emotes.join(", "));
+        }
+        
+        QMessageBox::information(this, tr("Chat Statistics"), text);
+    });
+    
+    connect(m_memoryAction, &QAction::triggered, this, [this]() {
+        QMessageBox::information(this, tr("Memory Usage"), m_store->memoryBudget()->report());
+    });
     
     connect(m_clickThroughAction, &QAction::triggered, this, &ChatOverlay::toggleClickThrough);
     connect(m_lockPositionAction, &QAction::triggered, this, &ChatOverlay::toggleLockPosition);
     connect(m_setHotkeyAction, &QAction::triggered, this, &ChatOverlay::showHotkeyDialog);
+    connect(m_searchAction, &QAction::triggered, this, &ChatOverlay::showSearchDialog);
+    connect(m_liveChatAction, &QAction::triggered, this, &ChatOverlay::returnToLiveChat);
+    connect(m_filtersAction, &QAction::triggered, this, &ChatOverlay::showFilterDialog);
     
-    // Connect context menu request signal
-    connect(this, &QWidget::customContextMenuRequested, this, [this](const QPoint& pos) {
-        // Only show context menu if position is not locked
-        if (!m_positionLocked || !m_clickThroughEnabled) {
-            QMenu contextMenu(tr("Chat Overlay Menu"), this);
-            
-            // Update action states
-            m_disconnectAction->setEnabled(m_chatClient.isConnected());
-            m_clickThroughAction->setChecked(m_clickThroughEnabled);
-            m_lockPositionAction->setChecked(m_positionLocked);
-            
-            // Add actions to menu
-            contextMenu.addAction(m_connectAction);
-            contextMenu.addAction(m_disconnectAction);
-            contextMenu.addSeparator();
-            contextMenu.addAction(m_bgColorAction);
-            contextMenu.addAction(m_textColorAction);
-            contextMenu.addAction(m_opacityAction);
-            contextMenu.addAction(m_fontSizeAction);
-            contextMenu.addAction(m_maxMsgAction);
-            contextMenu.addAction(m_durationAction);
-            contextMenu.addSeparator();
-            contextMenu.addAction(m_clickThroughAction);
-            contextMenu.addAction(m_lockPositionAction);
-            contextMenu.addAction(m_setHotkeyAction);
-            contextMenu.addSeparator();
-            contextMenu.addAction(m_saveAction);
-            contextMenu.addSeparator();
-            contextMenu.addAction(m_exitAction);
-            
-            // Show the menu
-            contextMenu.exec(mapToGlobal(pos));
+    connect(m_dedupAction, &QAction::triggered, this, [this]() {
+        bool ok;
+        int seconds = QInputDialog::getInt(this, tr("Set Duplicate Window"),
+                                       tr("Collapse repeats within seconds (0 to disable):"), 
+                                       m_deduplicator.window(), 0, 300, 1, &ok);
+        if (ok) {
+            setDuplicateWindow(seconds);
+        }
+    });
+    
+    connect(m_floodLimitAction, &QAction::triggered, this, [this]() {
+        bool ok;
+        int rate = QInputDialog::getInt(this, tr("Set Flood Limit"),
+                                    tr("Maximum new messages per second:"), 
+                                    m_admission.maxRate(), 1, 200, 1, &ok);
+        if (ok) {
+            setMaxMessageRate(rate);
+        }
+    });
+    
+    connect(m_smoothingAction, &QAction::triggered, this, [this]() {
+        bool ok;
+        int delay = QInputDialog::getInt(this, tr("Smooth Bursts"),
+                                     tr("Spread bursts of chat over this many milliseconds (0 = off):"),
+                                     m_presentationBuffer.delay(), 0, 5000, 100, &ok);
+        if (ok) {
+            setPresentationDelay(delay);
         }
     });
 }
@@ -266,10 +480,12 @@ void ChatOverlay::setupShortcuts()
     // Create global shortcuts
     m_toggleVisibilityShortcut = new QShortcut(m_toggleVisibilitySequence, this);
     m_lockPositionShortcut = new QShortcut(m_lockPositionSequence, this);
+    m_searchShortcut = new QShortcut(QKeySequence::Find, this);
     
     // Connect shortcuts
     connect(m_toggleVisibilityShortcut, &QShortcut::activated, this, &ChatOverlay::toggleVisibility);
     connect(m_lockPositionShortcut, &QShortcut::activated, this, &ChatOverlay::toggleLockPosition);
+    connect(m_searchShortcut, &QShortcut::activated, this, &ChatOverlay::showSearchDialog);
 }
 
 void ChatOverlay::showHotkeyDialog()
@@ -298,6 +514,52 @@ void ChatOverlay::showHotkeyDialog()
     }
 }
 
+void ChatOverlay::showFilterDialog()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Filters and Highlights"));
+    
+    QFormLayout* layout = new QFormLayout(&dialog);
+    
+    // One phrase per line
+    QPlainTextEdit* blockedEdit = new QPlainTextEdit(m_blockedPhrases.join('\n'), &dialog);
+    QPlainTextEdit* maskedEdit = new QPlainTextEdit(m_maskedPhrases.join('\n'), &dialog);
+    QPlainTextEdit* highlightEdit = new QPlainTextEdit(m_highlightPhrases.join('\n'), &dialog);
+    
+    layout->addRow(tr("Hide messages containing:"), blockedEdit);
+    layout->addRow(tr("Mask phrases:"), maskedEdit);
+    layout->addRow(tr("Highlight keywords:"), highlightEdit);
+    
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    layout->addRow(buttons);
+    
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    
+    if (dialog.exec() == QDialog::Accepted) {
+        m_blockedPhrases = blockedEdit->toPlainText().split('\n', Qt::SkipEmptyParts);
+        m_maskedPhrases = maskedEdit->toPlainText().split('\n', Qt::SkipEmptyParts);
+        m_highlightPhrases = highlightEdit->toPlainText().split('\n', Qt::SkipEmptyParts);
+        applyFilterRules();
+    }
+}
+
+void ChatOverlay::applyFilterRules()
+{
+    ChatFilterEngine::Rules rules;
+    rules.blockedPhrases = m_blockedPhrases;
+    rules.maskedPhrases = m_maskedPhrases;
+    rules.highlightPhrases = m_highlightPhrases;
+    
+    // Mentions of the streamer are always highlighted
+    if (!m_channelName.isEmpty()) {
+        rules.highlightPhrases.append("@" + m_channelName);
+    }
+    
+    // Compiles in the background; messages keep using the previous rules until then
+    m_filterEngine.setRules(rules);
+}
+
 void ChatOverlay::setToggleHotkeySequence(const QKeySequence& sequence)
 {
     if (!sequence.isEmpty()) {
@@ -314,6 +576,125 @@ void ChatOverlay::setLockPositionHotkeySequence(const QKeySequence& sequence)
     }
 }
 
+void ChatOverlay::showSearchDialog()
+{
+    // Built on first use and kept around so the last query survives reopening
+    if (!m_searchDialog) {
+        m_searchDialog = new QDialog(this);
+        m_searchDialog->setWindowTitle(tr("Search Chat History"));
+        m_searchDialog->resize(420, 360);
+        
+        QVBoxLayout* layout = new QVBoxLayout(m_searchDialog);
+        QHBoxLayout* queryLayout = new QHBoxLayout();
+        
+        m_searchEdit = new QLineEdit(m_searchDialog);
+        m_searchEdit->setPlaceholderText(tr("words, prefix*, from:user"));
+        m_searchEdit->setClearButtonEnabled(true);
+        
+        m_searchRangeCombo = new QComboBox(m_searchDialog);
+        m_searchRangeCombo->addItem(tr("All time"), 0);
+        m_searchRangeCombo->addItem(tr("Last 5 minutes"), 5 * 60);
+        m_searchRangeCombo->addItem(tr("Last 15 minutes"), 15 * 60);
+        m_searchRangeCombo->addItem(tr("Last hour"), 60 * 60);
+        m_searchRangeCombo->addItem(tr("Last 4 hours"), 4 * 60 * 60);
+        
+        queryLayout->addWidget(m_searchEdit, 1);
+        queryLayout->addWidget(m_searchRangeCombo);
+        layout->addLayout(queryLayout);
+        
+        m_searchResults = new QListWidget(m_searchDialog);
+        layout->addWidget(m_searchResults, 1);
+        
+        QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close, m_searchDialog);
+        QPushButton* liveButton = buttons->addButton(tr("Back to live"), QDialogButtonBox::ActionRole);
+        layout->addWidget(buttons);
+        
+        connect(m_searchEdit, &QLineEdit::textChanged, this, &ChatOverlay::runSearch);
+        connect(m_searchRangeCombo, &QComboBox::currentIndexChanged, this, &ChatOverlay::runSearch);
+        connect(m_store->searchIndex(), &ChatSearchIndex::indexUpdated, this, [this]() {
+            if (m_searchDialog->isVisible() && m_searchResults->count() == 0) {
+                runSearch();
+            }
+        });
+        connect(m_searchResults, &QListWidget::itemActivated, this, [this](QListWidgetItem* item) {
+            jumpToHistory(item->data(Qt::UserRole).toUInt());
+        });
+        connect(liveButton, &QPushButton::clicked, this, &ChatOverlay::returnToLiveChat);
+        connect(buttons, &QDialogButtonBox::rejected, m_searchDialog, &QDialog::hide);
+    }
+    
+    m_searchDialog->show();
+    m_searchDialog->raise();
+    m_searchDialog->activateWindow();
+    m_searchEdit->setFocus();
+    m_searchEdit->selectAll();
+}
+
+void ChatOverlay::runSearch()
+{
+    m_searchResults->clear();
+    
+    QDateTime from;
+    int rangeSeconds = m_searchRangeCombo->currentData().toInt();
+    if (rangeSeconds > 0) {
+        from = Clock::instance()->now().addSecs(-rangeSeconds);
+    }
+    
+    const QList<quint32> hits = m_store->searchIndex()->search(m_searchEdit->text(), from, QDateTime(), 200);
+    for (quint32 docId : hits) {
+        ChatMessage msg = m_store->searchIndex()->message(docId);
+        QListWidgetItem* item = new QListWidgetItem(QString("[%1] %2: %3")
+            .arg(msg.timestamp().toString("HH:mm:ss"), msg.username(), msg.message()),
+            m_searchResults);
+        item->setData(Qt::UserRole, docId);
+    }
+}
+
+void ChatOverlay::jumpToHistory(quint32 docId)
+{
+    // The hit may have been evicted since the search ran
+    quint32 firstLiveDoc = m_store->searchIndex()->firstDocId();
+    if (docId < firstLiveDoc) {
+        return;
+    }
+    
+    // Show the hit with surrounding context, centred as far as the history allows
+    int before = m_maxMessages / 2;
+    quint32 firstDoc = docId > static_cast<quint32>(before) ? docId - before : 0;
+    firstDoc = qMax(firstDoc, firstLiveDoc);
+    
+    // Live chat bypasses the buffer while history is shown; what it already
+    // holds goes first so nothing is presented out of order later
+    if (!m_showingHistory) {
+        releaseBufferedMessages(m_presentationBuffer.takeAll());
+    }
+    
+    m_historyMessages = m_store->searchIndex()->messages(firstDoc, m_maxMessages);
+    m_historyFirstDoc = firstDoc;
+    m_historyFocusRow = static_cast<int>(docId - firstDoc);
+    m_showingHistory = true;
+    
+    setStatusText(tr("History: %1").arg(m_store->searchIndex()->message(docId).timestamp().toString("HH:mm:ss")));
+    updateDisplay();
+    m_displayNeedsUpdate = false;
+}
+
+void ChatOverlay::returnToLiveChat()
+{
+    if (!m_showingHistory) {
+        return;
+    }
+    
+    m_showingHistory = false;
+    m_historyMessages.clear();
+    m_historyFocusRow = -1;
+    m_rebuildDisplay = true;
+    
+    setStatusText(m_chatClient->isConnected() ? tr("Connected") : tr("Disconnected"));
+    updateDisplay();
+    m_displayNeedsUpdate = false;
+}
+
 void ChatOverlay::toggleVisibility()
 {
     setVisible(!isVisible());
@@ -322,13 +703,11 @@ void ChatOverlay::toggleVisibility()
 void ChatOverlay::toggleLockPosition()
 {
     m_positionLocked = !m_positionLocked;
-    m_lockPositionAction->setChecked(m_positionLocked);
 }
 
 void ChatOverlay::toggleClickThrough()
 {
     m_clickThroughEnabled = !m_clickThroughEnabled;
-    m_clickThroughAction->setChecked(m_clickThroughEnabled);
     updateWindowFlags();
 }
 
@@ -336,7 +715,6 @@ void ChatOverlay::setClickThrough(bool enabled)
 {
     if (m_clickThroughEnabled != enabled) {
         m_clickThroughEnabled = enabled;
-        m_clickThroughAction->setChecked(enabled);
         updateWindowFlags();
     }
 }
@@ -384,38 +762,86 @@ void ChatOverlay::mouseReleaseEvent(QMouseEvent* event)
 
 void ChatOverlay::connectToChannel(const QString& channelName)
 {
-    ui->statusLabel->setText(tr("Connecting to %1...").arg(channelName));
-    m_chatClient.connectToChannel(channelName);
+    setStatusText(tr("Connecting to %1...").arg(channelName));
+    
+    if (channelName != m_channelName) {
+        m_channelName = channelName;
+        applyFilterRules();
+    }
+    
+    m_chatClient->connectToChannel(channelName);
 }
 
 void ChatOverlay::disconnectFromChannel()
 {
-    m_chatClient.disconnectFromChannel();
+    m_chatClient->disconnectFromChannel();
 }
 
 void ChatOverlay::onConnected()
 {
-    ui->statusLabel->setText(tr("Connected"));
+    setStatusText(tr("Connected"));
 }
 
 void ChatOverlay::onDisconnected()
 {
-    ui->statusLabel->setText(tr("Disconnected"));
+    setStatusText(tr("Disconnected"));
 }
 
 void ChatOverlay::onError(const QString& errorMessage)
 {
-    ui->statusLabel->setText(tr("Error: %1").arg(errorMessage));
+    setStatusText(tr("Error: %1").arg(errorMessage));
 }
 
 void ChatOverlay::onMessageReceived(const ChatMessage& message)
 {
+    StartupMetrics::mark("first message");
+    
+    // Hidden windows don't render, so there is nothing to smooth
+    if (m_presentationBuffer.isEnabled() && !m_renderingSuspended && !m_showingHistory) {
+        m_presentationBuffer.push(message, Clock::instance()->nowMs());
+        return;
+    }
+    
+    presentMessage(message);
+}
+
+void ChatOverlay::presentMessage(const ChatMessage& message)
+{
+    // One pass over the text decides drop, mask and highlight
+    ChatMessage filtered = message;
+    if (m_filterEngine.apply(filtered) & ChatFilterEngine::Drop) {
+        return;
+    }
+    
+    // Repeats of a message still on screen bump its counter instead of adding a row
+    quint64 contentKey = ChatDeduplicator::contentKey(filtered.message());
+    qint64 timestampMs = filtered.timestamp().toMSecsSinceEpoch();
+    qint64 repeatOf = m_deduplicator.find(contentKey, timestampMs);
+    if (repeatOf >= m_firstSequence && !m_messages.at(static_cast<int>(repeatOf - m_firstSequence)).isDeleted()) {
+        ChatMessage& original = m_messages[static_cast<int>(repeatOf - m_firstSequence)];
+        original.setRepeatCount(original.repeatCount() + 1);
+        m_rowHtml.remove(repeatOf);
+        m_rowRenderer.invalidate(repeatOf);
+        m_changedRows.insert(repeatOf);
+        m_displayNeedsUpdate = true;
+        return;
+    }
+    
+    // Under overload only a sample of ordinary chat gets a row; priority always does
+    if (!m_admission.admit(filtered, Clock::instance()->nowMs())) {
+        return;
+    }
+    
     // Add message to the list
-    m_messages.append(message);
+    if (!filtered.messageId().isEmpty()) {
+        m_sequenceById.insert(filtered.messageId(), m_nextSequence);
+    }
+    m_messages.append(filtered);
+    m_deduplicator.remember(contentKey, m_nextSequence++, timestampMs);
     
     // Enforce maximum messages limit
     while (m_messages.size() > m_maxMessages) {
-        m_messages.removeFirst();
+        removeOldestMessage();
     }
     
     // Mark display for update but don't update immediately
@@ -423,12 +849,98 @@ void ChatOverlay::onMessageReceived(const ChatMessage& message)
     m_displayNeedsUpdate = true;
 }
 
+void ChatOverlay::onMessagesRemoved(const QStringList& messageIds)
+{
+    // Rows still waiting in the jitter buffer are simply never shown
+    m_presentationBuffer.remove(messageIds);
+    
+    QLayout* layout = ui->scrollArea->widget()->layout();
+    
+    // Deleted rows become hidden tombstones, so sequence numbers and the rows
+    // around them stay put and nothing else is laid out again
+    for (const QString& messageId : messageIds) {
+        auto it = m_sequenceById.find(messageId);
+        if (it == m_sequenceById.end()) {
+            continue;
+        }
+        
+        qint64 sequence = it.value();
+        m_sequenceById.erase(it);
+        m_messages[static_cast<int>(sequence - m_firstSequence)].setDeleted(true);
+        
+        // The history view has different rows; it picks this up on return
+        if (m_showingHistory) {
+            continue;
+        }
+        
+        int row = static_cast<int>(sequence - m_displayedFirstSequence);
+        QLayoutItem* item = row >= 0 && row < layout->count() ? layout->itemAt(row) : nullptr;
+        if (item && item->widget()) {
+            item->widget()->hide();
+        }
+    }
+}
+
+void ChatOverlay::removeOldestMessage()
+{
+    auto it = m_sequenceById.find(m_messages.first().messageId());
+    if (it != m_sequenceById.end() && it.value() == m_firstSequence) {
+        m_sequenceById.erase(it);
+    }
+    
+    m_rowHtml.remove(m_firstSequence);
+    m_messages.removeFirst();
+    ++m_firstSequence;
+}
+
+void ChatOverlay::setStatusText(const QString& text)
+{
+    m_statusText = text;
+    updateStatusLabel();
+}
+
+void ChatOverlay::updateStatusLabel()
+{
+    QString text = m_statusText;
+    
+    // Say what is being held back so a flood degrades visibly, not silently
+    if (m_admission.isThrottling()) {
+        text += tr(" | flood: %1 msg/s, %2 hidden (%3 total)")
+            .arg(qRound(m_admission.arrivalRate()))
+            .arg(m_admission.suppressedRecently())
+            .arg(m_admission.suppressedCount());
+    }
+    
+    if (m_showStatistics && m_store->statistics()) {
+        text += " | " + m_store->statistics()->summary(Clock::instance()->nowMs());
+    }
+    
+    if (ui->statusLabel->text() != text) {
+        ui->statusLabel->setText(text);
+    }
+}
+
 void ChatOverlay::onUpdateDisplayTimer()
 {
-    if (m_displayNeedsUpdate) {
+    // Release this tick's share of buffered chat; the admission rate is the
+    // render budget, so a steady release never outpaces what can be drawn
+    if (m_presentationBuffer.size() > 0) {
+        releaseBufferedMessages(m_presentationBuffer.takeDue(Clock::instance()->nowMs(),
+                                                             m_admission.admitRate()));
+    }
+    
+    // Live messages keep accumulating while browsing history
+    if (m_displayNeedsUpdate && !m_showingHistory) {
+        QElapsedTimer renderTimer;
+        renderTimer.start();
         updateDisplay();
+        // Layout and raster happen on the pool, so its share counts too
+        m_admission.recordFrame(renderTimer.nsecsElapsed() + m_rowRenderer.takeRenderNs(), m_updateInterval);
         m_displayNeedsUpdate = false;
     }
+    
+    m_admission.tick(Clock::instance()->nowMs());
+    updateStatusLabel();
 }
 
 QLabel* ChatOverlay::getMessageLabel()
@@ -459,26 +971,124 @@ void ChatOverlay::recycleMessageLabel(QLabel* label)
     }
 }
 
-// Add this function to escape HTML characters
-QString escapeHtml(const QString& input)
+void ChatOverlay::registerMemoryConsumers()
 {
-    QString escaped = input;
-    escaped.replace("&", "&amp;");
-    escaped.replace("<", "&lt;");
-    escaped.replace(">", "&gt;");
-    escaped.replace("\"", "&quot;");
-    escaped.replace("'", "&#39;");
-    return escaped;
+    MemoryBudget* budget = m_store->memoryBudget();
+    if (!budget) {
+        return;
+    }
+    
+    // Pooled labels are pure cache and go first; row images can be rendered
+    // again from the messages
+    budget->registerConsumer(this, "Widget pool", MemoryBudget::WidgetPool,
+                             [this]() { return m_messageWidgetPool.size() * EstimatedLabelBytes; },
+                             [this](qint64 bytes) { return releaseWidgetPool(bytes); });
+    budget->registerConsumer(this, "Row images", MemoryBudget::ImageCache,
+                             [this]() { return m_rowRenderer.memoryUsage(); },
+                             [this](qint64 bytes) { return m_rowRenderer.releaseOldest(bytes); });
+}
+
+qint64 ChatOverlay::releaseWidgetPool(qint64 bytes)
+{
+    qint64 released = 0;
+    
+    while (!m_messageWidgetPool.isEmpty() && released < bytes) {
+        delete m_messageWidgetPool.dequeue();
+        released += EstimatedLabelBytes;
+    }
+    
+    return released;
+}
+
+QString ChatOverlay::formatRow(const ChatMessage& msg, bool focused) const
+{
+    // Format text with HTML (escape user content to prevent XSS)
+    QString formattedMessage = QString("<span style='color: %1; font-weight: bold;'>%2:</span> <span style='color: %3;'>%4</span>")
+        .arg(msg.usernameColorName(), 
+             TextSanitizer::escapeHtml(msg.username()), 
+             m_textColor.name(), 
+             TextSanitizer::escapeHtml(msg.message()));
+    
+    if (msg.repeatCount() > 1) {
+        formattedMessage += QString(" <span style='color: #a0a0a0; font-weight: bold;'>&times;%1</span>")
+            .arg(msg.repeatCount());
+    }
+    
+    // Mark the search hit when browsing history, and keyword/mention highlights
+    if (focused) {
+        formattedMessage = QString("<span style='background-color: #5a4a00;'>%1</span>").arg(formattedMessage);
+    } else if (msg.isHighlighted()) {
+        formattedMessage = QString("<span style='background-color: #3c2a6e;'>%1</span>").arg(formattedMessage);
+    }
+    
+    return formattedMessage;
+}
+
+const QString& ChatOverlay::rowHtml(qint64 sequence)
+{
+    auto it = m_rowHtml.find(sequence);
+    if (it == m_rowHtml.end()) {
+        it = m_rowHtml.insert(sequence, formatRow(m_messages.at(static_cast<int>(sequence - m_firstSequence)), false));
+    }
+    return it.value();
 }
 
 void ChatOverlay::updateDisplay()
 {
+    QLayout* layout = ui->scrollArea->widget()->layout();
+    
+    // Rows rendered for another width, font or DPI are redone in the
+    // background; every label picks up its stand-in meanwhile
+    if (m_rowRenderer.setLayout(rowWidth(), messageFont(), devicePixelRatioF())) {
+        m_rebuildDisplay = true;
+    }
+    
+    // The history view replaces every row; live chat only changes at the ends
+    // and where a repeat count went up
+    if (m_showingHistory || m_rebuildDisplay) {
+        rebuildDisplay();
+    } else {
+        while (m_displayedFirstSequence < m_firstSequence && layout->count() > 0) {
+            QLayoutItem* item = layout->takeAt(0);
+            recycleMessageLabel(qobject_cast<QLabel*>(item->widget()));
+            delete item;
+            ++m_displayedFirstSequence;
+        }
+        m_displayedFirstSequence = qMax(m_displayedFirstSequence, m_firstSequence);
+        
+        for (qint64 sequence : std::as_const(m_changedRows)) {
+            int row = static_cast<int>(sequence - m_displayedFirstSequence);
+            if (row >= 0 && row < layout->count()
+                && !m_messages.at(static_cast<int>(sequence - m_firstSequence)).isDeleted()) {
+                showRow(qobject_cast<QLabel*>(layout->itemAt(row)->widget()), sequence, rowHtml(sequence));
+            }
+        }
+        
+        for (qint64 sequence = m_displayedFirstSequence + layout->count(); sequence < m_nextSequence; ++sequence) {
+            const ChatMessage& msg = m_messages.at(static_cast<int>(sequence - m_firstSequence));
+            appendRow(sequence, msg.isDeleted() ? QString() : rowHtml(sequence));
+        }
+    }
+    m_changedRows.clear();
+    
+    // Scroll to bottom, or to the search hit when browsing history
+    int scrollRow = m_showingHistory ? m_historyFocusRow : layout->count() - 1;
+    QLayoutItem* lastItem = layout->itemAt(scrollRow);
+    if (lastItem && lastItem->widget()) {
+        ui->scrollArea->ensureWidgetVisible(lastItem->widget());
+    }
+}
+
+void ChatOverlay::rebuildDisplay()
+{
+    QLayout* layout = ui->scrollArea->widget()->layout();
+    
     // Store widgets to recycle
     QList<QLabel*> labelsToRecycle;
     
     // Clear the layout but keep the widgets for recycling
     QLayoutItem* item;
-    while ((item = ui->scrollArea->widget()->layout()->takeAt(0)) != nullptr) {
+    while ((item = layout->takeAt(0)) != nullptr) {
         QLabel* label = qobject_cast<QLabel*>(item->widget());
         if (label) {
             labelsToRecycle.append(label);
@@ -486,39 +1096,78 @@ void ChatOverlay::updateDisplay()
         delete item;
     }
     
-    // Add current messages
-    for (const ChatMessage& msg : m_messages) {
-        QLabel* messageLabel = getMessageLabel();
-        
-        // Format text with HTML (escape user content to prevent XSS)
-        QString formattedMessage = QString("<span style='color: %1; font-weight: bold;'>%2:</span> <span style='color: %3;'>%4</span>")
-            .arg(msg.usernameColor().name(), 
-                 escapeHtml(msg.username()), 
-                 m_textColor.name(), 
-                 escapeHtml(msg.message()));
-        
-        messageLabel->setText(formattedMessage);
-        messageLabel->setTextFormat(Qt::RichText);
-        messageLabel->setWordWrap(true);
-        
-        // Set font size
-        QFont font = messageLabel->font();
-        font.setPointSize(m_fontSize);
-        messageLabel->setFont(font);
-        
-        // Add to layout
-        ui->scrollArea->widget()->layout()->addWidget(messageLabel);
+    // Add current messages (or the history window picked from search)
+    if (m_showingHistory) {
+        for (int row = 0; row < m_historyMessages.size(); ++row) {
+            const ChatMessage& msg = m_historyMessages.at(row);
+            bool focused = row == m_historyFocusRow;
+            appendRow(historyRowKey(m_historyFirstDoc + row, focused),
+                      msg.isDeleted() ? QString() : formatRow(msg, focused));
+        }
+    } else {
+        m_displayedFirstSequence = m_firstSequence;
+        for (qint64 sequence = m_firstSequence; sequence < m_nextSequence; ++sequence) {
+            const ChatMessage& msg = m_messages.at(static_cast<int>(sequence - m_firstSequence));
+            appendRow(sequence, msg.isDeleted() ? QString() : rowHtml(sequence));
+        }
+        m_rebuildDisplay = false;
     }
     
     // Recycle unused labels
     for (QLabel* label : labelsToRecycle) {
         recycleMessageLabel(label);
     }
+}
+
+void ChatOverlay::appendRow(qint64 key, const QString& html)
+{
+    QLabel* messageLabel = getMessageLabel();
+    ui->scrollArea->widget()->layout()->addWidget(messageLabel);
     
-    // Scroll to bottom
-    QLayoutItem* lastItem = ui->scrollArea->widget()->layout()->itemAt(ui->scrollArea->widget()->layout()->count() - 1);
-    if (lastItem && lastItem->widget()) {
-        ui->scrollArea->ensureWidgetVisible(lastItem->widget());
+    // Deleted messages keep an empty hidden row so rows map 1:1 to sequences
+    if (html.isEmpty()) {
+        messageLabel->hide();
+        return;
+    }
+    showRow(messageLabel, key, html);
+}
+
+void ChatOverlay::showRow(QLabel* label, qint64 key, const QString& html)
+{
+    // A row still being rendered shows its previous image (or nothing) and
+    // is filled in by onRowsReady
+    bool current = false;
+    QPixmap row = m_rowRenderer.row(key, html, &current);
+    if (row.isNull()) {
+        label->clear();
+    } else {
+        label->setPixmap(row);
+    }
+    label->setProperty("rowKey", current ? QVariant() : QVariant(key));
+    label->show();
+}
+
+void ChatOverlay::onRowsReady()
+{
+    QLayout* layout = ui->scrollArea->widget()->layout();
+    
+    for (int i = 0; i < layout->count(); ++i) {
+        QLabel* label = qobject_cast<QLabel*>(layout->itemAt(i)->widget());
+        QVariant key = label ? label->property("rowKey") : QVariant();
+        if (!key.isValid()) {
+            continue;
+        }
+        
+        QPixmap row = m_rowRenderer.cachedRow(key.toLongLong());
+        if (!row.isNull()) {
+            label->setPixmap(row);
+            label->setProperty("rowKey", QVariant());
+        }
+    }
+    
+    // Rows may have grown, keep following the newest one
+    if (!m_showingHistory && layout->count() > 0 && layout->itemAt(layout->count() - 1)->widget()) {
+        ui->scrollArea->ensureWidgetVisible(layout->itemAt(layout->count() - 1)->widget());
     }
 }
 
@@ -528,12 +1177,12 @@ void ChatOverlay::onCleanupTimer()
         return; // No expiration
     }
     
-    QDateTime cutoffTime = QDateTime::currentDateTime().addSecs(-m_messageDuration);
+    QDateTime cutoffTime = Clock::instance()->now().addSecs(-m_messageDuration);
     bool messagesRemoved = false;
     
-    // Remove messages older than the duration
-    while (!m_messages.isEmpty() && m_messages.first().timestamp() < cutoffTime) {
-        m_messages.removeFirst();
+    // Rows expire by arrival, so history prefilled on connect gets the full duration
+    while (!m_messages.isEmpty() && m_messages.first().receivedAt() < cutoffTime) {
+        removeOldestMessage();
         messagesRemoved = true;
     }
     
@@ -552,7 +1201,21 @@ void ChatOverlay::setBackgroundColor(const QColor& color)
 void ChatOverlay::setTextColor(const QColor& color)
 {
     m_textColor = color;
-    updateDisplay(); // User action, update immediately
+    m_rowHtml.clear();
+    m_rowRenderer.invalidateAll();
+    m_rebuildDisplay = true;
+    refreshDisplay(); // User action, update immediately
+}
+
+void ChatOverlay::refreshDisplay()
+{
+    // Nobody can see it; the catch-up on show lays it out once
+    if (m_settingsBatchDepth > 0 || m_renderingSuspended) {
+        m_displayNeedsUpdate = true;
+        return;
+    }
+    
+    updateDisplay();
     m_displayNeedsUpdate = false;
 }
 
@@ -568,10 +1231,10 @@ void ChatOverlay::setMaxMessages(int count)
     
     // Remove excess messages if necessary
     while (m_messages.size() > m_maxMessages) {
-        m_messages.removeFirst();
+        removeOldestMessage();
     }
     
-    updateDisplay();
+    refreshDisplay();
 }
 
 void ChatOverlay::setMessageDuration(int seconds)
@@ -582,7 +1245,46 @@ void ChatOverlay::setMessageDuration(int seconds)
 void ChatOverlay::setFontSize(int size)
 {
     m_fontSize = size;
-    updateDisplay();
+    refreshDisplay();
+}
+
+QFont ChatOverlay::messageFont() const
+{
+    QFont font = QApplication::font("QLabel");
+    font.setPointSize(m_fontSize);
+    return font;
+}
+
+int ChatOverlay::rowWidth() const
+{
+    // Always leave room for the scroll bar so it appearing doesn't re-render every row
+    return qMax(1, ui->scrollArea->width() - 2 * ui->scrollArea->frameWidth()
+                   - ui->scrollArea->verticalScrollBar()->sizeHint().width());
+}
+
+void ChatOverlay::setDuplicateWindow(int seconds)
+{
+    m_deduplicator.setWindow(seconds);
+}
+
+void ChatOverlay::setMaxMessageRate(int messagesPerSecond)
+{
+    m_admission.setMaxRate(messagesPerSecond);
+}
+
+void ChatOverlay::setPresentationDelay(int ms)
+{
+    m_presentationBuffer.setDelay(ms);
+    if (!m_presentationBuffer.isEnabled()) {
+        releaseBufferedMessages(m_presentationBuffer.takeAll());
+    }
+}
+
+void ChatOverlay::releaseBufferedMessages(const QList<ChatMessage>& messages)
+{
+    for (const ChatMessage& message : messages) {
+        presentMessage(message);
+    }
 }
 
 void ChatOverlay::setPosition(const QPoint& position)
@@ -590,9 +1292,17 @@ void ChatOverlay::setPosition(const QPoint& position)
     move(position);
 }
 
+void ChatOverlay::openSettings(QSettings& settings) const
+{
+    if (m_windowIndex > 0) {
+        settings.beginGroup(QString("window%1").arg(m_windowIndex + 1));
+    }
+}
+
 void ChatOverlay::onSaveSettings()
 {
     QSettings settings("KickChatOverlay", "Settings");
+    openSettings(settings);
     
     settings.setValue("backgroundColor", m_backgroundColor);
     settings.setValue("textColor", m_textColor);
@@ -600,11 +1310,18 @@ void ChatOverlay::onSaveSettings()
     settings.setValue("maxMessages", m_maxMessages);
     settings.setValue("messageDuration", m_messageDuration);
     settings.setValue("fontSize", m_fontSize);
+    settings.setValue("duplicateWindow", m_deduplicator.window());
+    settings.setValue("maxMessageRate", m_admission.maxRate());
+    settings.setValue("presentationDelay", m_presentationBuffer.delay());
     settings.setValue("position", pos());
     settings.setValue("clickThroughEnabled", m_clickThroughEnabled);
     settings.setValue("positionLocked", m_positionLocked);
     settings.setValue("toggleVisibilitySequence", m_toggleVisibilitySequence.toString());
     settings.setValue("lockPositionSequence", m_lockPositionSequence.toString());
+    settings.setValue("blockedPhrases", m_blockedPhrases);
+    settings.setValue("maskedPhrases", m_maskedPhrases);
+    settings.setValue("highlightPhrases", m_highlightPhrases);
+    settings.setValue("showStatistics", m_showStatistics);
     
     QMessageBox::information(this, tr("Settings Saved"), tr("Your settings have been saved."));
 }
@@ -612,6 +1329,10 @@ void ChatOverlay::onSaveSettings()
 void ChatOverlay::onLoadSettings()
 {
     QSettings settings("KickChatOverlay", "Settings");
+    openSettings(settings);
+    
+    // Apply everything first, then lay out once
+    ++m_settingsBatchDepth;
     
     if (settings.contains("backgroundColor")) {
         setBackgroundColor(settings.value("backgroundColor").value<QColor>());
@@ -637,6 +1358,18 @@ void ChatOverlay::onLoadSettings()
         setFontSize(settings.value("fontSize").toInt());
     }
     
+    if (settings.contains("duplicateWindow")) {
+        setDuplicateWindow(settings.value("duplicateWindow").toInt());
+    }
+    
+    if (settings.contains("maxMessageRate")) {
+        setMaxMessageRate(settings.value("maxMessageRate").toInt());
+    }
+    
+    if (settings.contains("presentationDelay")) {
+        setPresentationDelay(settings.value("presentationDelay").toInt());
+    }
+    
     if (settings.contains("position")) {
         setPosition(settings.value("position").toPoint());
     }
@@ -647,7 +1380,6 @@ void ChatOverlay::onLoadSettings()
     
     if (settings.contains("positionLocked")) {
         m_positionLocked = settings.value("positionLocked").toBool();
-        m_lockPositionAction->setChecked(m_positionLocked);
     }
     
     if (settings.contains("toggleVisibilitySequence")) {
@@ -659,6 +1391,18 @@ void ChatOverlay::onLoadSettings()
         QString seqStr = settings.value("lockPositionSequence").toString();
         setLockPositionHotkeySequence(QKeySequence(seqStr));
     }
+    
+    m_blockedPhrases = settings.value("blockedPhrases").toStringList();
+    m_maskedPhrases = settings.value("maskedPhrases").toStringList();
+    m_highlightPhrases = settings.value("highlightPhrases").toStringList();
+    applyFilterRules();
+    
+    m_showStatistics = settings.value("showStatistics", false).toBool();
+    
+    --m_settingsBatchDepth;
+    if (m_displayNeedsUpdate) {
+        refreshDisplay();
+    }
 }
 
 void ChatOverlay::paintEvent(QPaintEvent* event)
@@ -679,6 +1423,79 @@ void ChatOverlay::paintEvent(QPaintEvent* event)
     QWidget::paintEvent(event);
 }
 
+void ChatOverlay::showEvent(QShowEvent* event)
+{
+    QWidget::showEvent(event);
+    
+    // Expose events report occlusion (and minimizing) on platforms that track it
+    if (windowHandle()) {
+        windowHandle()->removeEventFilter(this);
+        windowHandle()->installEventFilter(this);
+    }
+    updateRenderingState();
+}
+
+void ChatOverlay::hideEvent(QHideEvent* event)
+{
+    QWidget::hideEvent(event);
+    updateRenderingState();
+}
+
+void ChatOverlay::resizeEvent(QResizeEvent* event)
+{
+    QWidget::resizeEvent(event);
+    
+    if (event->size().width() != event->oldSize().width()) {
+        refreshDisplay();
+    }
+}
+
+void ChatOverlay::changeEvent(QEvent* event)
+{
+    QWidget::changeEvent(event);
+    
+    if (event->type() == QEvent::WindowStateChange) {
+        updateRenderingState();
+    }
+}
+
+bool ChatOverlay::eventFilter(QObject* watched, QEvent* event)
+{
+    if (watched == windowHandle() && event->type() == QEvent::Expose) {
+        updateRenderingState();
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void ChatOverlay::updateRenderingState()
+{
+    bool suspended = !isVisible() || isMinimized() || (windowHandle() && !windowHandle()->isExposed());
+    if (suspended == m_renderingSuspended) {
+        return;
+    }
+    m_renderingSuspended = suspended;
+    
+    // While hidden, messages still land in m_messages (trimmed to the limit), but
+    // no timer fires and nothing is laid out or painted
+    if (suspended) {
+        m_updateDisplayTimer.stop();
+        m_cleanupTimer.stop();
+        releaseBufferedMessages(m_presentationBuffer.takeAll());
+        return;
+    }
+    
+    // Catch up with one layout of just the tail that is on screen now
+    onCleanupTimer();
+    if (m_displayNeedsUpdate && !m_showingHistory) {
+        updateDisplay();
+        m_displayNeedsUpdate = false;
+    }
+    updateStatusLabel();
+    
+    m_cleanupTimer.start();
+    m_updateDisplayTimer.start();
+}
+
 void ChatOverlay::contextMenuEvent(QContextMenuEvent* event)
 {
     // We're handling the context menu ourselves with customContextMenuRequested signal
@@ -3,15 +3,29 @@
 
 #include <QWidget>
 #include <QList>
-#include <QTimer>
 #include <QPoint>
 #include <QAction>
 #include <QLabel>
 #include <QQueue>
+#include <QHash>
+#include <QSet>
 #include <QKeySequence>
 #include <QShortcut>
+#include <QDialog>
+#include <QLineEdit>
+#include <QComboBox>
+#include <QListWidget>
+#include <QSettings>
 #include "kickchatclient.h"
 #include "chatmessage.h"
+#include "chatmessagestore.h"
+#include "chatfilterengine.h"
+#include "chatdeduplicator.h"
+#include "admissioncontroller.h"
+#include "presentationbuffer.h"
+#include "glyphusage.h"
+#include "rowrenderer.h"
+#include "clock.h"
 
 namespace Ui {
 class ChatOverlay;
@@ -21,9 +35,14 @@ class ChatOverlay : public QWidget {
     Q_OBJECT
 
 public:
-    explicit ChatOverlay(QWidget* parent = nullptr);
+    // The store (and its client) is shared between windows and not owned; the
+    // client may already be connecting. Window 0 keeps the top-level settings,
+    // every other window gets its own settings group.
+    explicit ChatOverlay(ChatMessageStore* store, int windowIndex = 0, QWidget* parent = nullptr);
     ~ChatOverlay();
 
+    int windowIndex() const;
+
     void connectToChannel(const QString& channelName);
     void disconnectFromChannel();
     
@@ -34,21 +53,33 @@ public:
     void setMaxMessages(int count);
     void setMessageDuration(int seconds);
     void setFontSize(int size);
+    void setDuplicateWindow(int seconds);
+    void setMaxMessageRate(int messagesPerSecond);
+    void setPresentationDelay(int ms);
     void setPosition(const QPoint& position);
     void setClickThrough(bool enabled);
     void setToggleHotkeySequence(const QKeySequence& sequence);
     void setLockPositionHotkeySequence(const QKeySequence& sequence);
 
+signals:
+    void newWindowRequested();
+
 protected:
     void paintEvent(QPaintEvent* event) override;
     void mousePressEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
     void mouseReleaseEvent(QMouseEvent* event) override;
     void contextMenuEvent(QContextMenuEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void changeEvent(QEvent* event) override;
+    bool eventFilter(QObject* watched, QEvent* event) override;
     bool nativeEvent(const QByteArray& eventType, void* message, qintptr* result) override;
 
 private slots:
     void onMessageReceived(const ChatMessage& message);
+    void onMessagesRemoved(const QStringList& messageIds);
     void onConnected();
     void onDisconnected();
     void onError(const QString& errorMessage);
@@ -59,16 +90,24 @@ private slots:
     void toggleVisibility();
     void toggleLockPosition();
     void toggleClickThrough();
+    void showSearchDialog();
+    void runSearch();
+    void returnToLiveChat();
+    void onRowsReady();
 
 private:
     Ui::ChatOverlay* ui;
-    KickChatClient m_chatClient;
+    ChatMessageStore* m_store;
+    KickChatClient* m_chatClient;
+    int m_windowIndex;
     QList<ChatMessage> m_messages;
-    QTimer m_cleanupTimer;
-    QTimer m_updateDisplayTimer;
+    ClockTimer m_cleanupTimer;
+    ClockTimer m_updateDisplayTimer;
     QPoint m_dragPosition;
     bool m_dragging;
     bool m_displayNeedsUpdate;
+    bool m_renderingSuspended;
+    int m_settingsBatchDepth;
     bool m_clickThroughEnabled;
     bool m_positionLocked;
     
@@ -92,6 +131,58 @@ private:
     QAction* m_clickThroughAction;
     QAction* m_lockPositionAction;
     QAction* m_setHotkeyAction;
+    QAction* m_searchAction;
+    QAction* m_liveChatAction;
+    QAction* m_filtersAction;
+    QAction* m_dedupAction;
+    QAction* m_floodLimitAction;
+    QAction* m_smoothingAction;
+    QAction* m_newWindowAction;
+    QAction* m_closeWindowAction;
+    QAction* m_memoryAction;
+    QAction* m_showStatsAction;
+    QAction* m_statsAction;
+    
+    // History search
+    QShortcut* m_searchShortcut;
+    QDialog* m_searchDialog;
+    QLineEdit* m_searchEdit;
+    QComboBox* m_searchRangeCombo;
+    QListWidget* m_searchResults;
+    QList<ChatMessage> m_historyMessages;
+    quint32 m_historyFirstDoc;
+    int m_historyFocusRow;
+    bool m_showingHistory;
+    
+    // Keyword filtering and highlighting
+    ChatFilterEngine m_filterEngine;
+    QStringList m_blockedPhrases;
+    QStringList m_maskedPhrases;
+    QStringList m_highlightPhrases;
+    QString m_channelName;
+    
+    // Repeat collapsing; sequence numbers identify rows across front trimming
+    ChatDeduplicator m_deduplicator;
+    qint64 m_firstSequence;
+    qint64 m_nextSequence;
+    
+    // Deletions and bans find their row by message ID. Live, the layout holds
+    // the rows from m_displayedFirstSequence on; each update trims and appends
+    // at the ends and redraws m_changedRows, unless m_rebuildDisplay is set.
+    QHash<QString, qint64> m_sequenceById;
+    qint64 m_displayedFirstSequence;
+    QSet<qint64> m_changedRows;
+    bool m_rebuildDisplay;
+    
+    // Escaped and formatted HTML of live rows by sequence, built once per
+    // message; a repeat count bump or text color change drops it
+    QHash<qint64, QString> m_rowHtml;
+    
+    // Flood protection
+    AdmissionController m_admission;
+    PresentationBuffer m_presentationBuffer;
+    QString m_statusText;
+    bool m_showStatistics;
     
     // Settings
     QColor m_backgroundColor;
@@ -101,21 +192,46 @@ private:
     int m_messageDuration;
     int m_fontSize;
     int m_updateInterval;
+    
+    // Rows are laid out and rasterized off the GUI thread, labels only show them;
+    // its threads also warm the glyphs of scripts seen in past sessions
+    RowRenderer m_rowRenderer;
 
     QQueue<QLabel*> m_messageWidgetPool;
     int m_maxPoolSize;
 
     void setupUi();
     void setupContextMenu();
+    void createContextMenuActions();
     void setupShortcuts();
     void createSettingsDialog();
     void updateDisplay();
+    void rebuildDisplay();
+    void appendRow(qint64 key, const QString& html);
+    void showRow(QLabel* label, qint64 key, const QString& html);
+    QString formatRow(const ChatMessage& msg, bool focused) const;
+    const QString& rowHtml(qint64 sequence);
+    void refreshDisplay();
+    void updateRenderingState();
     void updateWindowFlags();
+    QFont messageFont() const;
+    int rowWidth() const;
 
     QLabel* getMessageLabel();
     void recycleMessageLabel(QLabel* label);
+    void registerMemoryConsumers();
+    qint64 releaseWidgetPool(qint64 bytes);
     
     void showHotkeyDialog();
+    void showFilterDialog();
+    void applyFilterRules();
+    void removeOldestMessage();
+    void presentMessage(const ChatMessage& message);
+    void releaseBufferedMessages(const QList<ChatMessage>& messages);
+    void setStatusText(const QString& text);
+    void updateStatusLabel();
+    void jumpToHistory(quint32 docId);
+    void openSettings(QSettings& settings) const;
 };
 
 #endif // CHATOVERLAY_H 
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "chatroomresolver.h"
+#include "clock.h"
+#include <QNetworkRequest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QLoggingCategory>
+#include <QDebug>
+
+Q_LOGGING_CATEGORY(lcChatroomResolver, "kickchat.resolver")
+
+namespace {
+// Chatroom IDs practically never change; a day bounds how long a wrong one lives
+const qint64 DefaultTtlMs = 24 * 60 * 60 * 1000LL;
+const int LookupTimeoutMs = 5000;
+}
+
+ChatroomResolver::ChatroomResolver(QNetworkAccessManager* networkManager, QObject* parent)
+    : QObject(parent)
+    , m_networkManager(networkManager)
+    , m_apiBaseUrl("https://kick.com")
+    , m_ttlMs(DefaultTtlMs)
+{
+    load();
+}
+
+void ChatroomResolver::setApiBaseUrl(const QUrl& url)
+{
+    m_apiBaseUrl = url;
+}
+
+void ChatroomResolver::setTtl(qint64 ms)
+{
+    m_ttlMs = qMax<qint64>(0, ms);
+}
+
+qint64 ChatroomResolver::ttl() const
+{
+    return m_ttlMs;
+}
+
+qint64 ChatroomResolver::cachedChatroomId(const QString& channelName, bool* stale) const
+{
+    auto it = m_entries.constFind(keyFor(channelName));
+    if (it == m_entries.cend()) {
+        if (stale) {
+            *stale = false;
+        }
+        return 0;
+    }
+
+    if (stale) {
+        *stale = Clock::instance()->nowMs() - it->resolvedAtMs >= m_ttlMs;
+    }
+    return it->chatroomId;
+}
+
+void ChatroomResolver::resolve(const QString& channelName)
+{
+    QString key = keyFor(channelName);
+    if (key.isEmpty() || m_pending.contains(key)) {
+        return;
+    }
+
+    QUrl url = m_apiBaseUrl;
+    url.setPath(url.path() + QString("/api/v2/channels/%1").arg(key));
+    qCDebug(lcChatroomResolver) << "Resolving chatroom:" << url.toString();
+
+    QNetworkRequest request(url);
+    request.setRawHeader("Accept", "application/json");
+    request.setTransferTimeout(LookupTimeoutMs);
+
+    QNetworkReply* reply = m_networkManager->get(request);
+    m_pending.insert(key, reply);
+    connect(reply, &QNetworkReply::finished, this, [this, key, channelName, reply]() {
+        onReply(key, channelName, reply);
+    });
+}
+
+void ChatroomResolver::onReply(const QString& key, const QString& channelName, QNetworkReply* reply)
+{
+    reply->deleteLater();
+    m_pending.remove(key);
+
+    if (reply->error() != QNetworkReply::NoError) {
+        qCDebug(lcChatroomResolver) << "Chatroom lookup failed:" << reply->errorString();
+        emit resolveFailed(channelName, reply->errorString());
+        return;
+    }
+
+    QJsonObject channel = QJsonDocument::fromJson(reply->readAll()).object();
+    qint64 chatroomId = channel["chatroom"].toObject()["id"].toVariant().toLongLong();
+    if (chatroomId <= 0) {
+        emit resolveFailed(channelName, tr("No chatroom for channel %1").arg(channelName));
+        return;
+    }
+
+    Entry entry;
+    entry.chatroomId = chatroomId;
+    entry.resolvedAtMs = Clock::instance()->nowMs();
+    if (m_entries.value(key).chatroomId != chatroomId) {
+        qCDebug(lcChatroomResolver) << "Channel" << key << "is chatroom" << chatroomId;
+    }
+    m_entries.insert(key, entry);
+    // Simulated timestamps must not end up in the real settings file
+    if (!Clock::instance()->isVirtual()) {
+        store(key, entry);
+    }
+
+    emit resolved(channelName, chatroomId);
+}
+
+void ChatroomResolver::load()
+{
+    QSettings settings("KickChatOverlay", "Settings");
+    const QVariantMap stored = settings.value("chatrooms").toMap();
+
+    for (auto it = stored.cbegin(); it != stored.cend(); ++it) {
+        const QVariantMap values = it.value().toMap();
+        Entry entry;
+        entry.chatroomId = values.value("id").toLongLong();
+        entry.resolvedAtMs = values.value("resolvedAt").toLongLong();
+        if (entry.chatroomId > 0) {
+            m_entries.insert(it.key(), entry);
+        }
+    }
+}
+
+void ChatroomResolver::store(const QString& key, const Entry& entry)
+{
+    // Read-modify-write so another instance's channels survive
+    QSettings settings("KickChatOverlay", "Settings");
+    QVariantMap stored = settings.value("chatrooms").toMap();
+
+    QVariantMap values;
+    values.insert("id", entry.chatroomId);
+    values.insert("resolvedAt", entry.resolvedAtMs);
+    stored.insert(key, values);
+    settings.setValue("chatrooms", stored);
+}
+
+QString ChatroomResolver::keyFor(const QString& channelName)
+{
+    // Kick slugs are case-insensitive
+    return channelName.trimmed().toLower();
+}
@@ -0,0 +1,60 @@
+#ifndef CHATROOMRESOLVER_H
+#define CHATROOMRESOLVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QUrl>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+// Maps a channel name to the numeric chatroom ID its chat events are keyed by
+// (GET <api base>/api/v2/channels/<name>, field chatroom.id).
+//
+// Results are kept in memory and in the settings file (not under a virtual
+// clock), so reconnects and restarts skip the lookup. An entry older than the
+// TTL is still returned (flagged stale) and the caller revalidates it in the
+// background; a changed ID is reported through resolved() like any other
+// lookup.
+class ChatroomResolver : public QObject {
+    Q_OBJECT
+
+public:
+    // The network manager is shared with the caller and not owned
+    explicit ChatroomResolver(QNetworkAccessManager* networkManager, QObject* parent = nullptr);
+
+    void setApiBaseUrl(const QUrl& url);
+
+    // How long a mapping is trusted without revalidation
+    void setTtl(qint64 ms);
+    qint64 ttl() const;
+
+    // 0 when the channel was never resolved
+    qint64 cachedChatroomId(const QString& channelName, bool* stale = nullptr) const;
+
+    // Looks the channel up; concurrent lookups for one channel share a request
+    void resolve(const QString& channelName);
+
+signals:
+    void resolved(const QString& channelName, qint64 chatroomId);
+    void resolveFailed(const QString& channelName, const QString& errorString);
+
+private:
+    struct Entry {
+        qint64 chatroomId;
+        qint64 resolvedAtMs;
+    };
+
+    QNetworkAccessManager* m_networkManager;
+    QUrl m_apiBaseUrl;
+    qint64 m_ttlMs;
+    QHash<QString, Entry> m_entries;
+    QHash<QString, QNetworkReply*> m_pending;
+
+    void onReply(const QString& key, const QString& channelName, QNetworkReply* reply);
+    void load();
+    void store(const QString& key, const Entry& entry);
+
+    static QString keyFor(const QString& channelName);
+};
+
+#endif // CHATROOMRESOLVER_H
@@ -0,0 +1,397 @@
+#include "chatsearchindex.h"
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QMutexLocker>
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+namespace {
+// Rough per-entry costs used for memory accounting
+const qint64 StringHeaderBytes = 24;
+const qint64 TermNodeBytes = 64;
+// Always keep this many of the newest documents searchable
+const int MinimumLiveDocuments = 1000;
+
+// Walks the union of one clause's posting lists from the newest document
+// down: a k-way merge that only ever touches the documents it passes
+class PostingCursor {
+public:
+    explicit PostingCursor(const QList<const QVector<quint32>*>& lists, quint32 endDoc)
+    {
+        for (const QVector<quint32>* list : lists) {
+            int position = static_cast<int>(std::lower_bound(list->cbegin(), list->cend(), endDoc) - list->cbegin()) - 1;
+            if (position >= 0) {
+                m_heap.push({ list->at(position), list, position });
+            }
+        }
+    }
+
+    // Newest document at or below docId in any of the lists; docId must not
+    // grow from one call to the next
+    bool floor(quint32 docId, quint32* found)
+    {
+        while (!m_heap.empty() && m_heap.top().docId > docId) {
+            Entry entry = m_heap.top();
+            m_heap.pop();
+            auto begin = entry.list->cbegin();
+            int position = static_cast<int>(std::upper_bound(begin, begin + entry.position, docId) - begin) - 1;
+            if (position >= 0) {
+                m_heap.push({ entry.list->at(position), entry.list, position });
+            }
+        }
+
+        if (m_heap.empty()) {
+            return false;
+        }
+        *found = m_heap.top().docId;
+        return true;
+    }
+
+private:
+    struct Entry {
+        quint32 docId;
+        const QVector<quint32>* list;
+        int position;
+
+        bool operator<(const Entry& other) const { return docId < other.docId; }
+    };
+
+    std::priority_queue<Entry> m_heap;
+};
+}
+
+ChatSearchIndex::ChatSearchIndex(QObject* parent)
+    : QObject(parent)
+    , m_worker(new QObject)
+    , m_drainScheduled(false)
+    , m_firstDocId(0)
+    , m_estimatedBytes(0)
+{
+    // The worker object only exists to give queued calls a home on the index thread
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread.setObjectName("ChatSearchIndex");
+    m_thread.start(QThread::LowPriority);
+}
+
+ChatSearchIndex::~ChatSearchIndex()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void ChatSearchIndex::addMessage(const ChatMessage& message)
+{
+    QMutexLocker locker(&m_pendingMutex);
+    m_pending.append(message);
+
+    // Batch everything that arrives before the worker gets to run
+    if (!m_drainScheduled) {
+        m_drainScheduled = true;
+        QMetaObject::invokeMethod(m_worker, [this]() { drainPending(); }, Qt::QueuedConnection);
+    }
+}
+
+void ChatSearchIndex::drainPending()
+{
+    QList<ChatMessage> batch;
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        batch.swap(m_pending);
+        m_drainScheduled = false;
+    }
+
+    int documentCount;
+    {
+        QWriteLocker locker(&m_lock);
+        for (const ChatMessage& msg : batch) {
+            indexMessage(msg);
+        }
+        documentCount = static_cast<int>(m_firstDocId) + m_documents.size();
+    }
+
+    emit indexUpdated(documentCount);
+}
+
+void ChatSearchIndex::indexMessage(const ChatMessage& message)
+{
+    quint32 docId = m_firstDocId + static_cast<quint32>(m_documents.size());
+
+    Document doc;
+    doc.username = message.username();
+    doc.message = message.message();
+    doc.usernameColor = message.usernameColor();
+    doc.timestamp = message.timestamp().toMSecsSinceEpoch();
+
+    // Keep timestamps monotonic so time ranges can be binary searched by doc ID
+    if (!m_documents.isEmpty() && doc.timestamp < m_documents.last().timestamp) {
+        doc.timestamp = m_documents.last().timestamp;
+    }
+
+    m_documents.append(doc);
+    qint64 bytes = documentBytes(doc);
+
+    for (const QString& term : tokenize(doc.message)) {
+        PostingList& list = m_contentTerms[term];
+        if (list.isEmpty()) {
+            bytes += TermNodeBytes + term.size() * static_cast<qint64>(sizeof(QChar));
+        }
+        bytes += addPosting(list, docId);
+    }
+
+    QString user = doc.username.toCaseFolded();
+    PostingList& userList = m_userTerms[user];
+    if (userList.isEmpty()) {
+        bytes += TermNodeBytes + user.size() * static_cast<qint64>(sizeof(QChar));
+    }
+    bytes += addPosting(userList, docId);
+
+    m_estimatedBytes.fetchAndAddRelaxed(bytes);
+}
+
+QList<quint32> ChatSearchIndex::search(const QString& query, const QDateTime& from,
+                                       const QDateTime& to, int limit) const
+{
+    QList<quint32> results;
+    QStringList clauses = query.split(' ', Qt::SkipEmptyParts);
+    if (clauses.isEmpty() || limit <= 0) {
+        return results;
+    }
+
+    QReadLocker locker(&m_lock);
+
+    // Doc IDs follow arrival order, so the time range maps to a doc ID range
+    quint32 firstDoc = m_firstDocId;
+    quint32 endDoc = m_firstDocId + static_cast<quint32>(m_documents.size());
+    auto byTimestamp = [](const Document& doc, qint64 ts) { return doc.timestamp < ts; };
+    if (from.isValid()) {
+        firstDoc = m_firstDocId + static_cast<quint32>(std::lower_bound(m_documents.cbegin(), m_documents.cend(),
+                                                                        from.toMSecsSinceEpoch(), byTimestamp)
+                                                       - m_documents.cbegin());
+    }
+    if (to.isValid()) {
+        endDoc = m_firstDocId + static_cast<quint32>(std::lower_bound(m_documents.cbegin(), m_documents.cend(),
+                                                                      to.toMSecsSinceEpoch() + 1, byTimestamp)
+                                                     - m_documents.cbegin());
+    }
+    if (endDoc <= firstDoc) {
+        return results;
+    }
+
+    std::vector<PostingCursor> cursors;
+    for (const QString& clause : clauses) {
+        QString term = clause.toCaseFolded();
+        const QMap<QString, PostingList>* terms = &m_contentTerms;
+
+        if (term.startsWith("from:")) {
+            term = term.mid(5);
+            if (term.startsWith('@')) {
+                term = term.mid(1);
+            }
+            terms = &m_userTerms;
+        } else {
+            // Match the tokenizer so "hello," finds "hello"
+            QStringList tokens = tokenize(term);
+            bool prefix = term.endsWith('*');
+            if (tokens.isEmpty()) {
+                continue;
+            }
+            term = tokens.first() + (prefix ? "*" : "");
+        }
+
+        if (term.isEmpty() || term == "*") {
+            continue;
+        }
+
+        QList<const PostingList*> lists = lookup(*terms, term);
+        if (lists.isEmpty()) {
+            return results; // One clause without matches empties the AND
+        }
+        cursors.emplace_back(lists, endDoc);
+    }
+
+    if (cursors.empty()) {
+        return results;
+    }
+
+    // Newest first: every clause moves the candidate down to its own next
+    // match until they all agree, so only documents at or above the oldest
+    // result are ever visited
+    quint32 candidate = endDoc - 1;
+    while (results.size() < limit) {
+        bool agreed = true;
+        for (PostingCursor& cursor : cursors) {
+            quint32 docId;
+            if (!cursor.floor(candidate, &docId) || docId < firstDoc) {
+                return results;
+            }
+            if (docId < candidate) {
+                candidate = docId;
+                agreed = false;
+            }
+        }
+
+        if (agreed) {
+            results.append(candidate);
+            if (candidate == firstDoc) {
+                break;
+            }
+            --candidate;
+        }
+    }
+
+    return results;
+}
+
+ChatMessage ChatSearchIndex::message(quint32 docId) const
+{
+    QReadLocker locker(&m_lock);
+
+    if (docId < m_firstDocId || docId - m_firstDocId >= static_cast<quint32>(m_documents.size())) {
+        return ChatMessage(QString(), QString());
+    }
+
+    const Document& doc = m_documents.at(static_cast<int>(docId - m_firstDocId));
+    return ChatMessage(doc.username, doc.message, doc.usernameColor,
+                       QDateTime::fromMSecsSinceEpoch(doc.timestamp));
+}
+
+QList<ChatMessage> ChatSearchIndex::messages(quint32 firstDocId, int count) const
+{
+    QList<ChatMessage> result;
+    QReadLocker locker(&m_lock);
+
+    quint32 end = qMin(m_firstDocId + static_cast<quint32>(m_documents.size()),
+                       firstDocId + static_cast<quint32>(qMax(count, 0)));
+    for (quint32 docId = qMax(firstDocId, m_firstDocId); docId < end; ++docId) {
+        const Document& doc = m_documents.at(static_cast<int>(docId - m_firstDocId));
+        result.append(ChatMessage(doc.username, doc.message, doc.usernameColor,
+                                  QDateTime::fromMSecsSinceEpoch(doc.timestamp)));
+    }
+
+    return result;
+}
+
+int ChatSearchIndex::size() const
+{
+    QReadLocker locker(&m_lock);
+    return m_documents.size();
+}
+
+quint32 ChatSearchIndex::firstDocId() const
+{
+    QReadLocker locker(&m_lock);
+    return m_firstDocId;
+}
+
+qint64 ChatSearchIndex::memoryUsage() const
+{
+    return m_estimatedBytes.loadRelaxed();
+}
+
+qint64 ChatSearchIndex::releaseOldest(qint64 bytes)
+{
+    QWriteLocker locker(&m_lock);
+
+    int evictable = qMax(0, m_documents.size() - MinimumLiveDocuments);
+    int dropCount = 0;
+    qint64 released = 0;
+
+    while (dropCount < evictable && released < bytes) {
+        released += documentBytes(m_documents.at(dropCount));
+        ++dropCount;
+    }
+
+    if (dropCount == 0) {
+        return 0;
+    }
+
+    // Evicted documents are gone for good; doc IDs stay stable through the base offset
+    m_documents.remove(0, dropCount);
+    m_documents.squeeze();
+    m_firstDocId += static_cast<quint32>(dropCount);
+
+    released += pruneTerms(m_contentTerms);
+    released += pruneTerms(m_userTerms);
+    m_estimatedBytes.fetchAndSubRelaxed(released);
+    return released;
+}
+
+qint64 ChatSearchIndex::pruneTerms(QMap<QString, PostingList>& terms)
+{
+    qint64 released = 0;
+
+    for (auto it = terms.begin(); it != terms.end();) {
+        PostingList& list = it.value();
+        auto live = std::lower_bound(list.begin(), list.end(), m_firstDocId);
+        released += (live - list.begin()) * static_cast<qint64>(sizeof(quint32));
+
+        if (live == list.end()) {
+            released += TermNodeBytes + it.key().size() * static_cast<qint64>(sizeof(QChar));
+            it = terms.erase(it);
+        } else {
+            list.erase(list.begin(), live);
+            list.squeeze();
+            ++it;
+        }
+    }
+
+    return released;
+}
+
+qint64 ChatSearchIndex::documentBytes(const Document& doc)
+{
+    return static_cast<qint64>(sizeof(Document)) + 2 * StringHeaderBytes
+        + (doc.username.size() + doc.message.size()) * static_cast<qint64>(sizeof(QChar));
+}
+
+QStringList ChatSearchIndex::tokenize(const QString& text)
+{
+    QStringList tokens;
+    int start = -1;
+
+    for (int i = 0; i <= text.size(); ++i) {
+        bool wordChar = i < text.size() &&
+            (text.at(i).isLetterOrNumber() || text.at(i) == '_' || text.at(i).isSurrogate());
+        if (wordChar && start < 0) {
+            start = i;
+        } else if (!wordChar && start >= 0) {
+            tokens.append(text.mid(start, i - start).toCaseFolded());
+            start = -1;
+        }
+    }
+
+    return tokens;
+}
+
+qint64 ChatSearchIndex::addPosting(PostingList& list, quint32 docId)
+{
+    // A term repeated within one message is only posted once
+    if (list.isEmpty() || list.last() != docId) {
+        list.append(docId);
+        return sizeof(quint32);
+    }
+    return 0;
+}
+
+QList<const ChatSearchIndex::PostingList*> ChatSearchIndex::lookup(const QMap<QString, PostingList>& terms,
+                                                                  const QString& term)
+{
+    QList<const PostingList*> lists;
+    if (!term.endsWith('*')) {
+        auto it = terms.constFind(term);
+        if (it != terms.cend()) {
+            lists.append(&it.value());
+        }
+        return lists;
+    }
+
+    // Prefix query: every term in the sorted dictionary that starts with it;
+    // the lists are merged lazily while searching
+    QString prefix = term.left(term.size() - 1);
+    for (auto it = terms.lowerBound(prefix); it != terms.cend() && it.key().startsWith(prefix); ++it) {
+        lists.append(&it.value());
+    }
+    return lists;
+}
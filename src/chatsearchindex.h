@@ -0,0 +1,92 @@
+#ifndef CHATSEARCHINDEX_H
+#define CHATSEARCHINDEX_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QMap>
+#include <QVector>
+#include <QList>
+#include <QDateTime>
+#include <QAtomicInteger>
+#include "chatmessage.h"
+
+// Incremental inverted index over the whole chat history of a session.
+// Messages are queued from the GUI thread and indexed on a background thread;
+// queries run on the caller's thread under a read lock.
+//
+// Query syntax (all clauses are ANDed):
+//   word        messages containing the term "word"
+//   wor*        messages containing a term starting with "wor"
+//   from:name   messages sent by "name" (also accepts a trailing *)
+class ChatSearchIndex : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ChatSearchIndex(QObject* parent = nullptr);
+    ~ChatSearchIndex();
+
+    // Thread-safe, returns immediately
+    void addMessage(const ChatMessage& message);
+
+    // Returns matching document IDs, newest first. Invalid from/to means unbounded.
+    QList<quint32> search(const QString& query,
+                          const QDateTime& from = QDateTime(),
+                          const QDateTime& to = QDateTime(),
+                          int limit = 100) const;
+
+    ChatMessage message(quint32 docId) const;
+    QList<ChatMessage> messages(quint32 firstDocId, int count) const;
+    // Live documents; their IDs are [firstDocId(), firstDocId() + size())
+    int size() const;
+    quint32 firstDocId() const;
+
+    // Estimated heap bytes, readable from any thread without locking
+    qint64 memoryUsage() const;
+
+    // Forgets the oldest documents until about bytes were freed. Newer doc IDs
+    // remain stable; returns the bytes released.
+    qint64 releaseOldest(qint64 bytes);
+
+signals:
+    void indexUpdated(int documentCount);
+
+private:
+    struct Document {
+        QString username;
+        QString message;
+        quint32 usernameColor;
+        qint64 timestamp;
+    };
+
+    typedef QVector<quint32> PostingList;
+
+    QThread m_thread;
+    QObject* m_worker;
+
+    QMutex m_pendingMutex;
+    QList<ChatMessage> m_pending;
+    bool m_drainScheduled;
+
+    mutable QReadWriteLock m_lock;
+    // m_documents[i] is doc ID m_firstDocId + i
+    QVector<Document> m_documents;
+    QMap<QString, PostingList> m_contentTerms;
+    QMap<QString, PostingList> m_userTerms;
+    quint32 m_firstDocId;
+    QAtomicInteger<qint64> m_estimatedBytes;
+
+    void drainPending();
+    void indexMessage(const ChatMessage& message);
+
+    qint64 pruneTerms(QMap<QString, PostingList>& terms);
+
+    static qint64 documentBytes(const Document& doc);
+    static QStringList tokenize(const QString& text);
+    static qint64 addPosting(PostingList& list, quint32 docId);
+    // The posting lists a clause term matches (several for a prefix)
+    static QList<const PostingList*> lookup(const QMap<QString, PostingList>& terms, const QString& term);
+};
+
+#endif // CHATSEARCHINDEX_H
@@ -0,0 +1,434 @@
+#include "chatstatistics.h"
+#include "chatjson.h"
+#include <QtAlgorithms>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+const int SketchDepth = 4;
+const int SketchWidth = 512; // Power of two
+const int HllPrecision = 10;
+const int HllRegisters = 1 << HllPrecision;
+const int TopCount = 10;
+const int RateSeconds = 60;
+const int RateAverageSeconds = 10;
+
+// FNV-1a over UTF-16 with a final avalanche so every bit is usable by the
+// sketches and the HyperLogLog
+quint64 hashKey(const QString& key)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (QChar c : key) {
+        hash ^= c.unicode();
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Count-min sketch; row hashes are derived from one 64-bit hash (Kirsch-Mitzenmacher)
+class Sketch {
+public:
+    Sketch() : m_cells(SketchDepth * SketchWidth, 0) {}
+
+    void add(quint64 hash)
+    {
+        for (int row = 0; row < SketchDepth; ++row) {
+            ++m_cells[cell(row, hash)];
+        }
+    }
+
+    quint32 estimate(quint64 hash) const
+    {
+        quint32 result = m_cells.at(cell(0, hash));
+        for (int row = 1; row < SketchDepth; ++row) {
+            result = qMin(result, m_cells.at(cell(row, hash)));
+        }
+        return result;
+    }
+
+    void subtract(const Sketch& other)
+    {
+        for (int i = 0; i < m_cells.size(); ++i) {
+            m_cells[i] -= other.m_cells.at(i);
+        }
+    }
+
+    void clear()
+    {
+        m_cells.fill(0);
+    }
+
+private:
+    QVector<quint32> m_cells;
+
+    static int cell(int row, quint64 hash)
+    {
+        quint32 h1 = static_cast<quint32>(hash);
+        quint32 h2 = static_cast<quint32>(hash >> 32) | 1;
+        return row * SketchWidth + static_cast<int>((h1 + static_cast<quint32>(row) * h2) & (SketchWidth - 1));
+    }
+};
+
+// Heavy-hitter candidates; TopCount is small, so a linear scan beats a heap here
+class TopList {
+public:
+    void offer(const QString& key, quint64 hash, quint32 count)
+    {
+        int minIndex = -1;
+        for (int i = 0; i < m_items.size(); ++i) {
+            if (m_items.at(i).hash == hash) {
+                m_items[i].count = count;
+                return;
+            }
+            if (minIndex < 0 || m_items.at(i).count < m_items.at(minIndex).count) {
+                minIndex = i;
+            }
+        }
+
+        if (m_items.size() < TopCount) {
+            m_items.append(Item{key, hash, count});
+        } else if (count > m_items.at(minIndex).count) {
+            m_items[minIndex] = Item{key, hash, count};
+        }
+    }
+
+    // After slices expire, counts can only go down; re-read them and drop the gone
+    void refresh(const Sketch& sketch)
+    {
+        for (int i = m_items.size() - 1; i >= 0; --i) {
+            m_items[i].count = sketch.estimate(m_items.at(i).hash);
+            if (m_items.at(i).count == 0) {
+                m_items.remove(i);
+            }
+        }
+    }
+
+    QList<ChatStatistics::Ranked> sorted() const
+    {
+        QList<ChatStatistics::Ranked> result;
+        for (const Item& item : m_items) {
+            result.append(ChatStatistics::Ranked{item.key, item.count});
+        }
+        std::sort(result.begin(), result.end(), [](const ChatStatistics::Ranked& a, const ChatStatistics::Ranked& b) {
+            return a.count > b.count;
+        });
+        return result;
+    }
+
+private:
+    struct Item {
+        QString key;
+        quint64 hash;
+        quint32 count;
+    };
+
+    QVector<Item> m_items;
+};
+
+void appendRanked(QByteArray& out, const QList<ChatStatistics::Ranked>& ranked)
+{
+    out.append('[');
+    for (int i = 0; i < ranked.size(); ++i) {
+        if (i > 0) {
+            out.append(',');
+        }
+        out.append("{\"name\":");
+        ChatJson::appendString(out, ranked.at(i).key);
+        out.append(",\"count\":").append(QByteArray::number(ranked.at(i).count)).append('}');
+    }
+    out.append(']');
+}
+}
+
+class ChatStatistics::SlidingWindow {
+public:
+    SlidingWindow(qint64 sliceMs, int sliceCount)
+        : m_sliceMs(sliceMs)
+        , m_sliceCount(sliceCount)
+        , m_currentSlice(-1)
+        , m_messageTotal(0)
+        , m_sliceMessages(sliceCount, 0)
+        , m_sliceRegisters(sliceCount, QByteArray(HllRegisters, 0))
+        , m_sliceChatters(sliceCount)
+        , m_sliceEmotes(sliceCount)
+    {
+    }
+
+    void advance(qint64 nowMs)
+    {
+        qint64 slice = nowMs / m_sliceMs;
+        if (m_currentSlice < 0) {
+            m_currentSlice = slice;
+            return;
+        }
+        if (slice <= m_currentSlice) {
+            return;
+        }
+
+        // Each slot about to be reused drops out of every aggregate
+        qint64 steps = qMin<qint64>(slice - m_currentSlice, m_sliceCount);
+        for (qint64 i = 1; i <= steps; ++i) {
+            int index = static_cast<int>((m_currentSlice + i) % m_sliceCount);
+            m_messageTotal -= m_sliceMessages.at(index);
+            m_sliceMessages[index] = 0;
+            m_sliceRegisters[index].fill(0);
+            m_chatters.subtract(m_sliceChatters.at(index));
+            m_sliceChatters[index].clear();
+            m_emotes.subtract(m_sliceEmotes.at(index));
+            m_sliceEmotes[index].clear();
+        }
+        m_currentSlice = slice;
+
+        m_topChatters.refresh(m_chatters);
+        m_topEmotes.refresh(m_emotes);
+    }
+
+    void recordMessage(const QString& user, quint64 userHash)
+    {
+        int index = currentIndex();
+        ++m_sliceMessages[index];
+        ++m_messageTotal;
+
+        // HyperLogLog: the top bits pick a register, the rest give the rank
+        quint64 rest = userHash << HllPrecision;
+        int rank = rest == 0 ? 64 - HllPrecision + 1 : qCountLeadingZeroBits(rest) + 1;
+        char& reg = m_sliceRegisters[index][static_cast<int>(userHash >> (64 - HllPrecision))];
+        reg = static_cast<char>(qMax<int>(reg, rank));
+
+        m_sliceChatters[index].add(userHash);
+        m_chatters.add(userHash);
+        m_topChatters.offer(user, userHash, m_chatters.estimate(userHash));
+    }
+
+    void recordEmote(const QString& emote, quint64 emoteHash)
+    {
+        m_sliceEmotes[currentIndex()].add(emoteHash);
+        m_emotes.add(emoteHash);
+        m_topEmotes.offer(emote, emoteHash, m_emotes.estimate(emoteHash));
+    }
+
+    qint64 messageCount() const
+    {
+        return m_messageTotal;
+    }
+
+    qint64 uniqueChatters() const
+    {
+        QByteArray merged(HllRegisters, 0);
+        for (const QByteArray& registers : m_sliceRegisters) {
+            for (int i = 0; i < HllRegisters; ++i) {
+                merged[i] = qMax(merged.at(i), registers.at(i));
+            }
+        }
+
+        double sum = 0.0;
+        int zeros = 0;
+        for (int i = 0; i < HllRegisters; ++i) {
+            sum += std::ldexp(1.0, -merged.at(i));
+            if (merged.at(i) == 0) {
+                ++zeros;
+            }
+        }
+
+        const double m = HllRegisters;
+        double estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+        // Small-range correction: linear counting while registers are still empty
+        if (estimate <= 2.5 * m && zeros > 0) {
+            estimate = m * std::log(m / zeros);
+        }
+        return qRound64(estimate);
+    }
+
+    QList<Ranked> topChatters() const
+    {
+        return m_topChatters.sorted();
+    }
+
+    QList<Ranked> topEmotes() const
+    {
+        return m_topEmotes.sorted();
+    }
+
+private:
+    qint64 m_sliceMs;
+    int m_sliceCount;
+    qint64 m_currentSlice;
+    qint64 m_messageTotal;
+
+    QVector<quint32> m_sliceMessages;
+    QVector<QByteArray> m_sliceRegisters;
+    QVector<Sketch> m_sliceChatters;
+    QVector<Sketch> m_sliceEmotes;
+    Sketch m_chatters;
+    Sketch m_emotes;
+    TopList m_topChatters;
+    TopList m_topEmotes;
+
+    int currentIndex() const
+    {
+        return static_cast<int>(m_currentSlice % m_sliceCount);
+    }
+};
+
+ChatStatistics::ChatStatistics()
+    : m_secondCounts(RateSeconds, 0)
+    , m_currentSecond(-1)
+{
+    // One extra slice so a window always covers at least its full length
+    m_windows[OneMinute] = new SlidingWindow(10 * 1000, 7);
+    m_windows[FiveMinutes] = new SlidingWindow(60 * 1000, 6);
+    m_windows[SixtyMinutes] = new SlidingWindow(5 * 60 * 1000, 13);
+}
+
+ChatStatistics::~ChatStatistics()
+{
+    for (SlidingWindow* window : m_windows) {
+        delete window;
+    }
+}
+
+void ChatStatistics::record(const ChatMessage& message)
+{
+    // Late timestamps count toward the current slice
+    qint64 timestampMs = message.timestamp().toMSecsSinceEpoch();
+    advanceSeconds(timestampMs);
+    ++m_secondCounts[static_cast<int>(m_currentSecond % RateSeconds)];
+
+    const QString& username = message.username();
+    quint64 userHash = hashKey(username);
+    for (SlidingWindow* window : m_windows) {
+        window->advance(timestampMs);
+        window->recordMessage(username, userHash);
+    }
+
+    // Tokenized once on ingest (EmoteStage)
+    const QStringList emotes = message.emotes();
+    for (const QString& emote : emotes) {
+        quint64 emoteHash = hashKey(emote);
+        for (SlidingWindow* window : m_windows) {
+            window->recordEmote(emote, emoteHash);
+        }
+    }
+}
+
+void ChatStatistics::advanceSeconds(qint64 nowMs)
+{
+    qint64 second = nowMs / 1000;
+    if (m_currentSecond < 0) {
+        m_currentSecond = second;
+        return;
+    }
+    if (second <= m_currentSecond) {
+        return;
+    }
+
+    qint64 steps = qMin<qint64>(second - m_currentSecond, RateSeconds);
+    for (qint64 i = 1; i <= steps; ++i) {
+        m_secondCounts[static_cast<int>((m_currentSecond + i) % RateSeconds)] = 0;
+    }
+    m_currentSecond = second;
+}
+
+double ChatStatistics::messagesPerSecond(qint64 nowMs)
+{
+    advanceSeconds(nowMs);
+    if (m_currentSecond < 0) {
+        return 0.0;
+    }
+
+    // Average over the last complete seconds; the current one is still filling
+    qint64 total = 0;
+    for (int i = 1; i <= RateAverageSeconds; ++i) {
+        total += m_secondCounts.at(static_cast<int>((m_currentSecond - i) % RateSeconds));
+    }
+    return total / static_cast<double>(RateAverageSeconds);
+}
+
+qint64 ChatStatistics::messagesPerMinute(qint64 nowMs)
+{
+    advanceSeconds(nowMs);
+
+    qint64 total = 0;
+    for (quint32 count : m_secondCounts) {
+        total += count;
+    }
+    return total;
+}
+
+qint64 ChatStatistics::messageCount(Window window, qint64 nowMs)
+{
+    m_windows[window]->advance(nowMs);
+    return m_windows[window]->messageCount();
+}
+
+qint64 ChatStatistics::uniqueChatters(Window window, qint64 nowMs)
+{
+    m_windows[window]->advance(nowMs);
+    return m_windows[window]->uniqueChatters();
+}
+
+QList<ChatStatistics::Ranked> ChatStatistics::topChatters(Window window, qint64 nowMs)
+{
+    m_windows[window]->advance(nowMs);
+    return m_windows[window]->topChatters();
+}
+
+QList<ChatStatistics::Ranked> ChatStatistics::topEmotes(Window window, qint64 nowMs)
+{
+    m_windows[window]->advance(nowMs);
+    return m_windows[window]->topEmotes();
+}
+
+int ChatStatistics::windowMinutes(Window window)
+{
+    switch (window) {
+    case OneMinute: return 1;
+    case FiveMinutes: return 5;
+    default: return 60;
+    }
+}
+
+QByteArray ChatStatistics::toJson(qint64 nowMs)
+{
+    QByteArray out;
+    out.append("{\"ts\":").append(QByteArray::number(nowMs));
+    out.append(",\"messagesPerSecond\":").append(QByteArray::number(messagesPerSecond(nowMs), 'f', 1));
+    out.append(",\"messagesPerMinute\":").append(QByteArray::number(messagesPerMinute(nowMs)));
+    out.append(",\"windows\":[");
+
+    for (int i = 0; i < WindowCount; ++i) {
+        Window window = static_cast<Window>(i);
+        if (i > 0) {
+            out.append(',');
+        }
+        out.append("{\"minutes\":").append(QByteArray::number(windowMinutes(window)));
+        out.append(",\"messages\":").append(QByteArray::number(messageCount(window, nowMs)));
+        out.append(",\"uniqueChatters\":").append(QByteArray::number(uniqueChatters(window, nowMs)));
+        out.append(",\"topChatters\":");
+        appendRanked(out, topChatters(window, nowMs));
+        out.append(",\"topEmotes\":");
+        appendRanked(out, topEmotes(window, nowMs));
+        out.append('}');
+    }
+
+    out.append("]}\n");
+    return out;
+}
+
+QString ChatStatistics::summary(qint64 nowMs)
+{
+    QString text = QString("%1 msg/s, %2 chatters (5m)")
+        .arg(messagesPerSecond(nowMs), 0, 'f', 1)
+        .arg(uniqueChatters(FiveMinutes, nowMs));
+
+    QList<Ranked> emotes = topEmotes(OneMinute, nowMs);
+    if (!emotes.isEmpty()) {
+        text += QString(", top emote %1").arg(emotes.first().key);
+    }
+    return text;
+}
@@ -0,0 +1,64 @@
+#ifndef CHATSTATISTICS_H
+#define CHATSTATISTICS_H
+
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include "chatmessage.h"
+
+// Live chat statistics kept in constant memory on the ingest path. Nothing is
+// recomputed from message lists; every structure is updated in O(1) per
+// message (per emote for emote counts) and expires old data a slice at a time:
+//
+//   - message rates from a ring of per-second counters
+//   - unique chatters from one HyperLogLog per slice, merged on query
+//   - top chatters and emotes from count-min sketches (per slice plus a running
+//     aggregate) feeding a small top-K candidate list
+//
+// Windows slide by slices (10 s for 1 minute, 1 min for 5 minutes, 5 min for
+// 60 minutes), so a window covers its length plus up to one slice.
+class ChatStatistics {
+public:
+    enum Window {
+        OneMinute,
+        FiveMinutes,
+        SixtyMinutes,
+        WindowCount
+    };
+
+    struct Ranked {
+        QString key;
+        quint32 count;
+    };
+
+    ChatStatistics();
+    ~ChatStatistics();
+    Q_DISABLE_COPY(ChatStatistics)
+
+    void record(const ChatMessage& message);
+
+    // Queries take the current time so idle periods expire old slices too
+    double messagesPerSecond(qint64 nowMs);
+    qint64 messagesPerMinute(qint64 nowMs);
+    qint64 messageCount(Window window, qint64 nowMs);
+    qint64 uniqueChatters(Window window, qint64 nowMs);
+    QList<Ranked> topChatters(Window window, qint64 nowMs);
+    QList<Ranked> topEmotes(Window window, qint64 nowMs);
+
+    QByteArray toJson(qint64 nowMs);
+    QString summary(qint64 nowMs);
+
+    static int windowMinutes(Window window);
+
+private:
+    class SlidingWindow;
+
+    SlidingWindow* m_windows[WindowCount];
+    QVector<quint32> m_secondCounts;
+    qint64 m_currentSecond;
+
+    void advanceSeconds(qint64 nowMs);
+};
+
+#endif // CHATSTATISTICS_H
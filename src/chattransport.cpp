@@ -0,0 +1,52 @@
+#include "chattransport.h"
+#include "websockettransport.h"
+#ifdef KICKCHAT_HAVE_ZLIB
+#include "deflatewebsockettransport.h"
+#endif
+
+ChatTransport::ChatTransport(QObject* parent)
+    : QObject(parent)
+    , m_wireBytes(0)
+    , m_messageBytes(0)
+{
+}
+
+ChatTransport* ChatTransport::create(Kind kind, QObject* parent)
+{
+#ifdef KICKCHAT_HAVE_ZLIB
+    if (kind == DeflateWebSocket) {
+        return new DeflateWebSocketTransport(parent);
+    }
+#else
+    Q_UNUSED(kind);
+#endif
+    return new WebSocketTransport(parent);
+}
+
+ChatTransport::Kind ChatTransport::defaultKind()
+{
+    // The built-in deflate client is opt-in (--transport deflate)
+    return QtWebSocket;
+}
+
+bool ChatTransport::kindFromName(const QString& name, Kind* kind)
+{
+    if (name == "qt") {
+        *kind = QtWebSocket;
+    } else if (name == "deflate") {
+        *kind = DeflateWebSocket;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+qint64 ChatTransport::wireBytes() const
+{
+    return m_wireBytes;
+}
+
+qint64 ChatTransport::messageBytes() const
+{
+    return m_messageBytes;
+}
@@ -0,0 +1,50 @@
+#ifndef CHATTRANSPORT_H
+#define CHATTRANSPORT_H
+
+#include <QObject>
+#include <QUrl>
+#include <QByteArray>
+
+// Carries Pusher text frames between KickChatClient and the server. The client
+// only sees whole messages; how they are framed, compressed and buffered is up
+// to the implementation.
+class ChatTransport : public QObject {
+    Q_OBJECT
+
+public:
+    enum Kind {
+        QtWebSocket,      // QWebSocket, no compression
+        DeflateWebSocket  // Built-in RFC 6455 client with permessage-deflate
+    };
+
+    // Falls back to QtWebSocket when the deflate transport was not built
+    static ChatTransport* create(Kind kind, QObject* parent = nullptr);
+    static Kind defaultKind();
+    static bool kindFromName(const QString& name, Kind* kind);
+
+    explicit ChatTransport(QObject* parent = nullptr);
+
+    virtual void open(const QUrl& url) = 0;
+    virtual void close() = 0;
+    virtual bool isConnected() const = 0;
+    virtual void sendText(const QByteArray& utf8) = 0;
+    virtual QString errorString() const = 0;
+
+    // Bytes read off the socket versus bytes of decoded message text
+    qint64 wireBytes() const;
+    qint64 messageBytes() const;
+
+signals:
+    void connected();
+    void disconnected();
+    // frame may point into a buffer the transport reuses: it is only valid for
+    // the duration of a direct connection and must be copied to be kept
+    void frameReceived(const QByteArray& frame);
+    void errorOccurred(const QString& message);
+
+protected:
+    qint64 m_wireBytes;
+    qint64 m_messageBytes;
+};
+
+#endif // CHATTRANSPORT_H
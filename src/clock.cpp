@@ -0,0 +1,140 @@
+#include "clock.h"
+#include <QTimerEvent>
+
+namespace {
+Clock* installedClock = nullptr;
+}
+
+Clock::Clock()
+{
+}
+
+Clock::~Clock()
+{
+    if (installedClock == this) {
+        installedClock = nullptr;
+    }
+}
+
+Clock* Clock::instance()
+{
+    static Clock wallClock;
+    return installedClock ? installedClock : &wallClock;
+}
+
+void Clock::setInstance(Clock* clock)
+{
+    installedClock = clock;
+}
+
+qint64 Clock::nowMs() const
+{
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+QDateTime Clock::now() const
+{
+    return QDateTime::fromMSecsSinceEpoch(nowMs());
+}
+
+bool Clock::isVirtual() const
+{
+    return false;
+}
+
+void Clock::arm(ClockTimer* timer, int delayMs)
+{
+    // Coarse like QTimer's default; the event loop repeats it until disarmed
+    timer->m_nativeTimerId = timer->startTimer(delayMs, Qt::CoarseTimer);
+}
+
+void Clock::disarm(ClockTimer* timer)
+{
+    if (timer->m_nativeTimerId != 0) {
+        timer->killTimer(timer->m_nativeTimerId);
+        timer->m_nativeTimerId = 0;
+    }
+}
+
+ClockTimer::ClockTimer(QObject* parent)
+    : QObject(parent)
+    , m_clock(Clock::instance())
+    , m_interval(0)
+    , m_singleShot(false)
+    , m_active(false)
+    , m_nativeTimerId(0)
+{
+}
+
+ClockTimer::~ClockTimer()
+{
+    stop();
+}
+
+void ClockTimer::setInterval(int ms)
+{
+    m_interval = ms;
+    if (m_active) {
+        start();
+    }
+}
+
+int ClockTimer::interval() const
+{
+    return m_interval;
+}
+
+void ClockTimer::setSingleShot(bool singleShot)
+{
+    m_singleShot = singleShot;
+}
+
+bool ClockTimer::isSingleShot() const
+{
+    return m_singleShot;
+}
+
+bool ClockTimer::isActive() const
+{
+    return m_active;
+}
+
+void ClockTimer::start()
+{
+    if (m_active) {
+        m_clock->disarm(this);
+    }
+    m_active = true;
+    m_clock->arm(this, m_interval);
+}
+
+void ClockTimer::start(int ms)
+{
+    m_interval = ms;
+    start();
+}
+
+void ClockTimer::stop()
+{
+    if (m_active) {
+        m_active = false;
+        m_clock->disarm(this);
+    }
+}
+
+void ClockTimer::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == m_nativeTimerId) {
+        fire();
+    } else {
+        QObject::timerEvent(event);
+    }
+}
+
+void ClockTimer::fire()
+{
+    if (m_singleShot) {
+        stop();
+    }
+    emit timeout();
+}
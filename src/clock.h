@@ -0,0 +1,76 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <QObject>
+#include <QDateTime>
+
+class ClockTimer;
+
+// Source of "now" and of timer scheduling for the client and overlay. The base
+// class is the wall clock; VirtualClock replaces it so replay and soak runs
+// jump from one timer to the next instead of waiting.
+//
+// Install a different clock before any ClockTimer is created: timers bind to
+// the clock that was current at construction.
+class Clock {
+public:
+    Clock();
+    virtual ~Clock();
+    Q_DISABLE_COPY(Clock)
+
+    static Clock* instance();
+    // Not owned; nullptr restores the wall clock
+    static void setInstance(Clock* clock);
+
+    virtual qint64 nowMs() const;
+    QDateTime now() const;
+
+    virtual bool isVirtual() const;
+
+protected:
+    friend class ClockTimer;
+
+    // Schedules one expiry of timer after delayMs; repeating timers stay armed
+    virtual void arm(ClockTimer* timer, int delayMs);
+    virtual void disarm(ClockTimer* timer);
+};
+
+// QTimer replacement driven by a Clock. Same subset of the API the app uses.
+class ClockTimer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ClockTimer(QObject* parent = nullptr);
+    ~ClockTimer();
+
+    void setInterval(int ms);
+    int interval() const;
+    void setSingleShot(bool singleShot);
+    bool isSingleShot() const;
+    bool isActive() const;
+
+public slots:
+    void start();
+    void start(int ms);
+    void stop();
+
+signals:
+    void timeout();
+
+protected:
+    void timerEvent(QTimerEvent* event) override;
+
+private:
+    friend class Clock;
+    friend class VirtualClock;
+
+    Clock* m_clock;
+    int m_interval;
+    bool m_singleShot;
+    bool m_active;
+    int m_nativeTimerId;
+
+    void fire();
+};
+
+#endif // CLOCK_H
@@ -0,0 +1,331 @@
+#include "deflatewebsockettransport.h"
+#include <QCryptographicHash>
+#include <QRandomGenerator>
+#include <QList>
+#include <cstring>
+
+namespace {
+const char* const AcceptGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// Covers DNS, TCP, TLS and the HTTP upgrade
+const int HandshakeTimeoutMs = 10000;
+
+enum Opcode {
+    Text = 0x1,
+    Close = 0x8,
+    Pong = 0xA
+};
+}
+
+DeflateWebSocketTransport::DeflateWebSocketTransport(QObject* parent)
+    : ChatTransport(parent)
+    , m_state(Closed)
+    , m_connectedEmitted(false)
+{
+    m_handshakeTimer.setSingleShot(true);
+    m_handshakeTimer.setInterval(HandshakeTimeoutMs);
+    connect(&m_handshakeTimer, &QTimer::timeout, this, [this]() {
+        fail("WebSocket handshake timed out");
+    });
+
+    connect(&m_socket, &QSslSocket::connected, this, &DeflateWebSocketTransport::onSocketConnected);
+    connect(&m_socket, &QSslSocket::encrypted, this, &DeflateWebSocketTransport::onEncrypted);
+    connect(&m_socket, &QSslSocket::readyRead, this, &DeflateWebSocketTransport::onReadyRead);
+    connect(&m_socket, &QSslSocket::disconnected, this, &DeflateWebSocketTransport::onSocketDisconnected);
+    connect(&m_socket, &QSslSocket::errorOccurred, this, &DeflateWebSocketTransport::onSocketError);
+}
+
+DeflateWebSocketTransport::~DeflateWebSocketTransport()
+{
+    // The socket outlives this destructor body; don't let it call back in
+    m_socket.disconnect(this);
+    m_socket.abort();
+}
+
+void DeflateWebSocketTransport::open(const QUrl& url)
+{
+    m_socket.abort();
+
+    m_url = url;
+    m_state = Connecting;
+    m_connectedEmitted = false;
+    m_errorString.clear();
+    m_reader.reset();
+    m_handshakeTimer.start();
+
+    bool secure = url.scheme() == "wss";
+    quint16 port = static_cast<quint16>(url.port(secure ? 443 : 80));
+    if (secure) {
+        m_socket.connectToHostEncrypted(url.host(), port);
+    } else {
+        m_socket.connectToHost(url.host(), port);
+    }
+}
+
+void DeflateWebSocketTransport::close()
+{
+    if (m_state == Open) {
+        // Status 1000, normal closure
+        const char status[2] = { 0x03, '\xe8' };
+        sendFrame(Close, status, 2);
+        m_state = Closing;
+        m_socket.disconnectFromHost();
+    } else if (m_state != Closed) {
+        m_state = Closing;
+        m_handshakeTimer.stop();
+        m_socket.abort();
+    }
+}
+
+bool DeflateWebSocketTransport::isConnected() const
+{
+    return m_state == Open;
+}
+
+void DeflateWebSocketTransport::sendText(const QByteArray& utf8)
+{
+    // Our outgoing traffic is a few subscribe/ping messages, so it goes uncompressed
+    if (m_state == Open) {
+        sendFrame(Text, utf8.constData(), utf8.size());
+    }
+}
+
+QString DeflateWebSocketTransport::errorString() const
+{
+    return m_errorString;
+}
+
+void DeflateWebSocketTransport::onSocketConnected()
+{
+    // wss:// waits for the TLS handshake instead
+    if (m_url.scheme() != "wss") {
+        sendHandshake();
+    }
+}
+
+void DeflateWebSocketTransport::onEncrypted()
+{
+    sendHandshake();
+}
+
+void DeflateWebSocketTransport::sendHandshake()
+{
+    QByteArray nonce(16, Qt::Uninitialized);
+    for (int i = 0; i < nonce.size(); ++i) {
+        nonce[i] = static_cast<char>(QRandomGenerator::global()->bounded(256));
+    }
+    m_key = nonce.toBase64();
+
+    QByteArray target = m_url.path(QUrl::FullyEncoded).toUtf8();
+    if (target.isEmpty()) {
+        target = "/";
+    }
+    if (m_url.hasQuery()) {
+        target += '?' + m_url.query(QUrl::FullyEncoded).toUtf8();
+    }
+
+    QByteArray host = m_url.host(QUrl::FullyEncoded).toUtf8();
+    if (m_url.port() != -1) {
+        host += ':' + QByteArray::number(m_url.port());
+    }
+
+    QByteArray request;
+    request += "GET " + target + " HTTP/1.1\r\n";
+    request += "Host: " + host + "\r\n";
+    request += "Upgrade: websocket\r\n";
+    request += "Connection: Upgrade\r\n";
+    request += "Sec-WebSocket-Key: " + m_key + "\r\n";
+    request += "Sec-WebSocket-Version: 13\r\n";
+    request += "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n";
+    request += "\r\n";
+
+    m_state = Handshaking;
+    m_socket.write(request);
+}
+
+bool DeflateWebSocketTransport::parseHandshake()
+{
+    QByteArray pending = m_reader.pending();
+    int headerEnd = pending.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        if (pending.size() > 16 * 1024) {
+            fail("WebSocket handshake response too large");
+        }
+        return false;
+    }
+
+    QList<QByteArray> lines = pending.left(headerEnd).split('\n');
+    QList<QByteArray> status = lines.first().trimmed().split(' ');
+    if (status.size() < 2 || status.at(1) != "101") {
+        fail("WebSocket upgrade refused: " + QString::fromUtf8(lines.first().trimmed()));
+        return false;
+    }
+
+    QByteArray expectedAccept = QCryptographicHash::hash(m_key + AcceptGuid, QCryptographicHash::Sha1).toBase64();
+    bool accepted = false;
+    bool deflateNegotiated = false;
+    bool serverNoContextTakeover = false;
+
+    for (int i = 1; i < lines.size(); ++i) {
+        int colon = lines.at(i).indexOf(':');
+        if (colon < 0) {
+            continue;
+        }
+        QByteArray name = lines.at(i).left(colon).trimmed().toLower();
+        QByteArray value = lines.at(i).mid(colon + 1).trimmed();
+
+        if (name == "sec-websocket-accept") {
+            accepted = value == expectedAccept;
+        } else if (name == "sec-websocket-extensions") {
+            const QList<QByteArray> params = value.toLower().split(';');
+            if (params.first().trimmed() == "permessage-deflate") {
+                deflateNegotiated = true;
+                for (const QByteArray& param : params) {
+                    if (param.trimmed() == "server_no_context_takeover") {
+                        serverNoContextTakeover = true;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!accepted) {
+        fail("WebSocket handshake failed: bad Sec-WebSocket-Accept");
+        return false;
+    }
+
+    m_reader.consume(headerEnd + 4);
+    m_reader.setDeflate(deflateNegotiated, serverNoContextTakeover);
+    m_handshakeTimer.stop();
+    m_state = Open;
+    m_connectedEmitted = true;
+    emit connected();
+    return true;
+}
+
+void DeflateWebSocketTransport::onReadyRead()
+{
+    qint64 available = m_socket.bytesAvailable();
+    if (available <= 0) {
+        return;
+    }
+
+    // Read straight into the parser's buffer
+    int wanted = static_cast<int>(qMin<qint64>(available, 16 * 1024 * 1024));
+    qint64 bytesRead = m_socket.read(m_reader.reserve(wanted), wanted);
+    if (bytesRead <= 0) {
+        return;
+    }
+    m_reader.commit(static_cast<int>(bytesRead));
+    m_wireBytes += bytesRead;
+
+    if (m_state == Handshaking && !parseHandshake()) {
+        return;
+    }
+
+    processFrames();
+}
+
+void DeflateWebSocketTransport::processFrames()
+{
+    while (m_state == Open || m_state == Closing) {
+        switch (m_reader.next()) {
+        case WebSocketFrameReader::NeedMore:
+            return;
+        case WebSocketFrameReader::Message: {
+            QByteArray frame = m_reader.payload();
+            m_messageBytes += frame.size();
+            emit frameReceived(frame);
+            if (m_state != Open) {
+                return; // The client closed in response
+            }
+            break;
+        }
+        case WebSocketFrameReader::Ping: {
+            QByteArray data = m_reader.payload();
+            sendFrame(Pong, data.constData(), data.size());
+            break;
+        }
+        case WebSocketFrameReader::Pong:
+            break;
+        case WebSocketFrameReader::Close: {
+            // Echo the status code, then wait for the server to drop TCP
+            if (m_state == Open) {
+                QByteArray data = m_reader.payload();
+                sendFrame(Close, data.constData(), qMin(data.size(), 2));
+                m_state = Closing;
+            }
+            m_socket.disconnectFromHost();
+            return;
+        }
+        case WebSocketFrameReader::Error:
+            fail(m_reader.errorString());
+            return;
+        }
+    }
+}
+
+void DeflateWebSocketTransport::sendFrame(int opcode, const char* data, int length)
+{
+    // Client frames are always masked (RFC 6455 section 5.3)
+    m_sendBuffer.resize(0);
+    m_sendBuffer.append(static_cast<char>(0x80 | opcode));
+
+    if (length < 126) {
+        m_sendBuffer.append(static_cast<char>(0x80 | length));
+    } else if (length < 65536) {
+        m_sendBuffer.append(static_cast<char>(0x80 | 126));
+        m_sendBuffer.append(static_cast<char>((length >> 8) & 0xFF));
+        m_sendBuffer.append(static_cast<char>(length & 0xFF));
+    } else {
+        m_sendBuffer.append(static_cast<char>(0x80 | 127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            m_sendBuffer.append(static_cast<char>((quint64(length) >> shift) & 0xFF));
+        }
+    }
+
+    quint32 maskKey = QRandomGenerator::global()->generate();
+    char mask[4];
+    std::memcpy(mask, &maskKey, 4);
+    m_sendBuffer.append(mask, 4);
+
+    int payloadStart = m_sendBuffer.size();
+    m_sendBuffer.append(data, length);
+    char* payload = m_sendBuffer.data() + payloadStart;
+    for (int i = 0; i < length; ++i) {
+        payload[i] ^= mask[i & 3];
+    }
+
+    m_socket.write(m_sendBuffer);
+}
+
+void DeflateWebSocketTransport::onSocketDisconnected()
+{
+    m_state = Closed;
+    m_handshakeTimer.stop();
+
+    if (m_connectedEmitted) {
+        m_connectedEmitted = false;
+        emit disconnected();
+    }
+}
+
+void DeflateWebSocketTransport::onSocketError()
+{
+    // The server closing after our close frame is expected
+    if (m_state == Closing || m_state == Closed) {
+        return;
+    }
+
+    m_errorString = m_socket.errorString();
+    emit errorOccurred(m_errorString);
+}
+
+void DeflateWebSocketTransport::fail(const QString& message)
+{
+    m_errorString = message;
+    m_state = Closing;
+    m_handshakeTimer.stop();
+    emit errorOccurred(message);
+    m_socket.abort();
+}
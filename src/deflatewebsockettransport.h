@@ -0,0 +1,65 @@
+#ifndef DEFLATEWEBSOCKETTRANSPORT_H
+#define DEFLATEWEBSOCKETTRANSPORT_H
+
+#include "chattransport.h"
+#include <QSslSocket>
+#include <QTimer>
+#include "websocketframereader.h"
+
+// Minimal RFC 6455 client that negotiates permessage-deflate (RFC 7692).
+// Chat JSON is highly repetitive, so with context takeover the server's
+// compressor learns the shared structure and most frames shrink to a few bytes.
+// Framing and decompression live in WebSocketFrameReader; this class owns the
+// socket, the handshake and the replies to control frames.
+//
+// Opt-in with --transport deflate; QWebSocket stays the default.
+class DeflateWebSocketTransport : public ChatTransport {
+    Q_OBJECT
+
+public:
+    explicit DeflateWebSocketTransport(QObject* parent = nullptr);
+    ~DeflateWebSocketTransport();
+
+    void open(const QUrl& url) override;
+    void close() override;
+    bool isConnected() const override;
+    void sendText(const QByteArray& utf8) override;
+    QString errorString() const override;
+
+private slots:
+    void onSocketConnected();
+    void onEncrypted();
+    void onReadyRead();
+    void onSocketDisconnected();
+    void onSocketError();
+
+private:
+    enum State {
+        Closed,
+        Connecting,
+        Handshaking,
+        Open,
+        Closing
+    };
+
+    QSslSocket m_socket;
+    State m_state;
+    bool m_connectedEmitted;
+    QUrl m_url;
+    QByteArray m_key;
+    QString m_errorString;
+
+    // TCP, TLS and the upgrade must all finish within this
+    QTimer m_handshakeTimer;
+
+    WebSocketFrameReader m_reader;
+    QByteArray m_sendBuffer;
+
+    void sendHandshake();
+    bool parseHandshake();
+    void processFrames();
+    void sendFrame(int opcode, const char* data, int length);
+    void fail(const QString& message);
+};
+
+#endif // DEFLATEWEBSOCKETTRANSPORT_H
@@ -0,0 +1,131 @@
+#include "glyphusage.h"
+#include <QSettings>
+#include <algorithm>
+#include <functional>
+
+namespace {
+const int PageShift = 7;
+// Pages warmed per session; about 3000 code points at most
+const int MaxWarmPages = 24;
+// Pages kept in the settings file
+const int MaxStoredPages = 64;
+// Code points per warm-up slice; the renderer checks for cancellation between slices
+const int SliceSize = 48;
+
+// Emoticons: a sensible guess before any history exists
+const quint32 DefaultPage = 0x1F600 >> PageShift;
+}
+
+GlyphUsage::GlyphUsage()
+{
+}
+
+GlyphUsage::~GlyphUsage()
+{
+    save();
+}
+
+void GlyphUsage::observe(const QString& text)
+{
+    const QChar* data = text.constData();
+    const int size = text.size();
+
+    for (int i = 0; i < size; ++i) {
+        ushort unit = data[i].unicode();
+        if (unit < 0x80) {
+            continue;
+        }
+
+        uint codePoint = unit;
+        if (QChar::isHighSurrogate(unit) && i + 1 < size && data[i + 1].isLowSurrogate()) {
+            codePoint = QChar::surrogateToUcs4(unit, data[i + 1].unicode());
+            ++i;
+        }
+        ++m_pageCounts[codePoint >> PageShift];
+    }
+}
+
+void GlyphUsage::save()
+{
+    if (m_pageCounts.isEmpty()) {
+        return;
+    }
+
+    QSettings settings("KickChatOverlay", "Settings");
+    const QVariantMap stored = settings.value("glyphPages").toMap();
+
+    QHash<quint32, quint32> merged = m_pageCounts;
+    for (auto it = stored.cbegin(); it != stored.cend(); ++it) {
+        merged[it.key().toUInt(nullptr, 16)] += it.value().toUInt() / 2;
+    }
+
+    QList<QPair<quint32, quint32>> ranked;
+    for (auto it = merged.cbegin(); it != merged.cend(); ++it) {
+        if (it.value() > 0) {
+            ranked.append(qMakePair(it.value(), it.key()));
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), std::greater<QPair<quint32, quint32>>());
+
+    QVariantMap pages;
+    for (int i = 0; i < qMin(ranked.size(), MaxStoredPages); ++i) {
+        pages.insert(QString::number(ranked.at(i).second, 16), ranked.at(i).first);
+    }
+    settings.setValue("glyphPages", pages);
+
+    m_pageCounts.clear();
+}
+
+QList<quint32> GlyphUsage::recordedPages(int maxPages)
+{
+    QSettings settings("KickChatOverlay", "Settings");
+    const QVariantMap stored = settings.value("glyphPages").toMap();
+
+    QList<QPair<quint32, quint32>> ranked;
+    for (auto it = stored.cbegin(); it != stored.cend(); ++it) {
+        ranked.append(qMakePair(it.value().toUInt(), it.key().toUInt(nullptr, 16)));
+    }
+    std::sort(ranked.begin(), ranked.end(), std::greater<QPair<quint32, quint32>>());
+
+    QList<quint32> pages;
+    for (int i = 0; i < qMin(ranked.size(), maxPages); ++i) {
+        pages.append(ranked.at(i).second);
+    }
+    if (pages.isEmpty()) {
+        pages.append(DefaultPage);
+    }
+    return pages;
+}
+
+QList<QString> GlyphUsage::warmUpSlices()
+{
+    QList<QString> slices;
+    QString slice;
+    int count = 0;
+
+    for (quint32 page : recordedPages(MaxWarmPages)) {
+        for (uint codePoint = page << PageShift; codePoint < (page + 1) << PageShift; ++codePoint) {
+            QChar::Category category = QChar::category(codePoint);
+            if (category == QChar::Other_NotAssigned || category == QChar::Other_Surrogate
+                || category == QChar::Other_PrivateUse || category == QChar::Other_Control) {
+                continue;
+            }
+
+            // Separate code points so combining marks do not stack into one cluster
+            char32_t ucs4 = codePoint;
+            slice += QString::fromUcs4(&ucs4, 1);
+            slice += QLatin1Char(' ');
+
+            if (++count == SliceSize) {
+                slices.append(slice);
+                slice.clear();
+                count = 0;
+            }
+        }
+    }
+
+    if (!slice.isEmpty()) {
+        slices.append(slice);
+    }
+    return slices;
+}
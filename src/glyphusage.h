@@ -0,0 +1,34 @@
+#ifndef GLYPHUSAGE_H
+#define GLYPHUSAGE_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Which Unicode pages (blocks of 128 code points) chat actually uses, kept
+// across sessions in the settings file. ASCII is not tracked; it is warm as
+// soon as the first message is drawn.
+class GlyphUsage {
+public:
+    GlyphUsage();
+    ~GlyphUsage();
+    Q_DISABLE_COPY(GlyphUsage)
+
+    void observe(const QString& text);
+
+    // Merges this session into the stored counts; older sessions decay by half
+    void save();
+
+    // Most used pages first, at most maxPages
+    static QList<quint32> recordedPages(int maxPages);
+
+    // The assigned code points of the most used pages, space separated and
+    // cut into short runs, for RowRenderer::setWarmUpText
+    static QList<QString> warmUpSlices();
+
+private:
+    QHash<quint32, quint32> m_pageCounts;
+};
+
+#endif // GLYPHUSAGE_H
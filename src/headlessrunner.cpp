@@ -0,0 +1,81 @@
+#include "headlessrunner.h"
+#include "virtualclock.h"
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QFile>
+#include <QDebug>
+
+int runHeadless(KickChatClient& client, const HeadlessOptions& options)
+{
+    // stdout carries data only; per-frame debug logging would also dominate the cost
+    QLoggingCategory::setFilterRules("kickchat.*.debug=false");
+
+    if (!options.writer || !options.writer->isOpen()) {
+        return 1;
+    }
+    NdjsonWriter& writer = *options.writer;
+
+    QObject::connect(&client, &KickChatClient::error, &client, [](const QString& errorMessage) {
+        qWarning().noquote() << errorMessage;
+    });
+
+    // Bounds output latency when chat is too slow to fill a buffer
+    QTimer flushTimer;
+    QObject::connect(&flushTimer, &QTimer::timeout, &client, [&writer]() { writer.flush(); });
+    flushTimer.start(100);
+
+    if (!options.replayFile.isEmpty()) {
+        QTimer::singleShot(0, &client, [&client, &writer, &options]() {
+            QFile file(options.replayFile);
+            if (!file.open(QIODevice::ReadOnly)) {
+                qWarning() << "Cannot open replay file:" << file.errorString();
+                QCoreApplication::exit(1);
+                return;
+            }
+
+            const QList<QByteArray> frames = file.readAll().split('\n');
+            QElapsedTimer timer;
+            timer.start();
+            qint64 simulatedStartMs = options.clock ? options.clock->nowMs() : 0;
+
+            for (int pass = 0; pass < options.replayRepeat; ++pass) {
+                for (const QByteArray& frame : frames) {
+                    if (frame.trimmed().isEmpty()) {
+                        continue;
+                    }
+                    client.processFrame(frame);
+                    
+                    // Timers due in between (pings, stats) fire here, in order
+                    if (options.clock) {
+                        options.clock->advance(options.replayIntervalMs);
+                    }
+                }
+            }
+
+            client.flushBatch();
+            writer.close();
+
+            qint64 elapsedMs = qMax<qint64>(1, timer.elapsed());
+            qInfo().noquote() << QString("Replayed %1 messages in %2 ms (%3 msgs/s), %4 dropped")
+                .arg(writer.writtenCount())
+                .arg(elapsedMs)
+                .arg(writer.writtenCount() * 1000 / elapsedMs)
+                .arg(writer.droppedCount());
+            if (options.clock) {
+                qInfo().noquote() << QString("Simulated %1 s of chat")
+                    .arg((options.clock->nowMs() - simulatedStartMs) / 1000);
+            }
+
+            QCoreApplication::quit();
+        });
+    } else {
+        client.connectToChannel(options.channelName);
+    }
+
+    int result = QCoreApplication::exec();
+    client.flushBatch();
+    writer.close();
+    return result;
+}
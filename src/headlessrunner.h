@@ -0,0 +1,31 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QString>
+#include "kickchatclient.h"
+#include "ndjsonwriter.h"
+
+class VirtualClock;
+
+// --headless: no widgets, every decoded message goes to stdout as one NDJSON line
+struct HeadlessOptions {
+    QString channelName;
+    QString replayFile;     // Raw Pusher frames, one per line, decoded instead of connecting
+    int replayRepeat;
+    NdjsonWriter* writer;   // Fed by the ingest pipeline (RecordStage); flushed and closed here
+    VirtualClock* clock;    // When set, simulated time advances replayIntervalMs per frame
+    int replayIntervalMs;
+
+    HeadlessOptions()
+        : replayRepeat(1)
+        , writer(nullptr)
+        , clock(nullptr)
+        , replayIntervalMs(0)
+    {
+    }
+};
+
+// Runs the event loop until the replay finishes or the application quits
+int runHeadless(KickChatClient& client, const HeadlessOptions& options);
+
+#endif // HEADLESSRUNNER_H
@@ -0,0 +1,277 @@
+#include "ingesthelper.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+
+namespace {
+// The helper heartbeats every 500 ms
+const qint64 ProducerTimeoutMs = 5000;
+// More restarts than this within the window means the helper is crash-looping
+const int MaxQuickRestarts = 3;
+const qint64 QuickRestartWindowMs = 5000;
+const int CrashLoopDelayMs = 1000;
+}
+
+IngestHelper::IngestHelper(QObject* parent)
+    : QObject(parent)
+    , m_segment(QString("KickChatOverlay-ingest-%1").arg(QCoreApplication::applicationPid()))
+    , m_ring(nullptr)
+    , m_stopping(false)
+    , m_connected(false)
+    , m_restartCount(0)
+    , m_recentRestarts(0)
+{
+    int size = IngestRing::segmentSize(IngestRing::DefaultCapacity);
+
+    // A segment left behind by a crashed GUI with the same pid is reused
+    if (!m_segment.create(size)) {
+        if (m_segment.error() != QSharedMemory::AlreadyExists || !m_segment.attach()) {
+            m_errorString = m_segment.errorString();
+            qWarning() << "Cannot create ingest ring:" << m_errorString;
+            return;
+        }
+    }
+
+    m_ring = new IngestRing(m_segment.data());
+    m_ring->initialize(IngestRing::DefaultCapacity);
+
+    m_process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    connect(&m_process, &QProcess::readyReadStandardOutput, this, &IngestHelper::onReadyRead);
+    connect(&m_process, &QProcess::finished, this, &IngestHelper::onFinished);
+    connect(&m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError processError) {
+        // finished() never follows a failed start, so retry from here
+        if (processError == QProcess::FailedToStart && !m_stopping) {
+            emit error("Cannot start chat connection helper: " + m_process.errorString());
+            m_restartTimer.start(CrashLoopDelayMs);
+        }
+    });
+
+    connect(&m_watchdogTimer, &QTimer::timeout, this, &IngestHelper::onWatchdog);
+    m_watchdogTimer.setInterval(1000);
+
+    m_restartTimer.setSingleShot(true);
+    connect(&m_restartTimer, &QTimer::timeout, this, &IngestHelper::launch);
+}
+
+IngestHelper::~IngestHelper()
+{
+    stop();
+    delete m_ring;
+}
+
+bool IngestHelper::isValid() const
+{
+    return m_ring != nullptr;
+}
+
+QString IngestHelper::errorString() const
+{
+    return m_errorString;
+}
+
+void IngestHelper::setForwardedArguments(const QStringList& arguments)
+{
+    m_forwardedArguments = arguments;
+}
+
+void IngestHelper::start(const QString& channelName)
+{
+    if (!m_ring) {
+        emit error("Ingest helper unavailable: " + m_errorString);
+        return;
+    }
+
+    stop();
+    m_channelName = channelName;
+    m_stopping = false;
+    m_recentRestarts = 0;
+    m_restartWindow.start();
+    launch();
+    m_watchdogTimer.start();
+}
+
+void IngestHelper::stop()
+{
+    m_stopping = true;
+    m_watchdogTimer.stop();
+    m_restartTimer.stop();
+
+    if (m_process.state() != QProcess::NotRunning) {
+        m_ring->setStopRequested(true);
+        if (!m_process.waitForFinished(1000)) {
+            m_process.kill();
+            m_process.waitForFinished(1000);
+        }
+    }
+
+    if (m_connected) {
+        m_connected = false;
+        emit disconnected();
+    }
+}
+
+bool IngestHelper::isConnected() const
+{
+    return m_connected;
+}
+
+int IngestHelper::restartCount() const
+{
+    return m_restartCount;
+}
+
+void IngestHelper::launch()
+{
+    if (m_stopping) {
+        return;
+    }
+
+    // Unread records from a crashed helper are still valid and get drained
+    // first, unless it corrupted the ring on the way down
+    if (m_ring->isCorrupt()) {
+        m_ring->reset();
+    }
+    m_ring->setStopRequested(false);
+    m_ring->clearNotify();
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    m_ring->setConsumerHeartbeat(now);
+    m_ring->setProducerHeartbeat(now);
+
+    QStringList arguments;
+    arguments << "--ingest-worker" << "--shm-key" << m_segment.key() << "--channel" << m_channelName;
+    arguments << m_forwardedArguments;
+
+    m_process.start(QCoreApplication::applicationFilePath(), arguments);
+    drain();
+}
+
+void IngestHelper::scheduleRestart()
+{
+    ++m_restartCount;
+
+    if (m_restartWindow.elapsed() > QuickRestartWindowMs) {
+        m_restartWindow.restart();
+        m_recentRestarts = 0;
+    }
+
+    // Restart immediately unless the helper keeps dying on startup
+    if (++m_recentRestarts > MaxQuickRestarts) {
+        m_restartTimer.start(CrashLoopDelayMs);
+    } else {
+        launch();
+    }
+}
+
+void IngestHelper::onReadyRead()
+{
+    // The bytes are only wakeups; clear the flag before draining so a record
+    // published during the drain triggers another one
+    m_process.readAllStandardOutput();
+    m_ring->clearNotify();
+    drain();
+}
+
+void IngestHelper::drain()
+{
+    IngestRing::Record record;
+    while (m_ring->peek(&record)) {
+        if (!dispatch(record)) {
+            m_ring->markCorrupt();
+            break;
+        }
+        m_ring->release();
+    }
+
+    // Whatever wrote this cannot be trusted any more: treat it as crashed.
+    // launch() resets the ring once the process is gone.
+    if (m_ring->isCorrupt() && m_process.state() != QProcess::NotRunning) {
+        qWarning() << "Ingest ring is corrupt, killing the helper";
+        m_process.kill();
+    }
+}
+
+bool IngestHelper::dispatch(const IngestRing::Record& record)
+{
+    int offset = 0;
+    QString text;
+
+    switch (record.type) {
+    case IngestRing::Message: {
+        ChatMessage message = ChatMessage(QString(), QString());
+        if (!IngestRing::decodeMessage(record, &message)) {
+            return false;
+        }
+        emit messageReceived(message);
+        break;
+    }
+    case IngestRing::Deleted:
+        if (!IngestRing::decodeString(record, &offset, &text)) {
+            return false;
+        }
+        emit messageDeleted(text);
+        break;
+    case IngestRing::Banned: {
+        qint64 senderId;
+        if (!IngestRing::decodeInt64(record, &offset, &senderId) || !IngestRing::decodeString(record, &offset, &text)) {
+            return false;
+        }
+        emit userBanned(senderId, text);
+        break;
+    }
+    case IngestRing::Connected:
+        m_connected = true;
+        emit connected();
+        break;
+    case IngestRing::Disconnected:
+        if (m_connected) {
+            m_connected = false;
+            emit disconnected();
+        }
+        break;
+    case IngestRing::Error:
+        if (!IngestRing::decodeString(record, &offset, &text)) {
+            return false;
+        }
+        emit error(text);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+void IngestHelper::onFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    // Pick up whatever the helper managed to publish before it went away
+    drain();
+
+    if (m_stopping) {
+        return;
+    }
+
+    qWarning() << "Ingest helper exited" << (exitStatus == QProcess::CrashExit ? "(crashed)" : "")
+               << "with code" << exitCode << "- restarting";
+
+    if (m_connected) {
+        m_connected = false;
+        emit disconnected();
+    }
+    emit error("Chat connection helper stopped unexpectedly, restarting");
+
+    scheduleRestart();
+}
+
+void IngestHelper::onWatchdog()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    m_ring->setConsumerHeartbeat(now);
+
+    // A hung helper is treated like a crashed one; finished() does the restart
+    if (m_process.state() == QProcess::Running && now - m_ring->producerHeartbeat() > ProducerTimeoutMs) {
+        qWarning() << "Ingest helper stopped responding, killing it";
+        m_process.kill();
+    }
+
+    // Records can also arrive while a wakeup is in flight
+    drain();
+}
@@ -0,0 +1,69 @@
+#ifndef INGESTHELPER_H
+#define INGESTHELPER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QSharedMemory>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "chatmessage.h"
+#include "ingestring.h"
+
+// GUI side of --isolate-ingest. Runs this executable again as an ingest worker
+// and drains the shared ring it fills. If the helper crashes or stops
+// heartbeating it is restarted straight away; everything already received stays
+// in the store, so the overlay keeps showing it through the restart. A helper
+// that corrupts the ring is killed and restarted the same way.
+class IngestHelper : public QObject {
+    Q_OBJECT
+
+public:
+    explicit IngestHelper(QObject* parent = nullptr);
+    ~IngestHelper();
+
+    bool isValid() const;
+    QString errorString() const;
+
+    // Passed on to the helper, e.g. --transport or --api-base
+    void setForwardedArguments(const QStringList& arguments);
+
+    void start(const QString& channelName);
+    void stop();
+    bool isConnected() const;
+    int restartCount() const;
+
+signals:
+    void connected();
+    void disconnected();
+    void messageReceived(const ChatMessage& message);
+    void messageDeleted(const QString& messageId);
+    void userBanned(qint64 senderId, const QString& username);
+    void error(const QString& errorMessage);
+
+private slots:
+    void onReadyRead();
+    void onFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onWatchdog();
+
+private:
+    QSharedMemory m_segment;
+    IngestRing* m_ring;
+    QProcess m_process;
+    QTimer m_watchdogTimer;
+    QTimer m_restartTimer;
+    QElapsedTimer m_restartWindow;
+    QString m_channelName;
+    QStringList m_forwardedArguments;
+    QString m_errorString;
+    bool m_stopping;
+    bool m_connected;
+    int m_restartCount;
+    int m_recentRestarts;
+
+    void launch();
+    void scheduleRestart();
+    void drain();
+    bool dispatch(const IngestRing::Record& record);
+};
+
+#endif // INGESTHELPER_H
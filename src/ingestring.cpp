@@ -0,0 +1,364 @@
+#include "ingestring.h"
+#include <cstring>
+#include <new>
+
+namespace {
+const quint32 RingMagic = 0x4b434952; // "KCIR"
+const int DataOffset = 128;           // Header rounded up past a cache line
+
+int align8(int size)
+{
+    return (size + 7) & ~7;
+}
+}
+
+int IngestRing::segmentSize(int capacity)
+{
+    return DataOffset + align8(capacity);
+}
+
+IngestRing::IngestRing(void* memory)
+    : m_header(static_cast<Header*>(memory))
+    , m_data(static_cast<char*>(memory) + DataOffset)
+    , m_pendingEnd(0)
+    , m_capacity(0)
+    , m_corrupt(false)
+{
+    static_assert(sizeof(Header) <= DataOffset, "ring header overlaps the data area");
+}
+
+void IngestRing::initialize(int capacity)
+{
+    new (m_header) Header();
+    m_header->capacity = static_cast<quint32>(align8(capacity));
+    m_header->writePos.store(0);
+    m_header->readPos.store(0);
+    m_header->producerHeartbeat.store(0);
+    m_header->consumerHeartbeat.store(0);
+    m_header->dropped.store(0);
+    m_header->notifyPending.store(0);
+    m_header->stopRequested.store(0);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = RingMagic;
+    m_capacity = m_header->capacity;
+    m_corrupt = false;
+}
+
+bool IngestRing::isValid() const
+{
+    return m_header->magic == RingMagic;
+}
+
+char* IngestRing::reserve(RecordType type, int payloadSize)
+{
+    const quint64 capacity = m_header->capacity;
+    const quint32 size = static_cast<quint32>(align8(sizeof(RecordHeader) + payloadSize));
+    if (size > capacity / 2) {
+        m_header->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    quint64 write = m_header->writePos.load(std::memory_order_relaxed);
+    quint64 read = m_header->readPos.load(std::memory_order_acquire);
+    quint64 offset = write % capacity;
+    quint64 contiguous = capacity - offset;
+
+    // A record never straddles the end; the tail is skipped with a padding record
+    quint64 needed = size <= contiguous ? size : contiguous + size;
+    if (capacity - (write - read) < needed) {
+        m_header->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    if (size > contiguous) {
+        RecordHeader padding = { static_cast<quint32>(contiguous), Padding };
+        std::memcpy(m_data + offset, &padding, sizeof(padding));
+        write += contiguous;
+        offset = 0;
+    }
+
+    char* record = m_data + offset;
+    RecordHeader header = { size, static_cast<quint32>(type) };
+    std::memcpy(record, &header, sizeof(header));
+    m_pendingEnd = write + size;
+    return record + sizeof(RecordHeader);
+}
+
+void IngestRing::commit(char* record)
+{
+    Q_UNUSED(record);
+    m_header->writePos.store(m_pendingEnd, std::memory_order_release);
+}
+
+int IngestRing::stringBytes(const QString& text)
+{
+    return static_cast<int>(sizeof(quint32)) + text.size() * static_cast<int>(sizeof(QChar));
+}
+
+void IngestRing::writeString(char*& out, const QString& text)
+{
+    quint32 length = static_cast<quint32>(text.size());
+    std::memcpy(out, &length, sizeof(length));
+    out += sizeof(length);
+    std::memcpy(out, text.constData(), length * sizeof(QChar));
+    out += length * sizeof(QChar);
+}
+
+bool IngestRing::writeMessage(const ChatMessage& message)
+{
+    const QString username = message.username();
+    const QString text = message.message();
+    const QString messageId = message.messageId();
+
+    int payloadSize = 3 * sizeof(qint64) + 2 * sizeof(quint32)
+        + stringBytes(username) + stringBytes(text) + stringBytes(messageId);
+    char* out = reserve(Message, payloadSize);
+    if (!out) {
+        return false;
+    }
+    char* start = out;
+
+    qint64 timestamp = message.timestamp().toMSecsSinceEpoch();
+    qint64 receivedAt = message.receivedAt().toMSecsSinceEpoch();
+    qint64 senderId = message.senderId();
+    quint32 rgb = message.usernameColor();
+    quint32 roles = static_cast<quint32>(message.roles());
+    std::memcpy(out, &timestamp, sizeof(timestamp));
+    out += sizeof(timestamp);
+    std::memcpy(out, &receivedAt, sizeof(receivedAt));
+    out += sizeof(receivedAt);
+    std::memcpy(out, &senderId, sizeof(senderId));
+    out += sizeof(senderId);
+    std::memcpy(out, &rgb, sizeof(rgb));
+    out += sizeof(rgb);
+    std::memcpy(out, &roles, sizeof(roles));
+    out += sizeof(roles);
+    writeString(out, username);
+    writeString(out, text);
+    writeString(out, messageId);
+
+    commit(start);
+    return true;
+}
+
+bool IngestRing::writeDeleted(const QString& messageId)
+{
+    char* out = reserve(Deleted, stringBytes(messageId));
+    if (!out) {
+        return false;
+    }
+    char* start = out;
+    writeString(out, messageId);
+    commit(start);
+    return true;
+}
+
+bool IngestRing::writeBanned(qint64 senderId, const QString& username)
+{
+    char* out = reserve(Banned, sizeof(qint64) + stringBytes(username));
+    if (!out) {
+        return false;
+    }
+    char* start = out;
+    std::memcpy(out, &senderId, sizeof(senderId));
+    out += sizeof(senderId);
+    writeString(out, username);
+    commit(start);
+    return true;
+}
+
+bool IngestRing::writeStatus(RecordType type, const QString& text)
+{
+    char* out = reserve(type, stringBytes(text));
+    if (!out) {
+        return false;
+    }
+    char* start = out;
+    writeString(out, text);
+    commit(start);
+    return true;
+}
+
+bool IngestRing::peek(Record* record)
+{
+    if (m_corrupt) {
+        return false;
+    }
+
+    const quint64 capacity = m_capacity;
+
+    for (;;) {
+        quint64 read = m_header->readPos.load(std::memory_order_relaxed);
+        quint64 write = m_header->writePos.load(std::memory_order_acquire);
+        if (read == write) {
+            return false;
+        }
+        if (write < read || write - read > capacity) {
+            m_corrupt = true;
+            return false;
+        }
+
+        const quint64 offset = read % capacity;
+        const char* data = m_data + offset;
+        RecordHeader header;
+        std::memcpy(&header, data, sizeof(header));
+
+        // A record is at least its header, 8-byte aligned, ends before the wrap
+        // point and was fully published
+        if (header.size < sizeof(RecordHeader) || header.size % 8 != 0
+            || header.size > capacity - offset || header.size > write - read
+            || header.type > Error) {
+            m_corrupt = true;
+            return false;
+        }
+
+        if (header.type == Padding) {
+            m_header->readPos.store(read + header.size, std::memory_order_release);
+            continue;
+        }
+
+        record->type = static_cast<RecordType>(header.type);
+        record->payload = data + sizeof(RecordHeader);
+        record->payloadSize = static_cast<int>(header.size - sizeof(RecordHeader));
+        m_pendingEnd = read + header.size;
+        return true;
+    }
+}
+
+void IngestRing::release()
+{
+    m_header->readPos.store(m_pendingEnd, std::memory_order_release);
+}
+
+bool IngestRing::isCorrupt() const
+{
+    return m_corrupt;
+}
+
+void IngestRing::markCorrupt()
+{
+    m_corrupt = true;
+}
+
+void IngestRing::reset()
+{
+    m_header->capacity = static_cast<quint32>(m_capacity);
+    m_header->readPos.store(0, std::memory_order_relaxed);
+    m_header->writePos.store(0, std::memory_order_relaxed);
+    m_header->notifyPending.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = RingMagic;
+    m_pendingEnd = 0;
+    m_corrupt = false;
+}
+
+bool IngestRing::decodeString(const Record& record, int* offset, QString* text)
+{
+    quint32 length;
+    if (record.payloadSize - *offset < static_cast<int>(sizeof(length))) {
+        return false;
+    }
+    std::memcpy(&length, record.payload + *offset, sizeof(length));
+    *offset += sizeof(length);
+
+    if (length > static_cast<quint32>(record.payloadSize - *offset) / sizeof(QChar)) {
+        return false;
+    }
+
+    // Records are 8-byte aligned and every field before a string is even-sized,
+    // so the UTF-16 data can be read in place
+    *text = QString(reinterpret_cast<const QChar*>(record.payload + *offset), static_cast<int>(length));
+    *offset += static_cast<int>(length * sizeof(QChar));
+    return true;
+}
+
+bool IngestRing::decodeInt64(const Record& record, int* offset, qint64* value)
+{
+    if (record.payloadSize - *offset < static_cast<int>(sizeof(qint64))) {
+        return false;
+    }
+    std::memcpy(value, record.payload + *offset, sizeof(qint64));
+    *offset += sizeof(qint64);
+    return true;
+}
+
+bool IngestRing::decodeMessage(const Record& record, ChatMessage* message)
+{
+    const char* data = record.payload;
+    int offset = 0;
+
+    qint64 timestamp;
+    qint64 receivedAt;
+    qint64 senderId;
+    quint32 rgb;
+    quint32 roles;
+    if (!decodeInt64(record, &offset, &timestamp) || !decodeInt64(record, &offset, &receivedAt)
+        || !decodeInt64(record, &offset, &senderId)
+        || record.payloadSize - offset < static_cast<int>(sizeof(rgb) + sizeof(roles))) {
+        return false;
+    }
+    std::memcpy(&rgb, data + offset, sizeof(rgb));
+    offset += sizeof(rgb);
+    std::memcpy(&roles, data + offset, sizeof(roles));
+    offset += sizeof(roles);
+
+    QString username;
+    QString text;
+    QString messageId;
+    if (!decodeString(record, &offset, &username) || !decodeString(record, &offset, &text)
+        || !decodeString(record, &offset, &messageId)) {
+        return false;
+    }
+
+    *message = ChatMessage(username, text, rgb, QDateTime::fromMSecsSinceEpoch(timestamp));
+    message->setReceivedAt(QDateTime::fromMSecsSinceEpoch(receivedAt));
+    message->setSenderId(senderId);
+    message->setRoles(ChatMessage::Roles(static_cast<int>(roles)));
+    message->setMessageId(messageId);
+    return true;
+}
+
+bool IngestRing::claimNotify()
+{
+    return m_header->notifyPending.exchange(1, std::memory_order_acq_rel) == 0;
+}
+
+void IngestRing::clearNotify()
+{
+    m_header->notifyPending.store(0, std::memory_order_release);
+}
+
+void IngestRing::setProducerHeartbeat(qint64 ms)
+{
+    m_header->producerHeartbeat.store(ms, std::memory_order_relaxed);
+}
+
+qint64 IngestRing::producerHeartbeat() const
+{
+    return m_header->producerHeartbeat.load(std::memory_order_relaxed);
+}
+
+void IngestRing::setConsumerHeartbeat(qint64 ms)
+{
+    m_header->consumerHeartbeat.store(ms, std::memory_order_relaxed);
+}
+
+qint64 IngestRing::consumerHeartbeat() const
+{
+    return m_header->consumerHeartbeat.load(std::memory_order_relaxed);
+}
+
+void IngestRing::setStopRequested(bool stop)
+{
+    m_header->stopRequested.store(stop ? 1 : 0, std::memory_order_release);
+}
+
+bool IngestRing::stopRequested() const
+{
+    return m_header->stopRequested.load(std::memory_order_acquire) != 0;
+}
+
+quint64 IngestRing::droppedCount() const
+{
+    return m_header->dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,116 @@
+#ifndef INGESTRING_H
+#define INGESTRING_H
+
+#include <QString>
+#include <atomic>
+#include "chatmessage.h"
+
+// Single-producer/single-consumer ring of chat events laid out in a shared
+// memory segment: the ingest helper process writes, the GUI process reads.
+// Records are stored contiguously (a padding record skips the wrap point), so
+// the reader builds its QStrings straight from the mapped memory.
+//
+// Positions only grow and are published with release/acquire ordering. A
+// writer that dies mid-record never advanced the write position, so a
+// restarted writer simply continues where the last complete record ended.
+//
+// The reader trusts nothing it finds in the segment: a writer that scribbles
+// over it before dying must not be able to hang or crash the reader. Every
+// position, record size and string length is checked before use; on the first
+// inconsistency peek() stops returning records and isCorrupt() turns true, and
+// the reader has to stop the writer and reset() the ring.
+class IngestRing {
+public:
+    enum RecordType {
+        Padding = 0,
+        Message = 1,
+        Deleted = 2,
+        Banned = 3,
+        Connected = 4,
+        Disconnected = 5,
+        Error = 6
+    };
+
+    // A record as seen by the reader; valid until release()
+    struct Record {
+        RecordType type;
+        const char* payload;
+        int payloadSize;
+    };
+
+    static const int DefaultCapacity = 4 * 1024 * 1024;
+    static int segmentSize(int capacity);
+
+    explicit IngestRing(void* memory);
+
+    // Called once by the process that created the segment
+    void initialize(int capacity);
+    bool isValid() const;
+
+    // Writer side. Returns false (and counts a drop) when the reader is too far behind.
+    bool writeMessage(const ChatMessage& message);
+    bool writeDeleted(const QString& messageId);
+    bool writeBanned(qint64 senderId, const QString& username);
+    bool writeStatus(RecordType type, const QString& text = QString());
+
+    // Reader side. The decoders return false when a field runs past the payload.
+    bool peek(Record* record);
+    void release();
+    static bool decodeMessage(const Record& record, ChatMessage* message);
+    static bool decodeString(const Record& record, int* offset, QString* text);
+    static bool decodeInt64(const Record& record, int* offset, qint64* value);
+
+    bool isCorrupt() const;
+    void markCorrupt();
+    // Drops everything unread; only while no writer is attached
+    void reset();
+
+    // Wakeups are coalesced: the writer only signals when the reader has
+    // consumed the previous signal
+    bool claimNotify();
+    void clearNotify();
+
+    // Liveness in both directions, in ms since the epoch
+    void setProducerHeartbeat(qint64 ms);
+    qint64 producerHeartbeat() const;
+    void setConsumerHeartbeat(qint64 ms);
+    qint64 consumerHeartbeat() const;
+
+    void setStopRequested(bool stop);
+    bool stopRequested() const;
+
+    quint64 droppedCount() const;
+
+private:
+    struct Header {
+        quint32 magic;
+        quint32 capacity;
+        std::atomic<quint64> writePos;
+        std::atomic<quint64> readPos;
+        std::atomic<qint64> producerHeartbeat;
+        std::atomic<qint64> consumerHeartbeat;
+        std::atomic<quint64> dropped;
+        std::atomic<quint32> notifyPending;
+        std::atomic<quint32> stopRequested;
+    };
+
+    struct RecordHeader {
+        quint32 size;
+        quint32 type;
+    };
+
+    Header* m_header;
+    char* m_data;
+    quint64 m_pendingEnd;
+    // The reader's own copy, so a corrupted header cannot move it
+    quint64 m_capacity;
+    bool m_corrupt;
+
+    char* reserve(RecordType type, int payloadSize);
+    void commit(char* record);
+
+    static int stringBytes(const QString& text);
+    static void writeString(char*& out, const QString& text);
+};
+
+#endif // INGESTRING_H
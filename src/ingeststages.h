@@ -0,0 +1,88 @@
+#ifndef INGESTSTAGES_H
+#define INGESTSTAGES_H
+
+#include <QList>
+#include "chatmessage.h"
+#include "chatstatistics.h"
+#include "chatfanoutserver.h"
+#include "ndjsonwriter.h"
+
+// Stages for MessagePipeline on the client's ingest path, after the client's
+// own prepare stages (preparestages.h). They are small and defined inline so
+// the pipeline can inline them into its batch loop.
+
+// Feeds the session statistics; a null statistics object disables the stage
+class StatisticsStage {
+public:
+    explicit StatisticsStage(ChatStatistics* statistics = nullptr)
+        : m_statistics(statistics)
+    {
+    }
+
+    static const char* name() { return "statistics"; }
+
+    void process(QList<ChatMessage>& batch)
+    {
+        if (!m_statistics) {
+            return;
+        }
+        for (const ChatMessage& message : batch) {
+            m_statistics->record(message);
+        }
+    }
+
+private:
+    ChatStatistics* m_statistics;
+};
+
+// Rebroadcasts to local consumers (--serve-ws, --serve-socket); a null server
+// disables the stage
+class FanoutStage {
+public:
+    explicit FanoutStage(ChatFanoutServer* server = nullptr)
+        : m_server(server)
+    {
+    }
+
+    static const char* name() { return "fanout"; }
+
+    void process(QList<ChatMessage>& batch)
+    {
+        if (!m_server) {
+            return;
+        }
+        for (const ChatMessage& message : batch) {
+            m_server->publish(message);
+        }
+    }
+
+private:
+    ChatFanoutServer* m_server;
+};
+
+// Writes every message to the NDJSON stream (--headless); a null writer
+// disables the stage
+class RecordStage {
+public:
+    explicit RecordStage(NdjsonWriter* writer = nullptr)
+        : m_writer(writer)
+    {
+    }
+
+    static const char* name() { return "record"; }
+
+    void process(QList<ChatMessage>& batch)
+    {
+        if (!m_writer) {
+            return;
+        }
+        for (const ChatMessage& message : batch) {
+            m_writer->write(message);
+        }
+    }
+
+private:
+    NdjsonWriter* m_writer;
+};
+
+#endif // INGESTSTAGES_H
@@ -0,0 +1,90 @@
+#include "ingestworker.h"
+#include "ingestring.h"
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QSharedMemory>
+#include <QDateTime>
+#include <QTimer>
+#include <QDebug>
+#include <cstdio>
+
+namespace {
+// The GUI refreshes its heartbeat every second; give it plenty of slack
+const qint64 ConsumerTimeoutMs = 5000;
+}
+
+int runIngestWorker(KickChatClient& client, const QString& shmKey, const QString& channelName)
+{
+    // stderr is forwarded to the GUI's console, keep it for warnings
+    QLoggingCategory::setFilterRules("kickchat.*.debug=false");
+
+    QSharedMemory segment(shmKey);
+    if (!segment.attach()) {
+        qWarning() << "Cannot attach ingest ring:" << segment.errorString();
+        return 1;
+    }
+
+    IngestRing ring(segment.data());
+    if (!ring.isValid()) {
+        qWarning() << "Ingest ring is not initialized";
+        return 1;
+    }
+
+    // stdout only carries one-byte wakeups; the data itself goes through the ring
+    auto notify = [&ring]() {
+        if (ring.claimNotify()) {
+            std::fputc('\n', stdout);
+            std::fflush(stdout);
+        }
+    };
+
+    QObject::connect(&client, &KickChatClient::messageReceived, &client, [&ring, notify](const ChatMessage& message) {
+        if (ring.writeMessage(message)) {
+            notify();
+        }
+    });
+    QObject::connect(&client, &KickChatClient::messageDeleted, &client, [&ring, notify](const QString& messageId) {
+        if (ring.writeDeleted(messageId)) {
+            notify();
+        }
+    });
+    QObject::connect(&client, &KickChatClient::userBanned, &client, [&ring, notify](qint64 senderId, const QString& username) {
+        if (ring.writeBanned(senderId, username)) {
+            notify();
+        }
+    });
+    QObject::connect(&client, &KickChatClient::connected, &client, [&ring, notify]() {
+        if (ring.writeStatus(IngestRing::Connected)) {
+            notify();
+        }
+    });
+    QObject::connect(&client, &KickChatClient::disconnected, &client, [&ring, notify]() {
+        if (ring.writeStatus(IngestRing::Disconnected)) {
+            notify();
+        }
+    });
+    QObject::connect(&client, &KickChatClient::error, &client, [&ring, notify](const QString& errorMessage) {
+        if (ring.writeStatus(IngestRing::Error, errorMessage)) {
+            notify();
+        }
+    });
+
+    // Exit on request, or when the GUI is gone so no helper outlives it
+    QTimer heartbeatTimer;
+    QObject::connect(&heartbeatTimer, &QTimer::timeout, &client, [&ring]() {
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        ring.setProducerHeartbeat(now);
+        if (ring.stopRequested() || now - ring.consumerHeartbeat() > ConsumerTimeoutMs) {
+            QCoreApplication::quit();
+        }
+    });
+    ring.setProducerHeartbeat(QDateTime::currentMSecsSinceEpoch());
+    heartbeatTimer.start(500);
+
+    client.connectToChannel(channelName);
+    int result = QCoreApplication::exec();
+
+    client.disconnectFromChannel();
+    segment.detach();
+    return result;
+}
@@ -0,0 +1,12 @@
+#ifndef INGESTWORKER_H
+#define INGESTWORKER_H
+
+#include <QString>
+#include "kickchatclient.h"
+
+// --ingest-worker: the helper side of --isolate-ingest. Connects to the channel
+// and publishes every decoded event into the shared ring named by shmKey, so a
+// crash in networking or decoding only takes down this process.
+int runIngestWorker(KickChatClient& client, const QString& shmKey, const QString& channelName);
+
+#endif // INGESTWORKER_H
@@ -1,4 +1,6 @@
 #include "kickchatclient.h"
+#include "startupmetrics.h"
+#include "ingesthelper.h"
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QNetworkRequest>
@@ -6,25 +8,61 @@
 #include <QUrlQuery>
 #include <QRandomGenerator>
 #include <QDebug>
+#include <QLoggingCategory>
+#include <QThreadPool>
+#include <QCoreApplication>
+#include <QPointer>
+#include <algorithm>
+
+// Per-frame logging goes through a category so headless/bulk runs can turn it
+// off without paying for the string formatting
+Q_LOGGING_CATEGORY(lcKickChat, "kickchat.client")
+
+namespace {
+// A batch is processed early once it gets this big (e.g. a replay decoding
+// frames in a tight loop)
+const int MaxBatchSize = 256;
+// History messages handed to the GUI thread per event
+const int HistoryChunkSize = 50;
+// Live chat is never held back longer than this waiting for history
+const int PrefillTimeoutMs = 3000;
+}
 
 KickChatClient::KickChatClient(QObject* parent)
     : QObject(parent)
+    , m_transport(nullptr)
+    , m_ingestHelper(nullptr)
+    , m_apiBaseUrl("https://kick.com")
+    , m_chatroomResolver(&m_networkManager)
+    , m_chatroomId(0)
+    , m_chatroomLookupFailed(false)
+    , m_historyReply(nullptr)
+    , m_prefillGeneration(0)
+    , m_prefillPending(false)
+    , m_prefillCount(0)
     , m_reconnectAttempts(0)
     , m_maxReconnectAttempts(5)
+    , m_batchScheduled(false)
 {
-    // Connect WebSocket signals
-    connect(&m_webSocket, &QWebSocket::connected, this, &KickChatClient::onConnected);
-    connect(&m_webSocket, &QWebSocket::disconnected, this, &KickChatClient::onDisconnected);
-    connect(&m_webSocket, &QWebSocket::textMessageReceived, this, &KickChatClient::onTextMessageReceived);
-    connect(&m_webSocket, &QWebSocket::errorOccurred, this, &KickChatClient::onError);
+    setTransport(ChatTransport::defaultKind());
+    
+    connect(&m_chatroomResolver, &ChatroomResolver::resolved, this, &KickChatClient::onChatroomResolved);
+    connect(&m_chatroomResolver, &ChatroomResolver::resolveFailed, this, &KickChatClient::onChatroomResolveFailed);
     
     // Setup ping timer for keeping connection alive
-    connect(&m_pingTimer, &QTimer::timeout, this, &KickChatClient::onPingTimerTimeout);
+    connect(&m_pingTimer, &ClockTimer::timeout, this, &KickChatClient::onPingTimerTimeout);
     m_pingTimer.setInterval(30000); // 30 seconds
     
     // Setup reconnect timer
-    connect(&m_reconnectTimer, &QTimer::timeout, this, &KickChatClient::onReconnectTimer);
+    connect(&m_reconnectTimer, &ClockTimer::timeout, this, &KickChatClient::onReconnectTimer);
     m_reconnectTimer.setSingleShot(true);
+    
+    m_prefillTimer.setSingleShot(true);
+    m_prefillTimer.setInterval(PrefillTimeoutMs);
+    connect(&m_prefillTimer, &ClockTimer::timeout, this, [this]() {
+        qCDebug(lcKickChat) << "History did not arrive in time, showing live chat";
+        finishPrefill();
+    });
 }
 
 KickChatClient::~KickChatClient()
@@ -44,11 +82,28 @@ void KickChatClient::connectToChannel(const QString& channelName)
     
     m_channelName = channelName;
     
+    if (m_ingestHelper) {
+        m_ingestHelper->start(channelName);
+        return;
+    }
+    
     // Try direct approach - use a direct WebSocket connection to Kick's chat service
-    qDebug() << "Attempting direct WebSocket connection for channel:" << channelName;
+    qCDebug(lcKickChat) << "Attempting direct WebSocket connection for channel:" << channelName;
+    
+    // History is fetched by channel name
+    m_channelId = channelName;
     
-    // Directly connect to the chatroom without getting channel ID first
-    m_channelId = channelName; // Use the channel name directly
+    // A cached chatroom ID (even a stale one) is subscribed to as soon as the
+    // socket is up; otherwise the lookup races the handshake
+    bool stale = false;
+    m_chatroomId = m_chatroomResolver.cachedChatroomId(channelName, &stale);
+    m_chatroomLookupFailed = false;
+    if (m_chatroomId == 0 || stale) {
+        m_chatroomResolver.resolve(channelName);
+    }
+    
+    // History travels over its own connection while the socket handshakes
+    fetchHistory();
     connectWebSocketDirect();
 }
 
@@ -57,51 +112,124 @@ void KickChatClient::disconnectFromChannel()
     // Stop reconnect attempts
     m_reconnectTimer.stop();
     
-    if (m_webSocket.isValid()) {
-        m_webSocket.close();
+    if (m_ingestHelper) {
+        m_ingestHelper->stop();
     }
+    m_transport->close();
     m_pingTimer.stop();
+    
+    ++m_prefillGeneration;
+    m_prefillTimer.stop();
+    m_prefillPending = false;
+    m_heldMessages.clear();
+    if (m_historyReply) {
+        m_historyReply->abort();
+    }
+    
     m_channelId.clear();
     m_channelName.clear();
+    m_chatroomId = 0;
+    m_chatroomLookupFailed = false;
+    m_subscribedChannel.clear();
 }
 
 bool KickChatClient::isConnected() const
 {
-    return m_webSocket.state() == QAbstractSocket::ConnectedState;
+    if (m_ingestHelper) {
+        return m_ingestHelper->isConnected();
+    }
+    return m_transport->isConnected();
+}
+
+QString KickChatClient::channelName() const
+{
+    return m_channelName;
+}
+
+void KickChatClient::setTransport(ChatTransport::Kind kind)
+{
+    setTransport(ChatTransport::create(kind));
+}
+
+void KickChatClient::setTransport(ChatTransport* transport)
+{
+    if (m_transport) {
+        m_transport->disconnect(this);
+        m_transport->close();
+        m_transport->deleteLater();
+    }
+    
+    m_transport = transport;
+    m_transport->setParent(this);
+    
+    // Frames may be views into the transport's buffer, so decoding must stay a direct call
+    connect(m_transport, &ChatTransport::connected, this, &KickChatClient::onConnected);
+    connect(m_transport, &ChatTransport::disconnected, this, &KickChatClient::onDisconnected);
+    connect(m_transport, &ChatTransport::frameReceived, this, &KickChatClient::onFrameReceived, Qt::DirectConnection);
+    connect(m_transport, &ChatTransport::errorOccurred, this, &KickChatClient::onError);
+}
+
+ChatTransport* KickChatClient::transport() const
+{
+    return m_transport;
+}
+
+void KickChatClient::setApiBaseUrl(const QUrl& url)
+{
+    m_apiBaseUrl = url;
+    m_chatroomResolver.setApiBaseUrl(url);
+}
+
+QUrl KickChatClient::apiBaseUrl() const
+{
+    return m_apiBaseUrl;
+}
+
+void KickChatClient::setIngestHelper(IngestHelper* helper)
+{
+    m_ingestHelper = helper;
+    
+    // Reconnecting is the helper's job, the local transport stays closed
+    connect(helper, &IngestHelper::connected, this, &KickChatClient::connected);
+    connect(helper, &IngestHelper::disconnected, this, &KickChatClient::disconnected);
+    connect(helper, &IngestHelper::messageReceived, this, &KickChatClient::publish);
+    
+    // Removals must not overtake messages still waiting in the batch
+    connect(helper, &IngestHelper::messageDeleted, this, [this](const QString& messageId) {
+        flushBatch();
+        emit messageDeleted(messageId);
+    });
+    connect(helper, &IngestHelper::userBanned, this, [this](qint64 senderId, const QString& username) {
+        flushBatch();
+        emit userBanned(senderId, username);
+    });
+    connect(helper, &IngestHelper::error, this, &KickChatClient::error);
 }
 
 void KickChatClient::connectWebSocketDirect()
 {
-    qDebug() << "Connecting to Kick WebSocket directly";
+    qCDebug(lcKickChat) << "Connecting to Kick WebSocket directly";
     
     // Connect to Kick's WebSocket server with the mt1 cluster explicitly specified
     QUrl url("wss://ws-mt1.pusher.com/app/eb1d5f283081a78b932c?protocol=7&client=js&version=7.4.0&cluster=mt1");
     
-    qDebug() << "WebSocket URL:" << url.toString();
+    qCDebug(lcKickChat) << "WebSocket URL:" << url.toString();
     
-    m_webSocket.open(url);
+    m_transport->open(url);
 }
 
 void KickChatClient::onConnected()
 {
-    qDebug() << "WebSocket connected";
+    qCDebug(lcKickChat) << "WebSocket connected";
+    StartupMetrics::mark("connected");
     
     // Reset reconnect counter on successful connection
     m_reconnectAttempts = 0;
     m_reconnectTimer.stop();
     
     // Subscribe to the channel chat after connection
-    QJsonObject subscribeMsg;
-    subscribeMsg["event"] = "pusher:subscribe";
-    
-    QJsonObject data;
-    data["channel"] = QString("channel-%1").arg(m_channelName);
-    subscribeMsg["data"] = data;
-    
-    QString message = QJsonDocument(subscribeMsg).toJson(QJsonDocument::Compact);
-    qDebug() << "Sending subscription message:" << message;
-    
-    m_webSocket.sendTextMessage(message);
+    m_subscribedChannel.clear();
+    subscribe();
     
     // Start the ping timer to keep the connection alive
     m_pingTimer.start();
@@ -111,8 +239,10 @@ void KickChatClient::onConnected()
 
 void KickChatClient::onDisconnected()
 {
-    qDebug() << "WebSocket disconnected";
+    qCDebug(lcKickChat) << "WebSocket disconnected," << m_transport->wireBytes() << "bytes on the wire for"
+                        << m_transport->messageBytes() << "bytes of messages";
     m_pingTimer.stop();
+    m_subscribedChannel.clear();
     emit disconnected();
     
     // Try to reconnect if we still have a channel name
@@ -121,13 +251,18 @@ void KickChatClient::onDisconnected()
     }
 }
 
-void KickChatClient::onTextMessageReceived(const QString& message)
+void KickChatClient::onFrameReceived(const QByteArray& frame)
+{
+    processFrame(frame);
+}
+
+void KickChatClient::processFrame(const QByteArray& frame)
 {
-    qDebug() << "Received WebSocket message:" << message.left(200) + (message.length() > 200 ? "..." : "");
+    qCDebug(lcKickChat) << "Received WebSocket message:" << frame.left(200) + (frame.length() > 200 ? "..." : "");
     
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(message.toUtf8());
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(frame);
     if (!jsonDoc.isObject()) {
-        qDebug() << "Received non-object JSON";
+        qCDebug(lcKickChat) << "Received non-object JSON";
         return;
     }
     
@@ -139,70 +274,115 @@ void KickChatClient::processMessage(const QJsonDocument& jsonDoc)
     QJsonObject messageObj = jsonDoc.object();
     QString eventName = messageObj["event"].toString();
     
-    qDebug() << "Received event:" << eventName;
+    qCDebug(lcKickChat) << "Received event:" << eventName;
     
     // Handle chat messages
     if (eventName == "App\\Events\\ChatMessageEvent") {
         QString dataStr = messageObj["data"].toString();
-        qDebug() << "Chat message data:" << dataStr.left(200) + (dataStr.length() > 200 ? "..." : "");
+        qCDebug(lcKickChat) << "Chat message data:" << dataStr.left(200) + (dataStr.length() > 200 ? "..." : "");
         
         QJsonObject dataObj = QJsonDocument::fromJson(dataStr.toUtf8()).object();
-        QJsonObject messageData = dataObj["message"].toObject();
-        
-        QString username = messageData["sender"].toObject()["username"].toString();
-        QString content = messageData["content"].toString();
+        // Older payloads wrap the message in "message", current ones don't
+        QJsonObject messageData = dataObj.contains("message") ? dataObj["message"].toObject() : dataObj;
         
-        qDebug() << "Chat message from" << username << ":" << content;
+        deliver(decodeChatMessage(messageData, QDateTime()));
+    }
+    else if (eventName == "App\\Events\\MessageDeletedEvent") {
+        QJsonObject dataObj = QJsonDocument::fromJson(messageObj["data"].toString().toUtf8()).object();
+        QString messageId = dataObj["message"].toObject()["id"].toString();
+        qCDebug(lcKickChat) << "Message deleted:" << messageId;
         
-        // Get color from the message if available, or generate a random one
-        QColor userColor;
-        if (messageData["sender"].toObject().contains("identity") && 
-            messageData["sender"].toObject()["identity"].toObject().contains("color")) {
-            QString colorStr = messageData["sender"].toObject()["identity"].toObject()["color"].toString();
-            userColor = QColor(colorStr);
-        } else {
-            // Generate a random color if none is provided
-            int r = QRandomGenerator::global()->bounded(128, 256);
-            int g = QRandomGenerator::global()->bounded(128, 256);
-            int b = QRandomGenerator::global()->bounded(128, 256);
-            userColor = QColor(r, g, b);
+        if (!messageId.isEmpty()) {
+            // The message may still be held for the prefill or batched
+            m_heldMessages.erase(std::remove_if(m_heldMessages.begin(), m_heldMessages.end(),
+                                                [&messageId](const ChatMessage& held) {
+                                                    return held.messageId() == messageId;
+                                                }),
+                                 m_heldMessages.end());
+            flushBatch();
+            emit messageDeleted(messageId);
         }
+    }
+    else if (eventName == "App\\Events\\UserBannedEvent") {
+        QJsonObject dataObj = QJsonDocument::fromJson(messageObj["data"].toString().toUtf8()).object();
+        QJsonObject user = dataObj["user"].toObject();
+        qint64 senderId = user["id"].toVariant().toLongLong();
+        qCDebug(lcKickChat) << "User banned:" << user["username"].toString();
         
-        // Create and emit the chat message
-        ChatMessage chatMsg(username, content, userColor);
-        emit messageReceived(chatMsg);
+        if (senderId != 0) {
+            m_heldMessages.erase(std::remove_if(m_heldMessages.begin(), m_heldMessages.end(),
+                                                [senderId](const ChatMessage& held) {
+                                                    return held.senderId() == senderId;
+                                                }),
+                                 m_heldMessages.end());
+            flushBatch();
+            emit userBanned(senderId, user["username"].toString());
+        }
     }
     else if (eventName == "pusher:connection_established") {
-        qDebug() << "Pusher connection established";
+        qCDebug(lcKickChat) << "Pusher connection established";
         
         // Subscribe to the channel chat after connection is established
-        QJsonObject subscribeMsg;
-        subscribeMsg["event"] = "pusher:subscribe";
-        
-        QJsonObject data;
-        data["channel"] = QString("channel-%1").arg(m_channelName);
-        subscribeMsg["data"] = data;
-        
-        QString message = QJsonDocument(subscribeMsg).toJson(QJsonDocument::Compact);
-        qDebug() << "Sending subscription message:" << message;
-        
-        m_webSocket.sendTextMessage(message);
+        subscribe();
     }
     else if (eventName == "pusher_internal:subscription_succeeded") {
-        qDebug() << "Successfully subscribed to chat channel";
+        qCDebug(lcKickChat) << "Successfully subscribed to chat channel";
     }
     else if (eventName == "pusher:error") {
         QJsonObject data = messageObj["data"].toObject();
         QString errorMessage = data["message"].toString();
-        qDebug() << "Pusher error:" << errorMessage;
+        qCDebug(lcKickChat) << "Pusher error:" << errorMessage;
         emit error("Pusher error: " + errorMessage);
     }
 }
 
-void KickChatClient::onError(QAbstractSocket::SocketError error)
+ChatMessage KickChatClient::decodeChatMessage(const QJsonObject& messageData, const QDateTime& timestamp)
 {
-    qDebug() << "WebSocket error:" << m_webSocket.errorString();
-    emit this->error("WebSocket error: " + m_webSocket.errorString());
+    // Raw text; the prepare pipeline (SanitizeStage) cleans it before anyone sees it
+    QString username = messageData["sender"].toObject()["username"].toString();
+    QString content = messageData["content"].toString();
+    
+    qCDebug(lcKickChat) << "Chat message from" << username << ":" << content;
+    
+    // Get color from the message if available, or derive one from the name
+    quint32 userColor;
+    QString colorStr = messageData["sender"].toObject()["identity"].toObject()["color"].toString();
+    if (!ChatMessage::parseColor(colorStr, &userColor)) {
+        // Stable per user, so replays are reproducible
+        QRandomGenerator generator(static_cast<quint32>(qHash(username, 0)));
+        quint32 r = generator.bounded(128, 256);
+        quint32 g = generator.bounded(128, 256);
+        quint32 b = generator.bounded(128, 256);
+        userColor = r << 16 | g << 8 | b;
+    }
+    
+    // Badges tell us who must never be dropped under load
+    ChatMessage::Roles roles = ChatMessage::NoRole;
+    const QJsonArray badges = messageData["sender"].toObject()["identity"].toObject()["badges"].toArray();
+    for (const QJsonValue& badge : badges) {
+        QString type = badge.toObject()["type"].toString();
+        if (type == "broadcaster") {
+            roles |= ChatMessage::Broadcaster;
+        } else if (type == "moderator") {
+            roles |= ChatMessage::Moderator;
+        } else if (type == "vip") {
+            roles |= ChatMessage::Vip;
+        } else if (type == "subscriber" || type == "founder") {
+            roles |= ChatMessage::Subscriber;
+        }
+    }
+    
+    ChatMessage chatMsg(username, content, userColor, timestamp);
+    chatMsg.setRoles(roles);
+    chatMsg.setMessageId(messageData["id"].toString());
+    chatMsg.setSenderId(messageData["sender"].toObject()["id"].toVariant().toLongLong());
+    return chatMsg;
+}
+
+void KickChatClient::onError(const QString& errorMessage)
+{
+    qCDebug(lcKickChat) << "WebSocket error:" << errorMessage;
+    emit error("WebSocket error: " + errorMessage);
     
     // Try to reconnect after an error
     if (!m_channelName.isEmpty()) {
@@ -229,23 +409,317 @@ void KickChatClient::startReconnectTimer()
 
 void KickChatClient::onReconnectTimer()
 {
-    qDebug() << "Attempting to reconnect";
+    qCDebug(lcKickChat) << "Attempting to reconnect";
     if (!m_channelName.isEmpty()) {
         connectWebSocketDirect();
     }
 }
 
+void KickChatClient::subscribe()
+{
+    // Nothing to subscribe to until the chatroom lookup is done
+    QString channel = subscriptionChannel();
+    if (channel.isEmpty() || !m_transport->isConnected()) {
+        return;
+    }
+    
+    // The chatroom changed under a stale cache entry
+    if (!m_subscribedChannel.isEmpty() && m_subscribedChannel != channel) {
+        QJsonObject unsubscribeMsg;
+        unsubscribeMsg["event"] = "pusher:unsubscribe";
+        QJsonObject data;
+        data["channel"] = m_subscribedChannel;
+        unsubscribeMsg["data"] = data;
+        m_transport->sendText(QJsonDocument(unsubscribeMsg).toJson(QJsonDocument::Compact));
+    }
+    
+    QJsonObject subscribeMsg;
+    subscribeMsg["event"] = "pusher:subscribe";
+    
+    QJsonObject data;
+    data["channel"] = channel;
+    subscribeMsg["data"] = data;
+    
+    QByteArray message = QJsonDocument(subscribeMsg).toJson(QJsonDocument::Compact);
+    qCDebug(lcKickChat) << "Sending subscription message:" << message;
+    
+    m_transport->sendText(message);
+    m_subscribedChannel = channel;
+}
+
+QString KickChatClient::subscriptionChannel() const
+{
+    if (m_chatroomId > 0) {
+        return QString("chatrooms.%1.v2").arg(m_chatroomId);
+    }
+    
+    // Without a chatroom ID the name-based channel is the best there is
+    if (m_chatroomLookupFailed) {
+        return QString("channel-%1").arg(m_channelName);
+    }
+    
+    return QString();
+}
+
+void KickChatClient::onChatroomResolved(const QString& channelName, qint64 chatroomId)
+{
+    if (channelName.compare(m_channelName, Qt::CaseInsensitive) != 0 || chatroomId == m_chatroomId) {
+        return;
+    }
+    
+    qCDebug(lcKickChat) << "Chatroom for" << channelName << "is" << chatroomId;
+    m_chatroomId = chatroomId;
+    subscribe();
+}
+
+void KickChatClient::onChatroomResolveFailed(const QString& channelName, const QString& errorString)
+{
+    if (channelName.compare(m_channelName, Qt::CaseInsensitive) != 0) {
+        return;
+    }
+    
+    // A stale ID keeps serving; only a channel never resolved falls back
+    if (m_chatroomId == 0) {
+        qCDebug(lcKickChat) << "Chatroom lookup failed, subscribing by name:" << errorString;
+        m_chatroomLookupFailed = true;
+        subscribe();
+    }
+}
+
 void KickChatClient::onPingTimerTimeout()
 {
     // Send a ping to keep the connection alive
-    if (m_webSocket.state() == QAbstractSocket::ConnectedState) {
+    if (m_transport->isConnected()) {
         QJsonObject pingMsg;
         pingMsg["event"] = "pusher:ping";
         pingMsg["data"] = QJsonObject();
         
-        QString message = QJsonDocument(pingMsg).toJson(QJsonDocument::Compact);
-        qDebug() << "Sending ping";
+        QByteArray message = QJsonDocument(pingMsg).toJson(QJsonDocument::Compact);
+        qCDebug(lcKickChat) << "Sending ping";
         
-        m_webSocket.sendTextMessage(message);
+        m_transport->sendText(message);
+    }
+}
+
+void KickChatClient::fetchHistory()
+{
+    ++m_prefillGeneration;
+    m_heldMessages.clear();
+    m_historyIds.clear();
+    m_prefillCount = 0;
+    if (m_historyReply) {
+        m_historyReply->abort();
+    }
+    
+    QUrl url = m_apiBaseUrl;
+    url.setPath(url.path() + QString("/api/v2/channels/%1/messages").arg(m_channelId));
+    qCDebug(lcKickChat) << "Fetching recent history:" << url.toString();
+    
+    QNetworkRequest request(url);
+    request.setRawHeader("Accept", "application/json");
+    request.setTransferTimeout(PrefillTimeoutMs);
+    
+    m_prefillPending = true;
+    m_prefillTimer.start();
+    
+    QNetworkReply* reply = m_networkManager.get(request);
+    m_historyReply = reply;
+    int generation = m_prefillGeneration;
+    connect(reply, &QNetworkReply::finished, this, [this, reply, generation]() {
+        onHistoryReply(reply, generation);
+    });
+}
+
+void KickChatClient::onHistoryReply(QNetworkReply* reply, int generation)
+{
+    reply->deleteLater();
+    if (m_historyReply == reply) {
+        m_historyReply = nullptr;
+    }
+    if (generation != m_prefillGeneration) {
+        return;
+    }
+    
+    if (reply->error() != QNetworkReply::NoError) {
+        qCDebug(lcKickChat) << "History fetch failed:" << reply->errorString();
+        finishPrefill();
+        return;
+    }
+    
+    // Parsing and sanitizing happen on the pool; results come back in chunks
+    // so the first rows can be laid out while the rest is still being decoded
+    QByteArray body = reply->readAll();
+    QDateTime receivedAt = Clock::instance()->now();
+    QPointer<KickChatClient> guard(this);
+    
+    QThreadPool::globalInstance()->start([guard, generation, body, receivedAt]() {
+        QJsonDocument document = QJsonDocument::fromJson(body);
+        // Kick wraps the list in data.messages; a bare array is accepted too
+        QJsonArray items = document.isArray() ? document.array()
+                                              : document.object()["data"].toObject()["messages"].toArray();
+        
+        QList<ChatMessage> messages;
+        messages.reserve(items.size());
+        for (const QJsonValue& item : items) {
+            QJsonObject messageData = item.toObject();
+            if (messageData["type"].toString("message") != "message") {
+                continue;
+            }
+            QDateTime timestamp = QDateTime::fromString(messageData["created_at"].toString(), Qt::ISODate);
+            // Shown and searched at its original time, but expires as if it arrived now
+            ChatMessage message = decodeChatMessage(messageData, timestamp.isValid() ? timestamp.toLocalTime() : receivedAt);
+            message.setReceivedAt(receivedAt);
+            messages.append(message);
+        }
+        
+        // The whole history is one batch for the stateless stages; their cost
+        // is reported with the live ones
+        PreparePipeline preparePipeline;
+        preparePipeline.process(messages);
+        const QList<StageTiming> timings = preparePipeline.timings();
+        
+        // The API lists newest first
+        std::stable_sort(messages.begin(), messages.end(), [](const ChatMessage& a, const ChatMessage& b) {
+            return a.timestamp() < b.timestamp();
+        });
+        
+        int offset = 0;
+        do {
+            QList<ChatMessage> chunk = messages.mid(offset, HistoryChunkSize);
+            offset += HistoryChunkSize;
+            bool last = offset >= messages.size();
+            QList<StageTiming> chunkTimings = last ? timings : QList<StageTiming>();
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [guard, generation, chunk, last, chunkTimings]() {
+                if (guard) {
+                    guard->onHistoryChunk(generation, chunk, last, chunkTimings);
+                }
+            }, Qt::QueuedConnection);
+        } while (offset < messages.size());
+    });
+}
+
+void KickChatClient::onHistoryChunk(int generation, const QList<ChatMessage>& chunk, bool last,
+                                    const QList<StageTiming>& timings)
+{
+    m_preparePipeline.addTimings(timings);
+    
+    // Too late: live chat is already on screen and history would land after it
+    if (generation != m_prefillGeneration || !m_prefillPending) {
+        return;
+    }
+    
+    for (const ChatMessage& message : chunk) {
+        if (!message.messageId().isEmpty()) {
+            if (m_historyIds.contains(message.messageId())) {
+                continue;
+            }
+            m_historyIds.insert(message.messageId());
+        }
+        ++m_prefillCount;
+        publishPrepared(message);
+    }
+    
+    if (last) {
+        finishPrefill();
+    }
+}
+
+void KickChatClient::finishPrefill()
+{
+    if (!m_prefillPending) {
+        return;
+    }
+    m_prefillPending = false;
+    m_prefillTimer.stop();
+    
+    qCDebug(lcKickChat) << "Prefilled" << m_prefillCount << "messages," << m_heldMessages.size() << "live messages were held";
+    emit historyLoaded(m_prefillCount);
+    
+    // Live messages that overlapped the fetch follow the history once
+    const QList<ChatMessage> held = m_heldMessages;
+    m_heldMessages.clear();
+    for (const ChatMessage& message : held) {
+        deliver(message);
+    }
+}
+
+void KickChatClient::deliver(const ChatMessage& message)
+{
+    if (!m_historyIds.isEmpty() && m_historyIds.contains(message.messageId())) {
+        return;
     }
-} 
\ No newline at end of file
+    
+    if (m_prefillPending) {
+        m_heldMessages.append(message);
+        return;
+    }
+    
+    publish(message);
+}
+
+void KickChatClient::setBatchProcessor(const BatchProcessor& processor)
+{
+    flushBatch();
+    m_batchProcessor = processor;
+}
+
+void KickChatClient::publish(const ChatMessage& message)
+{
+    m_rawBatch.append(message);
+    scheduleFlush();
+}
+
+void KickChatClient::publishPrepared(const ChatMessage& message)
+{
+    // Raw messages already waiting stay ahead of it
+    prepareRawBatch();
+    m_batch.append(message);
+    scheduleFlush();
+}
+
+void KickChatClient::scheduleFlush()
+{
+    if (!m_batchProcessor || m_batch.size() + m_rawBatch.size() >= MaxBatchSize) {
+        flushBatch();
+    } else if (!m_batchScheduled) {
+        // Everything decoded before control returns to the event loop joins this batch
+        m_batchScheduled = true;
+        QMetaObject::invokeMethod(this, [this]() {
+            m_batchScheduled = false;
+            flushBatch();
+        }, Qt::QueuedConnection);
+    }
+}
+
+void KickChatClient::prepareRawBatch()
+{
+    if (m_rawBatch.isEmpty()) {
+        return;
+    }
+    m_preparePipeline.process(m_rawBatch);
+    m_batch += m_rawBatch;
+    m_rawBatch.clear();
+}
+
+QString KickChatClient::prepareTimingReport() const
+{
+    return m_preparePipeline.timingReport();
+}
+
+void KickChatClient::flushBatch()
+{
+    prepareRawBatch();
+    if (m_batch.isEmpty()) {
+        return;
+    }
+    
+    QList<ChatMessage> batch;
+    batch.swap(m_batch);
+    if (m_batchProcessor) {
+        m_batchProcessor(batch);
+    }
+    
+    for (const ChatMessage& message : batch) {
+        emit messageReceived(message);
+    }
+}
@@ -2,12 +2,20 @@
 #define KICKCHATCLIENT_H
 
 #include <QObject>
-#include <QWebSocket>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QJsonDocument>
-#include <QTimer>
+#include <QJsonObject>
+#include <QUrl>
+#include <QSet>
+#include <functional>
 #include "chatmessage.h"
+#include "chattransport.h"
+#include "clock.h"
+#include "chatroomresolver.h"
+#include "preparestages.h"
+
+class IngestHelper;
 
 class KickChatClient : public QObject {
     Q_OBJECT
@@ -19,34 +27,114 @@ public:
     void connectToChannel(const QString& channelName);
     void disconnectFromChannel();
     bool isConnected() const;
+    QString channelName() const;
+    
+    // Replaces the transport; takes effect on the next connect
+    void setTransport(ChatTransport::Kind kind);
+    // Same, with a transport built elsewhere (e.g. a test double); takes ownership
+    void setTransport(ChatTransport* transport);
+    ChatTransport* transport() const;
+    
+    // Moves connecting and decoding into a helper process (--isolate-ingest).
+    // The helper's events are re-emitted as this client's signals.
+    void setIngestHelper(IngestHelper* helper);
+    
+    // Decodes one raw Pusher frame as if it had arrived on the socket (used for replay)
+    void processFrame(const QByteArray& frame);
+    
+    // Where recent history is fetched from on connect; a local stand-in works too
+    void setApiBaseUrl(const QUrl& url);
+    QUrl apiBaseUrl() const;
+    
+    // Runs over each batch of decoded messages (everything that arrived within
+    // one event loop turn) before they are emitted; it may drop or rewrite
+    // messages. Without one, every message is emitted as soon as it is decoded.
+    // Either way messages have been through the prepare pipeline (sanitizing,
+    // emote tokenizing) first.
+    typedef std::function<void(QList<ChatMessage>&)> BatchProcessor;
+    void setBatchProcessor(const BatchProcessor& processor);
+    
+    // Processes and emits whatever is still batched (e.g. at the end of a replay)
+    void flushBatch();
+    
+    // Per-stage cost of the prepare pipeline, history included
+    QString prepareTimingReport() const;
 
 signals:
     void connected();
     void disconnected();
     void messageReceived(const ChatMessage& message);
+    void messageDeleted(const QString& messageId);
+    void userBanned(qint64 senderId, const QString& username);
     void error(const QString& errorMessage);
+    void historyLoaded(int messageCount);
 
 private slots:
     void onConnected();
     void onDisconnected();
-    void onTextMessageReceived(const QString& message);
-    void onError(QAbstractSocket::SocketError error);
+    void onFrameReceived(const QByteArray& frame);
+    void onError(const QString& errorMessage);
     void onPingTimerTimeout();
     void onReconnectTimer();
+    void onChatroomResolved(const QString& channelName, qint64 chatroomId);
+    void onChatroomResolveFailed(const QString& channelName, const QString& errorString);
 
 private:
-    QWebSocket m_webSocket;
+    ChatTransport* m_transport;
+    IngestHelper* m_ingestHelper;
     QNetworkAccessManager m_networkManager;
+    QUrl m_apiBaseUrl;
+    
+    // Chat events are keyed by chatroom ID; the lookup runs alongside the
+    // socket handshake and is cached across reconnects and restarts
+    ChatroomResolver m_chatroomResolver;
+    qint64 m_chatroomId;
+    bool m_chatroomLookupFailed;
+    QString m_subscribedChannel;
+    
+    // History prefill: live messages are held back until the history (or a
+    // timeout) arrives so the two merge in order, without duplicates
+    QNetworkReply* m_historyReply;
+    ClockTimer m_prefillTimer;
+    int m_prefillGeneration;
+    bool m_prefillPending;
+    int m_prefillCount;
+    QList<ChatMessage> m_heldMessages;
+    QSet<QString> m_historyIds;
     QString m_channelName;
     QString m_channelId;
-    QTimer m_pingTimer;
-    QTimer m_reconnectTimer;
+    ClockTimer m_pingTimer;
+    ClockTimer m_reconnectTimer;
     int m_reconnectAttempts;
     int m_maxReconnectAttempts;
     
+    // Live and helper messages wait in m_rawBatch until the prepare pipeline
+    // runs over them; history arrives prepared on the pool
+    PreparePipeline m_preparePipeline;
+    QList<ChatMessage> m_rawBatch;
+    BatchProcessor m_batchProcessor;
+    QList<ChatMessage> m_batch;
+    bool m_batchScheduled;
+    
     void connectWebSocketDirect();
+    void subscribe();
+    QString subscriptionChannel() const;
     void processMessage(const QJsonDocument& jsonDoc);
     void startReconnectTimer();
+    
+    void fetchHistory();
+    void onHistoryReply(QNetworkReply* reply, int generation);
+    void onHistoryChunk(int generation, const QList<ChatMessage>& chunk, bool last,
+                        const QList<StageTiming>& timings);
+    void finishPrefill();
+    void deliver(const ChatMessage& message);
+    void publish(const ChatMessage& message);
+    void publishPrepared(const ChatMessage& message);
+    void scheduleFlush();
+    void prepareRawBatch();
+    
+    // Thread-safe; used for live events and for history parsed on the pool
+    static ChatMessage decodeChatMessage(const QJsonObject& messageData, const QDateTime& timestamp);
 };
 
 #endif // KICKCHATCLIENT_H 
\ No newline at end of file
@@ -1,14 +1,51 @@
-#include "chatoverlay.h"
+#include "kickchatclient.h"
+#include "headlessrunner.h"
+#include "ingestworker.h"
+#include "ingesthelper.h"
+#include "chatfanoutserver.h"
+#include "startupmetrics.h"
+#include "chatstatistics.h"
+#include "virtualclock.h"
+#include "messagepipeline.h"
+#include "ingeststages.h"
+#ifndef KICKCHAT_NO_GUI
+#include "overlayrunner.h"
 #include <QApplication>
+#endif
+#include <QCoreApplication>
 #include <QCommandLineParser>
 #include <QCommandLineOption>
+#include <QSettings>
+#include <QSaveFile>
+#include <QDebug>
+#include <cstdio>
+#include <cstring>
+#include <memory>
 
 int main(int argc, char *argv[])
 {
+    StartupMetrics::start();
+    
+#ifdef KICKCHAT_NO_GUI
+    // kickchat-headless links only kickchat_core
+    const bool headless = true;
+    std::unique_ptr<QCoreApplication> app(new QCoreApplication(argc, argv));
+#else
+    // Headless mode must not create a QApplication (no display needed), so look
+    // for the flag before the parser is available
+    bool headless = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0 || std::strcmp(argv[i], "--ingest-worker") == 0) {
+            headless = true;
+        }
+    }
+    
     // Create application
-    QApplication app(argc, argv);
-    app.setApplicationName("KickChatOverlay");
-    app.setApplicationVersion("1.0.0");
+    std::unique_ptr<QCoreApplication> app(headless ? new QCoreApplication(argc, argv)
+                                                   : new QApplication(argc, argv));
+#endif
+    app->setApplicationName("KickChatOverlay");
+    app->setApplicationVersion("1.0.0");
     
     // Parse command line arguments
     QCommandLineParser parser;
@@ -22,17 +59,225 @@ int main(int argc, char *argv[])
                                     "name");
     parser.addOption(channelOption);
     
-    parser.process(app);
+    // Headless streaming options
+    QCommandLineOption headlessOption("headless",
+                                     "Run without a window and write each message to stdout as NDJSON");
+    QCommandLineOption backpressureOption("backpressure",
+                                         "When stdout falls behind: block (default) or drop",
+                                         "policy", "block");
+    QCommandLineOption replayOption("replay",
+                                   "Decode raw Pusher frames from <file> (one per line) instead of connecting",
+                                   "file");
+    QCommandLineOption replayRepeatOption("replay-repeat",
+                                         "Replay the file <n> times",
+                                         "n", "1");
+    parser.addOption(headlessOption);
+    parser.addOption(backpressureOption);
+    parser.addOption(replayOption);
+    parser.addOption(replayRepeatOption);
+    
+    // Simulated time: replay and soak runs go as fast as the CPU allows and
+    // produce the same output every time
+    QCommandLineOption simulatedClockOption("simulated-clock",
+                                           "With --replay, run on simulated time starting at <ms> since the epoch",
+                                           "ms");
+    QCommandLineOption replayIntervalOption("replay-interval",
+                                           "Simulated milliseconds between replayed frames",
+                                           "ms", "100");
+    parser.addOption(simulatedClockOption);
+    parser.addOption(replayIntervalOption);
+    
+    // Local rebroadcast so other tools share this connection
+    QCommandLineOption serveWsOption("serve-ws",
+                                    "Rebroadcast decoded chat on ws://127.0.0.1:<port>",
+                                    "port");
+    QCommandLineOption serveSocketOption("serve-socket",
+                                        "Rebroadcast decoded chat as NDJSON on local socket <name>",
+                                        "name");
+    parser.addOption(serveWsOption);
+    parser.addOption(serveSocketOption);
+    
+#ifndef KICKCHAT_NO_GUI
+    QCommandLineOption windowsOption("windows",
+                                    "Open <n> overlay windows sharing one connection",
+                                    "n");
+    parser.addOption(windowsOption);
+    
+    QCommandLineOption memoryBudgetOption("memory-budget",
+                                         "Keep resident memory under <mb> megabytes",
+                                         "mb");
+    parser.addOption(memoryBudgetOption);
+#endif
+    
+    QCommandLineOption transportOption("transport",
+                                      "WebSocket implementation: qt (default) or deflate (compressed, needs zlib)",
+                                      "kind");
+    parser.addOption(transportOption);
+    
+    QCommandLineOption apiBaseOption("api-base",
+                                    "Fetch recent chat history from <url> instead of https://kick.com",
+                                    "url");
+    parser.addOption(apiBaseOption);
     
-    // Create and show chat overlay
-    ChatOverlay overlay;
-    overlay.show();
+    QCommandLineOption statsFileOption("stats-file",
+                                      "Write live chat statistics as JSON to <file> every 5 seconds",
+                                      "file");
+    parser.addOption(statsFileOption);
+    
+    QCommandLineOption pipelineTimingOption("pipeline-timing",
+                                           "Print the cost of each ingest stage on exit");
+    parser.addOption(pipelineTimingOption);
+    
+    // Crash isolation: the GUI re-runs itself with --ingest-worker
+#ifndef KICKCHAT_NO_GUI
+    QCommandLineOption isolateIngestOption("isolate-ingest",
+                                          "Connect and decode in a helper process that is restarted if it crashes");
+    parser.addOption(isolateIngestOption);
+#endif
+    QCommandLineOption ingestWorkerOption("ingest-worker", "Internal: run as the ingest helper");
+    QCommandLineOption shmKeyOption("shm-key", "Internal: shared memory key of the ingest ring", "key");
+    ingestWorkerOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    shmKeyOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOption(ingestWorkerOption);
+    parser.addOption(shmKeyOption);
+    
+    parser.process(*app);
+    
+    // Timers bind to the clock at construction, so install it before anything else
+    std::unique_ptr<VirtualClock> virtualClock;
+    if (parser.isSet(simulatedClockOption)) {
+        if (!headless || !parser.isSet(replayOption)) {
+            qCritical("--simulated-clock needs --headless and --replay");
+            return 1;
+        }
+        virtualClock.reset(new VirtualClock(parser.value(simulatedClockOption).toLongLong()));
+        Clock::setInstance(virtualClock.get());
+    }
+    
+    // Start the socket handshake before building any widgets. runOverlays()
+    // builds the windows from the event loop, one per turn, so DNS, TCP and TLS
+    // setup overlap with overlay construction instead of following it.
+    KickChatClient chatClient;
+    if (parser.isSet(transportOption)) {
+        ChatTransport::Kind kind;
+        if (!ChatTransport::kindFromName(parser.value(transportOption), &kind)) {
+            qCritical("--transport must be deflate or qt");
+            return 1;
+        }
+        chatClient.setTransport(kind);
+    }
+    
+    // The overlay starts with recent history instead of waiting for someone to type
+    QString apiBase = parser.isSet(apiBaseOption)
+        ? parser.value(apiBaseOption)
+        : QSettings("KickChatOverlay", "Settings").value("apiBaseUrl").toString();
+    if (!apiBase.isEmpty()) {
+        chatClient.setApiBaseUrl(QUrl(apiBase));
+    }
     
-    // Auto-connect to channel if specified
+    if (parser.isSet(ingestWorkerOption)) {
+        return runIngestWorker(chatClient, parser.value(shmKeyOption), parser.value(channelOption));
+    }
+    
+#ifndef KICKCHAT_NO_GUI
+    IngestHelper* ingestHelper = nullptr;
+    if (parser.isSet(isolateIngestOption) && !headless) {
+        ingestHelper = new IngestHelper(&chatClient);
+        if (ingestHelper->isValid()) {
+            QStringList forwarded;
+            if (parser.isSet(transportOption)) {
+                forwarded << "--transport" << parser.value(transportOption);
+            }
+            if (parser.isSet(apiBaseOption)) {
+                forwarded << "--api-base" << parser.value(apiBaseOption);
+            }
+            ingestHelper->setForwardedArguments(forwarded);
+            chatClient.setIngestHelper(ingestHelper);
+        } else {
+            qWarning("Falling back to in-process ingest");
+            delete ingestHelper;
+        }
+    }
+#endif
+    
+    // One upstream connection and one decode serve every local consumer
+    ChatFanoutServer fanoutServer;
+    if (parser.isSet(serveWsOption)) {
+        fanoutServer.listenWebSocket(static_cast<quint16>(parser.value(serveWsOption).toUInt()));
+    }
+    if (parser.isSet(serveSocketOption)) {
+        fanoutServer.listenLocal(parser.value(serveSocketOption));
+    }
+    bool serving = parser.isSet(serveWsOption) || parser.isSet(serveSocketOption);
+    
+    // --headless writes NDJSON to stdout as an ingest stage
+    std::unique_ptr<NdjsonWriter> recorder;
+    if (headless) {
+        recorder.reset(new NdjsonWriter(fileno(stdout), parser.value(backpressureOption) == "drop" ? NdjsonWriter::Drop
+                                                                                                  : NdjsonWriter::Block));
+    }
+    
+    // Work done once per decoded message, whatever the mode, runs as one batch
+    // pipeline before the client emits (after the client's own sanitize and
+    // emote stages); statistics are kept even when no window shows them
+    ChatStatistics statistics;
+    MessagePipeline<FanoutStage, StatisticsStage, RecordStage> ingestPipeline(FanoutStage(serving ? &fanoutServer : nullptr),
+                                                                              StatisticsStage(&statistics),
+                                                                              RecordStage(recorder.get()));
+    chatClient.setBatchProcessor([&ingestPipeline](QList<ChatMessage>& batch) {
+        ingestPipeline.process(batch);
+    });
+    if (parser.isSet(pipelineTimingOption)) {
+        QObject::connect(app.get(), &QCoreApplication::aboutToQuit, &chatClient, [&chatClient, &ingestPipeline]() {
+            qInfo().noquote() << (chatClient.prepareTimingReport() + ingestPipeline.timingReport()).trimmed();
+        });
+    }
+    
+    ClockTimer statsTimer;
+    if (parser.isSet(statsFileOption)) {
+        QString statsPath = parser.value(statsFileOption);
+        QObject::connect(&statsTimer, &ClockTimer::timeout, &statsTimer, [&statistics, statsPath]() {
+            // Replace atomically so readers never see a half-written file
+            QSaveFile file(statsPath);
+            if (file.open(QIODevice::WriteOnly)) {
+                file.write(statistics.toJson(Clock::instance()->nowMs()));
+                file.commit();
+            }
+        });
+        statsTimer.start(5000);
+    }
+    
+    if (headless) {
+        HeadlessOptions options;
+        options.channelName = parser.value(channelOption);
+        options.replayFile = parser.value(replayOption);
+        options.replayRepeat = qMax(1, parser.value(replayRepeatOption).toInt());
+        options.writer = recorder.get();
+        options.clock = virtualClock.get();
+        options.replayIntervalMs = qMax(0, parser.value(replayIntervalOption).toInt());
+        
+        if (options.channelName.isEmpty() && options.replayFile.isEmpty()) {
+            qCritical("--headless needs --channel or --replay");
+            return 1;
+        }
+        
+        return runHeadless(chatClient, options);
+    }
+    
+#ifdef KICKCHAT_NO_GUI
+    return 0;
+#else
     if (parser.isSet(channelOption)) {
-        QString channelName = parser.value(channelOption);
-        overlay.connectToChannel(channelName);
+        chatClient.connectToChannel(parser.value(channelOption));
     }
     
-    return app.exec();
-} 
\ No newline at end of file
+    OverlayOptions overlayOptions;
+    if (parser.isSet(windowsOption)) {
+        overlayOptions.windowCount = parser.value(windowsOption).toInt();
+    }
+    if (parser.isSet(memoryBudgetOption)) {
+        overlayOptions.memoryBudgetMb = parser.value(memoryBudgetOption).toInt();
+    }
+    return runOverlays(chatClient, statistics, overlayOptions);
+#endif
+}
@@ -0,0 +1,173 @@
+#include "memorybudget.h"
+#include <QFile>
+#include <QDebug>
+#include <algorithm>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_MACOS)
+#include <mach/mach.h>
+#elif defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+Q_LOGGING_CATEGORY(lcMemory, "kickchat.memory")
+
+namespace {
+// Never hand accounted subsystems less than this, whatever the baseline
+const qint64 MinimumAccountedBytes = 8 * 1024 * 1024;
+
+QString formatBytes(qint64 bytes)
+{
+    return QString("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
+}
+
+MemoryBudget::MemoryBudget(qint64 ceilingBytes, QObject* parent)
+    : QObject(parent)
+    , m_ceiling(ceilingBytes)
+    , m_baseline(residentBytes())
+{
+    connect(&m_enforceTimer, &QTimer::timeout, this, &MemoryBudget::enforce);
+    m_enforceTimer.start(2000);
+}
+
+void MemoryBudget::setCeiling(qint64 bytes)
+{
+    m_ceiling = bytes;
+    enforce();
+}
+
+qint64 MemoryBudget::ceiling() const
+{
+    return m_ceiling;
+}
+
+qint64 MemoryBudget::baselineBytes() const
+{
+    return m_baseline;
+}
+
+qint64 MemoryBudget::accountedLimit() const
+{
+    return qMax(MinimumAccountedBytes, m_ceiling - m_baseline);
+}
+
+void MemoryBudget::registerConsumer(QObject* owner, const QString& name, Priority priority,
+                                    UsageFunction usage, ReleaseFunction release)
+{
+    m_consumers.append(Consumer{owner, name, priority, usage, release});
+
+    connect(owner, &QObject::destroyed, this, [this](QObject* destroyed) {
+        m_consumers.erase(std::remove_if(m_consumers.begin(), m_consumers.end(),
+                                         [destroyed](const Consumer& consumer) { return consumer.owner == destroyed; }),
+                          m_consumers.end());
+    });
+}
+
+qint64 MemoryBudget::accountedBytes() const
+{
+    qint64 total = 0;
+    for (const Consumer& consumer : m_consumers) {
+        total += consumer.usage();
+    }
+    return total;
+}
+
+QList<MemoryBudget::Entry> MemoryBudget::breakdown() const
+{
+    QList<Entry> entries;
+
+    for (const Consumer& consumer : m_consumers) {
+        qint64 bytes = consumer.usage();
+        auto it = std::find_if(entries.begin(), entries.end(),
+                               [&consumer](const Entry& entry) { return entry.name == consumer.name; });
+        if (it != entries.end()) {
+            it->bytes += bytes;
+        } else {
+            entries.append(Entry{consumer.name, consumer.priority, bytes});
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.priority > b.priority;
+    });
+    return entries;
+}
+
+QString MemoryBudget::report() const
+{
+    QString text;
+    qint64 total = 0;
+
+    for (const Entry& entry : breakdown()) {
+        text += QString("%1: %2\n").arg(entry.name, formatBytes(entry.bytes));
+        total += entry.bytes;
+    }
+
+    text += QString("\nAccounted: %1 of %2\n").arg(formatBytes(total), formatBytes(accountedLimit()));
+    text += QString("Resident: %1 (baseline %2, ceiling %3)")
+        .arg(formatBytes(residentBytes()), formatBytes(m_baseline), formatBytes(m_ceiling));
+    return text;
+}
+
+void MemoryBudget::enforce()
+{
+    qint64 excess = accountedBytes() - accountedLimit();
+    if (excess <= 0) {
+        if (excess < 0) {
+            emit underBudget(-excess);
+        }
+        return;
+    }
+
+    // Cheapest losses first; a stable sort keeps registration order within a priority
+    QList<Consumer> order = m_consumers;
+    std::stable_sort(order.begin(), order.end(), [](const Consumer& a, const Consumer& b) {
+        return a.priority < b.priority;
+    });
+
+    qint64 released = 0;
+    for (const Consumer& consumer : order) {
+        if (released >= excess) {
+            break;
+        }
+        if (consumer.release) {
+            released += consumer.release(excess - released);
+        }
+    }
+
+    qCDebug(lcMemory) << "Memory budget exceeded by" << excess << "bytes, released" << released;
+    emit evicted(released);
+}
+
+qint64 MemoryBudget::residentBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.WorkingSetSize);
+    }
+    return 0;
+#elif defined(Q_OS_MACOS)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS) {
+        return static_cast<qint64>(info.resident_size);
+    }
+    return 0;
+#elif defined(Q_OS_UNIX)
+    // Second field of statm is the resident set in pages
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+    return 0;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,86 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QTimer>
+#include <QLoggingCategory>
+#include <functional>
+
+// Evictions and regrowth, from the budget and the subsystems it shrinks
+Q_DECLARE_LOGGING_CATEGORY(lcMemory)
+
+// One process-wide memory budget shared by every subsystem that holds chat
+// data: the message store, the search index, text layouts, widget pools and
+// image caches. Each subsystem reports its own byte estimate; when the total
+// passes the budget, subsystems are asked to release memory in order of how
+// cheap the loss is (pools and caches first, history last).
+//
+// The budget is an RSS ceiling: the process's resident size when the budget
+// is created (Qt, fonts, platform plugins) is treated as fixed overhead and
+// only the remainder is handed out to accounted subsystems.
+class MemoryBudget : public QObject {
+    Q_OBJECT
+
+public:
+    // Lower priorities are evicted first
+    enum Priority {
+        WidgetPool = 0,
+        ImageCache = 1,
+        TextLayout = 2,
+        SearchIndex = 3,
+        MessageStore = 4
+    };
+
+    typedef std::function<qint64()> UsageFunction;
+    typedef std::function<qint64(qint64 bytes)> ReleaseFunction;
+
+    struct Entry {
+        QString name;
+        Priority priority;
+        qint64 bytes;
+    };
+
+    explicit MemoryBudget(qint64 ceilingBytes, QObject* parent = nullptr);
+
+    void setCeiling(qint64 bytes);
+    qint64 ceiling() const;
+    qint64 baselineBytes() const;
+    qint64 accountedLimit() const;
+
+    // Consumers with the same name are reported together (e.g. one widget pool
+    // per window). The registration ends when owner is destroyed.
+    void registerConsumer(QObject* owner, const QString& name, Priority priority,
+                          UsageFunction usage, ReleaseFunction release = ReleaseFunction());
+
+    qint64 accountedBytes() const;
+    QList<Entry> breakdown() const;
+    QString report() const;
+
+    static qint64 residentBytes();
+
+public slots:
+    void enforce();
+
+signals:
+    void evicted(qint64 bytes);
+    // Accounted usage is headroomBytes under the limit; caches shrunk earlier may grow back
+    void underBudget(qint64 headroomBytes);
+
+private:
+    struct Consumer {
+        QObject* owner;
+        QString name;
+        Priority priority;
+        UsageFunction usage;
+        ReleaseFunction release;
+    };
+
+    QList<Consumer> m_consumers;
+    qint64 m_ceiling;
+    qint64 m_baseline;
+    QTimer m_enforceTimer;
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,126 @@
+#ifndef MESSAGEPIPELINE_H
+#define MESSAGEPIPELINE_H
+
+#include <QList>
+#include <QString>
+#include <QElapsedTimer>
+#include <tuple>
+#include <utility>
+#include "chatmessage.h"
+
+// Batch processing on the ingest path, composed at compile time. Each stage is
+// a plain class with
+//
+//   static const char* name();
+//   void process(QList<ChatMessage>& batch);
+//
+// and may rewrite, drop or just observe messages. MessagePipeline<A, B, C>
+// runs the stages in that order over each batch; stage calls are resolved
+// statically, so there is no virtual dispatch per message or per stage.
+// Stages take their configuration in their constructors, at startup.
+//
+// Every stage's cost is timed on its own (once per batch, not per message) so
+// a slow stage shows up without a profiler.
+struct StageTiming {
+    const char* name;
+    qint64 batches;
+    qint64 messagesIn;
+    qint64 messagesOut;
+    qint64 nsecs;
+};
+
+template <typename... Stages>
+class MessagePipeline {
+    static_assert(sizeof...(Stages) > 0, "A pipeline needs at least one stage");
+
+public:
+    static constexpr int StageCount = sizeof...(Stages);
+
+    explicit MessagePipeline(Stages... stages)
+        : m_stages(std::move(stages)...)
+        , m_timings{{Stages::name(), 0, 0, 0, 0}...}
+    {
+    }
+
+    // For stages that take no configuration
+    MessagePipeline()
+        : MessagePipeline(Stages()...)
+    {
+    }
+
+    void process(QList<ChatMessage>& batch)
+    {
+        run<0>(batch);
+    }
+
+    template <int Index>
+    auto& stage()
+    {
+        return std::get<Index>(m_stages);
+    }
+
+    QList<StageTiming> timings() const
+    {
+        QList<StageTiming> result;
+        for (const StageTiming& timing : m_timings) {
+            result.append(timing);
+        }
+        return result;
+    }
+
+    // Folds in what another instance of the same pipeline measured, e.g. one
+    // that ran on a pool thread
+    void addTimings(const QList<StageTiming>& timings)
+    {
+        for (int i = 0; i < qMin(StageCount, int(timings.size())); ++i) {
+            m_timings[i].batches += timings.at(i).batches;
+            m_timings[i].messagesIn += timings.at(i).messagesIn;
+            m_timings[i].messagesOut += timings.at(i).messagesOut;
+            m_timings[i].nsecs += timings.at(i).nsecs;
+        }
+    }
+
+    QString timingReport() const
+    {
+        QString report;
+        for (const StageTiming& timing : m_timings) {
+            report += QString("%1: %2 messages in %3 batches, %4 dropped, %5 us total, %6 ns/message\n")
+                .arg(timing.name)
+                .arg(timing.messagesIn)
+                .arg(timing.batches)
+                .arg(timing.messagesIn - timing.messagesOut)
+                .arg(timing.nsecs / 1000)
+                .arg(timing.messagesIn > 0 ? timing.nsecs / timing.messagesIn : 0);
+        }
+        return report;
+    }
+
+private:
+    std::tuple<Stages...> m_stages;
+    StageTiming m_timings[StageCount];
+
+    template <int Index>
+    void run(QList<ChatMessage>& batch)
+    {
+        if constexpr (Index < StageCount) {
+            // A stage that dropped everything ends the batch
+            if (batch.isEmpty()) {
+                return;
+            }
+
+            StageTiming& timing = m_timings[Index];
+            timing.messagesIn += batch.size();
+
+            QElapsedTimer timer;
+            timer.start();
+            std::get<Index>(m_stages).process(batch);
+            timing.nsecs += timer.nsecsElapsed();
+
+            ++timing.batches;
+            timing.messagesOut += batch.size();
+            run<Index + 1>(batch);
+        }
+    }
+};
+
+#endif // MESSAGEPIPELINE_H
@@ -0,0 +1,161 @@
+#include "ndjsonwriter.h"
+#include "chatjson.h"
+#include <QMutexLocker>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+NdjsonWriter::NdjsonWriter(int fd, BackpressurePolicy policy, int bufferSize, int maxPendingBuffers)
+    : m_policy(policy)
+    , m_bufferSize(qMax(4096, bufferSize))
+    , m_maxPendingBuffers(qMax(1, maxPendingBuffers))
+    , m_written(0)
+    , m_dropped(0)
+    , m_thread(nullptr)
+    , m_closing(false)
+{
+#ifdef Q_OS_WIN
+    // NDJSON must not get CRLF translation
+    _setmode(fd, _O_BINARY);
+#endif
+
+    if (!m_file.open(fd, QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        qWarning() << "Cannot open output for NDJSON:" << m_file.errorString();
+        return;
+    }
+
+    // Some headroom so the message that crosses the threshold never reallocates
+    m_current.reserve(m_bufferSize + 4096);
+
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName("NdjsonWriter");
+    m_thread->start();
+}
+
+NdjsonWriter::~NdjsonWriter()
+{
+    close();
+}
+
+bool NdjsonWriter::isOpen() const
+{
+    return m_thread != nullptr;
+}
+
+void NdjsonWriter::write(const ChatMessage& message)
+{
+    if (!m_thread) {
+        return;
+    }
+
+    // A full buffer that could not be handed off means the consumer is behind
+    if (m_current.size() >= m_bufferSize && !submitCurrent()) {
+        ++m_dropped;
+        return;
+    }
+
+    ChatJson::appendMessage(m_current, message);
+    m_current.append('\n');
+    ++m_written;
+
+    if (m_current.size() >= m_bufferSize) {
+        submitCurrent();
+    }
+}
+
+void NdjsonWriter::flush()
+{
+    if (m_thread && !m_current.isEmpty()) {
+        submitCurrent();
+    }
+}
+
+void NdjsonWriter::close()
+{
+    if (!m_thread) {
+        return;
+    }
+
+    // Whatever the policy, the tail is always written on close
+    BackpressurePolicy policy = m_policy;
+    m_policy = Block;
+    flush();
+    m_policy = policy;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_closing = true;
+        m_pendingChanged.wakeAll();
+    }
+
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+    m_file.close();
+}
+
+quint64 NdjsonWriter::writtenCount() const
+{
+    return m_written;
+}
+
+quint64 NdjsonWriter::droppedCount() const
+{
+    return m_dropped;
+}
+
+bool NdjsonWriter::submitCurrent()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (m_pending.size() >= m_maxPendingBuffers) {
+        if (m_policy == Drop) {
+            return false;
+        }
+        m_pendingChanged.wait(&m_mutex);
+    }
+
+    m_pending.enqueue(std::move(m_current));
+
+    // Recycle a buffer the writer already drained, keeping its allocation
+    if (!m_freeBuffers.isEmpty()) {
+        m_current = m_freeBuffers.takeLast();
+    } else {
+        m_current = QByteArray();
+        m_current.reserve(m_bufferSize + 4096);
+    }
+
+    m_pendingChanged.wakeAll();
+    return true;
+}
+
+void NdjsonWriter::run()
+{
+    for (;;) {
+        QByteArray buffer;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_pending.isEmpty() && !m_closing) {
+                m_pendingChanged.wait(&m_mutex);
+            }
+            if (m_pending.isEmpty()) {
+                return; // Closing and fully drained
+            }
+            buffer = m_pending.dequeue();
+        }
+
+        // Blocks while the consumer is slow; the producer keeps filling other buffers
+        if (m_file.write(buffer) != buffer.size()) {
+            qWarning() << "NDJSON output failed:" << m_file.errorString();
+        }
+
+        buffer.resize(0); // Keeps the capacity for reuse
+
+        QMutexLocker locker(&m_mutex);
+        m_freeBuffers.append(std::move(buffer));
+        m_pendingChanged.wakeAll();
+    }
+}
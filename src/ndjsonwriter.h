@@ -0,0 +1,63 @@
+#ifndef NDJSONWRITER_H
+#define NDJSONWRITER_H
+
+#include <QFile>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QList>
+#include <QByteArray>
+#include "chatmessage.h"
+
+// Streams chat messages as newline-delimited JSON to a file descriptor.
+// Messages are encoded into large preallocated buffers; full buffers are
+// handed to a writer thread, so the caller never waits on a per-message
+// write or flush. When the consumer falls behind and every buffer is in
+// flight, Block waits for the consumer and Drop discards (and counts) messages.
+class NdjsonWriter {
+public:
+    enum BackpressurePolicy {
+        Block,
+        Drop
+    };
+
+    NdjsonWriter(int fd, BackpressurePolicy policy,
+                 int bufferSize = 256 * 1024, int maxPendingBuffers = 16);
+    ~NdjsonWriter();
+
+    bool isOpen() const;
+
+    void write(const ChatMessage& message);
+
+    // Hands the partially filled buffer to the writer thread (bounds latency on quiet chat)
+    void flush();
+
+    // Flushes and waits until everything has been written
+    void close();
+
+    quint64 writtenCount() const;
+    quint64 droppedCount() const;
+
+private:
+    QFile m_file;
+    BackpressurePolicy m_policy;
+    int m_bufferSize;
+    int m_maxPendingBuffers;
+
+    QByteArray m_current;
+    quint64 m_written;
+    quint64 m_dropped;
+
+    QThread* m_thread;
+    QMutex m_mutex;
+    QWaitCondition m_pendingChanged;
+    QQueue<QByteArray> m_pending;
+    QList<QByteArray> m_freeBuffers;
+    bool m_closing;
+
+    bool submitCurrent();
+    void run();
+};
+
+#endif // NDJSONWRITER_H
@@ -0,0 +1,125 @@
+#include "overlayrunner.h"
+#include "chatoverlay.h"
+#include "chatmessagestore.h"
+#include "memorybudget.h"
+#include "glyphusage.h"
+#include "startupmetrics.h"
+#include <QApplication>
+#include <QSettings>
+#include <QPointer>
+#include <QTimer>
+#include <QMap>
+#include <QVariant>
+#include <algorithm>
+#include <functional>
+
+namespace {
+// Windows opened at startup, however many were open last time
+const int MaxRestoredWindows = 8;
+}
+
+int runOverlays(KickChatClient& client, ChatStatistics& statistics, const OverlayOptions& options)
+{
+    // One ceiling covers the store, the index and every window's widgets
+    QSettings settings("KickChatOverlay", "Settings");
+    int budgetMb = options.memoryBudgetMb > 0 ? options.memoryBudgetMb
+                                              : settings.value("memoryBudgetMB", 256).toInt();
+    MemoryBudget memoryBudget(qMax(32, budgetMb) * qint64(1024 * 1024));
+    
+    // Every window reads the same store, so N windows still mean one decode
+    // and one copy of the history
+    ChatMessageStore store(&client, &memoryBudget);
+    store.setStatistics(&statistics);
+    
+    // Scripts seen this session decide which glyphs the next session warms up
+    GlyphUsage glyphUsage;
+    QObject::connect(&client, &KickChatClient::messageReceived, &store, [&glyphUsage](const ChatMessage& message) {
+        glyphUsage.observe(message.username());
+        glyphUsage.observe(message.message());
+    });
+    // Keyed by window index, which picks the window's settings group. A new
+    // window takes the lowest free index, so closing and reopening windows
+    // reuses their saved appearance instead of counting up forever.
+    QMap<int, QPointer<ChatOverlay>> overlays;
+    bool quitting = false;
+    
+    std::function<void(int)> openOverlay = [&](int index) {
+        ChatOverlay* overlay = new ChatOverlay(&store, index);
+        overlay->setAttribute(Qt::WA_DeleteOnClose);
+        QObject::connect(overlay, &ChatOverlay::newWindowRequested, overlay, [&]() {
+            int freeIndex = 0;
+            while (overlays.contains(freeIndex)) {
+                ++freeIndex;
+            }
+            openOverlay(freeIndex);
+        });
+        // Closing the last window quits; it stays in the set so the next start reopens it
+        QObject::connect(overlay, &QObject::destroyed, [&overlays, &quitting, index]() {
+            if (!quitting && overlays.size() > 1) {
+                overlays.remove(index);
+            }
+        });
+        overlays.insert(index, overlay);
+        overlay->show();
+    };
+    
+    QList<int> indices;
+    if (options.windowCount > 0) {
+        for (int i = 0; i < qMin(options.windowCount, MaxRestoredWindows); ++i) {
+            indices.append(i);
+        }
+    } else if (settings.contains("openWindows")) {
+        for (const QVariant& value : settings.value("openWindows").toList()) {
+            bool ok = false;
+            int index = value.toInt(&ok);
+            if (ok && index >= 0 && !indices.contains(index) && indices.size() < MaxRestoredWindows) {
+                indices.append(index);
+            }
+        }
+    } else {
+        // Older versions saved only how many windows were open
+        int windowCount = qBound(1, settings.value("overlayWindows", 1).toInt(), MaxRestoredWindows);
+        for (int i = 0; i < windowCount; ++i) {
+            indices.append(i);
+        }
+    }
+    if (indices.isEmpty()) {
+        indices.append(0);
+    }
+    std::sort(indices.begin(), indices.end());
+    
+    // Windows are built from the event loop, one per turn, so the connection
+    // main() started keeps making progress (TCP, TLS, subscribe) in between
+    std::function<void()> openNext = [&]() {
+        if (quitting || indices.isEmpty()) {
+            return;
+        }
+        openOverlay(indices.takeFirst());
+        if (indices.isEmpty()) {
+            StartupMetrics::mark("overlay shown");
+        } else {
+            QTimer::singleShot(0, qApp, openNext);
+        }
+    };
+    QTimer::singleShot(0, qApp, openNext);
+    
+    // Remember which windows were still open, and tear them down before the store
+    QObject::connect(qApp, &QCoreApplication::aboutToQuit, [&]() {
+        quitting = true;
+        
+        QVariantList openWindows;
+        for (auto it = overlays.cbegin(); it != overlays.cend(); ++it) {
+            openWindows.append(it.key());
+        }
+        QSettings settings("KickChatOverlay", "Settings");
+        settings.setValue("openWindows", openWindows);
+        settings.remove("overlayWindows");
+        glyphUsage.save();
+        
+        for (const QPointer<ChatOverlay>& overlay : overlays) {
+            delete overlay.data();
+        }
+    });
+    
+    return QApplication::exec();
+}
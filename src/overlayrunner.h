@@ -0,0 +1,23 @@
+#ifndef OVERLAYRUNNER_H
+#define OVERLAYRUNNER_H
+
+#include "kickchatclient.h"
+#include "chatstatistics.h"
+
+// The GUI layer on top of kickchat_core: memory budget, shared store and the
+// overlay windows. Everything it needs from the command line is in here.
+struct OverlayOptions {
+    int windowCount;        // 0 restores the windows that were open on last exit
+    int memoryBudgetMb;     // 0 uses the memoryBudgetMB setting
+
+    OverlayOptions()
+        : windowCount(0)
+        , memoryBudgetMb(0)
+    {
+    }
+};
+
+// Runs the event loop until the last window closes
+int runOverlays(KickChatClient& client, ChatStatistics& statistics, const OverlayOptions& options);
+
+#endif // OVERLAYRUNNER_H
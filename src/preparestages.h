@@ -0,0 +1,73 @@
+#ifndef PREPARESTAGES_H
+#define PREPARESTAGES_H
+
+#include <QList>
+#include <QStringList>
+#include "chatmessage.h"
+#include "messagepipeline.h"
+#include "textsanitizer.h"
+
+// The first MessagePipeline stages every decoded message goes through, run by
+// KickChatClient before its batch processor. They keep no state, so history
+// can run them on a pool thread.
+
+// Cleans usernames and text before anything else sees them: no consumer ever
+// gets zalgo, bidi tricks or giant messages. Stateless.
+class SanitizeStage {
+public:
+    static const char* name() { return "sanitize"; }
+
+    void process(QList<ChatMessage>& batch)
+    {
+        for (ChatMessage& message : batch) {
+            // The clean case hands back the same string; only rewrite (and
+            // detach) when something changed
+            const QString username = message.username();
+            const QString cleanUsername = TextSanitizer::sanitize(username, 64);
+            if (cleanUsername.constData() != username.constData()) {
+                message.setUsername(cleanUsername);
+            }
+            const QString text = message.message();
+            const QString cleanText = TextSanitizer::sanitize(text);
+            if (cleanText.constData() != text.constData()) {
+                message.setMessage(cleanText);
+            }
+        }
+    }
+};
+
+// Pulls the names out of Kick's inline [emote:<id>:<name>] tokens once, for
+// statistics and anything else that counts emotes. Stateless.
+class EmoteStage {
+public:
+    static const char* name() { return "emotes"; }
+
+    void process(QList<ChatMessage>& batch)
+    {
+        for (ChatMessage& message : batch) {
+            const QString text = message.message();
+            QStringList emotes;
+            int pos = 0;
+            while ((pos = text.indexOf(QLatin1String("[emote:"), pos)) >= 0) {
+                int nameStart = text.indexOf(':', pos + 7);
+                int end = text.indexOf(']', pos + 7);
+                if (nameStart < 0 || end < 0 || nameStart > end) {
+                    break;
+                }
+                if (end > nameStart + 1) {
+                    emotes.append(text.mid(nameStart + 1, end - nameStart - 1));
+                }
+                pos = end + 1;
+            }
+            if (!emotes.isEmpty()) {
+                message.setEmotes(emotes);
+            }
+        }
+    }
+};
+
+// Runs on every decoded message before it is batched or emitted, in the
+// client itself; history runs its own instance on the pool as it decodes
+typedef MessagePipeline<SanitizeStage, EmoteStage> PreparePipeline;
+
+#endif // PREPARESTAGES_H
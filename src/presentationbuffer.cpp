@@ -0,0 +1,98 @@
+#include "presentationbuffer.h"
+#include <QSet>
+#include <algorithm>
+
+PresentationBuffer::PresentationBuffer()
+    : m_delay(0)
+    , m_credit(0.0)
+    , m_lastTakeMs(-1)
+{
+}
+
+void PresentationBuffer::setDelay(int ms)
+{
+    m_delay = qMax(0, ms);
+}
+
+int PresentationBuffer::delay() const
+{
+    return m_delay;
+}
+
+bool PresentationBuffer::isEnabled() const
+{
+    return m_delay > 0;
+}
+
+void PresentationBuffer::push(const ChatMessage& message, qint64 nowMs)
+{
+    m_queue.enqueue({ message, nowMs });
+}
+
+QList<ChatMessage> PresentationBuffer::takeDue(qint64 nowMs, double rateLimit)
+{
+    QList<ChatMessage> due;
+    qint64 elapsedMs = m_lastTakeMs < 0 ? 0 : qMax<qint64>(0, nowMs - m_lastTakeMs);
+    m_lastTakeMs = nowMs;
+
+    if (m_queue.isEmpty()) {
+        m_credit = 0.0;
+        return due;
+    }
+
+    // Drain the backlog over one delay, faster once the oldest row is late
+    double delayMs = qMax(1, m_delay);
+    double overshoot = qMax(1.0, latency(nowMs) / delayMs);
+    double rate = m_queue.size() / delayMs * overshoot; // Messages per ms
+    if (rateLimit > 0) {
+        rate = qMin(rate, rateLimit / 1000.0);
+    }
+
+    // Credit is capped at the backlog so an idle spell can't save up a burst
+    m_credit = qMin(m_credit + rate * elapsedMs, static_cast<double>(m_queue.size()));
+
+    qint64 deadlineMs = nowMs - static_cast<qint64>(MaxLatencyFactor) * m_delay;
+    while (!m_queue.isEmpty()) {
+        if (m_credit >= 1.0) {
+            m_credit -= 1.0;
+        } else if (m_queue.head().arrivalMs > deadlineMs) {
+            break;
+        }
+        due.append(m_queue.dequeue().message);
+    }
+
+    return due;
+}
+
+QList<ChatMessage> PresentationBuffer::takeAll()
+{
+    QList<ChatMessage> all;
+    all.reserve(m_queue.size());
+    while (!m_queue.isEmpty()) {
+        all.append(m_queue.dequeue().message);
+    }
+    m_credit = 0.0;
+    return all;
+}
+
+void PresentationBuffer::remove(const QStringList& messageIds)
+{
+    if (m_queue.isEmpty()) {
+        return;
+    }
+
+    const QSet<QString> ids(messageIds.cbegin(), messageIds.cend());
+    m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(), [&ids](const Entry& entry) {
+        return ids.contains(entry.message.messageId());
+    }), m_queue.end());
+}
+
+int PresentationBuffer::size() const
+{
+    return m_queue.size();
+}
+
+qint64 PresentationBuffer::latency(qint64 nowMs) const
+{
+    return m_queue.isEmpty() ? 0 : nowMs - m_queue.head().arrivalMs;
+}
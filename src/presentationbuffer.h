@@ -0,0 +1,57 @@
+#ifndef PRESENTATIONBUFFER_H
+#define PRESENTATIONBUFFER_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QQueue>
+#include <QStringList>
+#include "chatmessage.h"
+
+// Jitter buffer between the store and an overlay. Pusher delivers chat in
+// clumps; instead of laying out a clump in one tick and then nothing for
+// seconds, messages are held for up to delay() and released at a steady rate.
+//
+// The release rate drains the current backlog over one delay, so a burst is
+// spread evenly across the following ticks. When the oldest message has
+// waited longer than the delay the rate scales up with the overshoot to catch
+// up, and nothing ever waits longer than MaxLatencyFactor delays. The smooth
+// rate is capped by the caller's render budget; only overdue messages exceed it.
+class PresentationBuffer {
+public:
+    static const int MaxLatencyFactor = 2;
+
+    PresentationBuffer();
+
+    // 0 disables buffering
+    void setDelay(int ms);
+    int delay() const;
+    bool isEnabled() const;
+
+    void push(const ChatMessage& message, qint64 nowMs);
+
+    // Messages to present this tick, oldest first. rateLimit is in messages
+    // per second (<= 0 means unbounded).
+    QList<ChatMessage> takeDue(qint64 nowMs, double rateLimit);
+
+    // Everything still held, e.g. when the window stops rendering
+    QList<ChatMessage> takeAll();
+
+    void remove(const QStringList& messageIds);
+
+    int size() const;
+    // Age of the oldest held message
+    qint64 latency(qint64 nowMs) const;
+
+private:
+    struct Entry {
+        ChatMessage message;
+        qint64 arrivalMs;
+    };
+
+    int m_delay;
+    QQueue<Entry> m_queue;
+    double m_credit;
+    qint64 m_lastTakeMs;
+};
+
+#endif // PRESENTATIONBUFFER_H
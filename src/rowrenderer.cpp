@@ -0,0 +1,275 @@
+#include "rowrenderer.h"
+#include <QTextDocument>
+#include <QTextLayout>
+#include <QPainter>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtMath>
+#include <utility>
+
+namespace {
+// Finished rows kept across updates; older ones are re-rendered on demand
+const int CacheBytes = 32 * 1024 * 1024;
+// Row jobs run at the default priority, ahead of warm-up
+const int WarmUpPriority = -1;
+}
+
+RowRenderer::RowRenderer(QObject* parent)
+    : QObject(parent)
+    , m_width(0)
+    , m_devicePixelRatio(1.0)
+    , m_generation(0)
+    , m_nextTicket(0)
+    , m_readyScheduled(false)
+    , m_renderNs(0)
+{
+    m_rows.setMaxCost(CacheBytes);
+
+    // Leave a core for the GUI thread
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    m_pool.setObjectName("RowRenderer");
+    // Idle threads would take their warm glyph caches with them
+    m_pool.setExpiryTimeout(-1);
+}
+
+RowRenderer::~RowRenderer()
+{
+    // Jobs that have not started yet are dropped, running ones see the bump
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+}
+
+bool RowRenderer::setLayout(int width, const QFont& font, qreal devicePixelRatio)
+{
+    if (width == m_width && font == m_font && devicePixelRatio == m_devicePixelRatio) {
+        return false;
+    }
+
+    m_width = width;
+    m_font = font;
+    m_devicePixelRatio = devicePixelRatio;
+    startGeneration();
+    queueWarmUp();
+    return true;
+}
+
+void RowRenderer::invalidateAll()
+{
+    startGeneration();
+}
+
+void RowRenderer::startGeneration()
+{
+    m_generation.fetchAndAddOrdered(1);
+    m_pool.clear();
+    m_pending.clear();
+
+    // Keep showing the old rows until their replacements arrive. Stand-ins
+    // still on screen carry over, so resizing twice in a row never blanks one.
+    QHash<qint64, QPixmap> staleRows;
+    for (qint64 key : std::as_const(m_staleShown)) {
+        auto it = m_staleRows.constFind(key);
+        if (it != m_staleRows.cend()) {
+            staleRows.insert(key, it.value());
+        }
+    }
+    const QList<qint64> keys = m_rows.keys();
+    for (qint64 key : keys) {
+        staleRows.insert(key, *m_rows.object(key));
+    }
+    m_staleRows = staleRows;
+    m_staleShown.clear();
+    m_rows.clear();
+}
+
+void RowRenderer::invalidate(qint64 key)
+{
+    // A job still running renders the old HTML; its ticket no longer matches
+    m_pending.remove(key);
+    if (const QPixmap* pixmap = m_rows.object(key)) {
+        m_staleRows.insert(key, *pixmap);
+        m_rows.remove(key);
+    }
+}
+
+void RowRenderer::setWarmUpText(const QList<QString>& slices)
+{
+    m_warmUpSlices = slices;
+    queueWarmUp();
+}
+
+void RowRenderer::queueWarmUp()
+{
+    if (m_width <= 0 || m_warmUpSlices.isEmpty()) {
+        return;
+    }
+
+    // One job per thread; a thread runs one job at a time, so started
+    // together they spread across the pool
+    int generation = m_generation.loadAcquire();
+    int width = m_width;
+    QFont font = m_font;
+    qreal devicePixelRatio = m_devicePixelRatio;
+    QList<QString> slices = m_warmUpSlices;
+    for (int i = 0; i < m_pool.maxThreadCount(); ++i) {
+        m_pool.start([this, slices, generation, width, font, devicePixelRatio]() {
+            for (const QString& slice : slices) {
+                if (m_generation.loadAcquire() != generation) {
+                    return;
+                }
+                drawGlyphs(slice, width, font, devicePixelRatio);
+            }
+        }, WarmUpPriority);
+    }
+}
+
+QPixmap RowRenderer::row(qint64 key, const QString& html, bool* current)
+{
+    if (const QPixmap* pixmap = m_rows.object(key)) {
+        if (current) {
+            *current = true;
+        }
+        return *pixmap;
+    }
+
+    if (current) {
+        *current = false;
+    }
+
+    int generation = m_generation.loadAcquire();
+    if (m_width > 0 && !m_pending.contains(key)) {
+        quint64 ticket = ++m_nextTicket;
+        m_pending.insert(key, ticket);
+
+        int width = m_width;
+        QFont font = m_font;
+        qreal devicePixelRatio = m_devicePixelRatio;
+        m_pool.start([this, key, ticket, html, generation, width, font, devicePixelRatio]() {
+            // Cancelled while queued
+            if (m_generation.loadAcquire() != generation) {
+                return;
+            }
+            QElapsedTimer timer;
+            timer.start();
+            QImage image = render(html, width, font, devicePixelRatio);
+            qint64 renderNs = timer.nsecsElapsed();
+            QMetaObject::invokeMethod(this, [this, key, ticket, generation, image, renderNs]() {
+                onRendered(key, ticket, generation, image, renderNs);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    auto stale = m_staleRows.constFind(key);
+    if (stale == m_staleRows.cend()) {
+        return QPixmap();
+    }
+    m_staleShown.insert(key);
+    return stale.value();
+}
+
+QPixmap RowRenderer::cachedRow(qint64 key) const
+{
+    const QPixmap* pixmap = m_rows.object(key);
+    return pixmap ? *pixmap : QPixmap();
+}
+
+qint64 RowRenderer::takeRenderNs()
+{
+    qint64 renderNs = m_renderNs / qMax(1, m_pool.maxThreadCount());
+    m_renderNs = 0;
+    return renderNs;
+}
+
+qint64 RowRenderer::memoryUsage() const
+{
+    qint64 bytes = m_rows.totalCost();
+    for (const QPixmap& pixmap : m_staleRows) {
+        bytes += qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    }
+    return bytes;
+}
+
+qint64 RowRenderer::releaseOldest(qint64 bytes)
+{
+    qint64 before = memoryUsage();
+    m_staleRows.clear();
+    m_staleShown.clear();
+
+    // Shrinking the cache evicts least recently used rows first
+    qint64 target = qMax<qint64>(0, m_rows.totalCost() - bytes);
+    m_rows.setMaxCost(static_cast<int>(target));
+    m_rows.setMaxCost(CacheBytes);
+
+    return before - memoryUsage();
+}
+
+void RowRenderer::onRendered(qint64 key, quint64 ticket, int generation, const QImage& image, qint64 renderNs)
+{
+    // The work was done either way; it counts against the render budget
+    m_renderNs += renderNs;
+
+    // Rendered for a layout that no longer applies, or for HTML since replaced
+    if (generation != m_generation.loadAcquire() || m_pending.value(key) != ticket) {
+        return;
+    }
+    m_pending.remove(key);
+
+    // On raster platforms this wraps the image; the pixmap is what gets blitted
+    QPixmap* pixmap = new QPixmap(QPixmap::fromImage(image));
+    int cost = static_cast<int>(qMin<qint64>(image.sizeInBytes(), CacheBytes));
+    m_rows.insert(key, pixmap, cost);
+    m_staleRows.remove(key);
+    m_staleShown.remove(key);
+
+    if (!m_readyScheduled) {
+        m_readyScheduled = true;
+        QMetaObject::invokeMethod(this, [this]() {
+            m_readyScheduled = false;
+            emit rowsReady();
+        }, Qt::QueuedConnection);
+    }
+}
+
+QImage RowRenderer::render(const QString& html, int width, const QFont& font, qreal devicePixelRatio)
+{
+    // Same text engine QLabel uses for rich text, but on this thread
+    QTextDocument document;
+    document.setDocumentMargin(0);
+    document.setDefaultFont(font);
+    document.setHtml(html);
+    document.setTextWidth(width);
+
+    QSizeF size = document.size();
+    QImage image(qCeil(size.width() * devicePixelRatio), qCeil(size.height() * devicePixelRatio),
+                 QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(devicePixelRatio);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    document.drawContents(&painter);
+    return image;
+}
+
+void RowRenderer::drawGlyphs(const QString& text, int width, const QFont& font, qreal devicePixelRatio)
+{
+    // Shaping resolves the fallback font for every script in the text;
+    // drawing rasterizes the glyphs into this thread's glyph cache
+    QTextLayout layout(text, font);
+    layout.beginLayout();
+    qreal lineHeight = 0;
+    for (QTextLine line = layout.createLine(); line.isValid(); line = layout.createLine()) {
+        line.setLineWidth(width);
+        lineHeight = qMax(lineHeight, line.height());
+    }
+    layout.endLayout();
+
+    // Every line is drawn over the same strip; only the glyph cache matters
+    QImage image(QSize(width, qCeil(lineHeight)) * devicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(devicePixelRatio);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    for (int i = 0; i < layout.lineCount(); ++i) {
+        QTextLine line = layout.lineAt(i);
+        line.draw(&painter, QPointF(0, -line.y()));
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef ROWRENDERER_H
+#define ROWRENDERER_H
+
+#include <QObject>
+#include <QCache>
+#include <QFont>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QImage>
+#include <QPixmap>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+// Lays out and rasterizes chat rows (rich text) into images on a worker pool,
+// so the GUI thread only converts finished images and blits them.
+//
+// Rows are keyed by a number the caller picks (the overlay uses sequence
+// numbers), so a lookup never touches the HTML; the caller invalidates a key
+// when its HTML changes. Everything else that affects the result (width,
+// font, device pixel ratio) belongs to a generation; changing it cancels
+// queued and running jobs and starts over. Until a row is redone, its previous
+// image stands in for it so a resize never blanks the chat.
+//
+// Font engines and glyph caches are per thread, so glyph warm-up runs here on
+// the threads that draw rows, once per generation, below row jobs in priority.
+class RowRenderer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit RowRenderer(QObject* parent = nullptr);
+    ~RowRenderer();
+
+    // Returns true if this started a new generation
+    bool setLayout(int width, const QFont& font, qreal devicePixelRatio);
+    // Every row's HTML changed (e.g. the text color); starts a new generation
+    void invalidateAll();
+    // This row's HTML changed; its old image stands in until the new one is done
+    void invalidate(qint64 key);
+
+    // Text drawn on every worker thread at the start of each generation, so
+    // fallback fonts are resolved and glyphs rasterized before a row needs them
+    void setWarmUpText(const QList<QString>& slices);
+
+    // The finished row, queueing a render of html if there is none yet.
+    // *current is false when the returned pixmap is a stand-in (or null).
+    QPixmap row(qint64 key, const QString& html, bool* current = nullptr);
+    // Lookup only, never queues
+    QPixmap cachedRow(qint64 key) const;
+
+    // Time the pool spent on rows finished since the last call, per thread,
+    // so it compares with the GUI thread's share of a display tick
+    qint64 takeRenderNs();
+
+    qint64 memoryUsage() const;
+    qint64 releaseOldest(qint64 bytes);
+
+signals:
+    // Coalesced: one signal per batch of finished rows
+    void rowsReady();
+
+private:
+    int m_width;
+    QFont m_font;
+    qreal m_devicePixelRatio;
+    QAtomicInt m_generation;
+
+    QCache<qint64, QPixmap> m_rows;
+    QHash<qint64, QPixmap> m_staleRows;
+    // Stand-ins handed out this generation; they survive the next one too
+    QSet<qint64> m_staleShown;
+    // Ticket of the job that renders each key's current HTML
+    QHash<qint64, quint64> m_pending;
+    quint64 m_nextTicket;
+    bool m_readyScheduled;
+    qint64 m_renderNs;
+    QList<QString> m_warmUpSlices;
+
+    // Declared last so it is destroyed (and waits for its jobs) first
+    QThreadPool m_pool;
+
+    void startGeneration();
+    void queueWarmUp();
+    void onRendered(qint64 key, quint64 ticket, int generation, const QImage& image, qint64 renderNs);
+
+    static QImage render(const QString& html, int width, const QFont& font, qreal devicePixelRatio);
+    static void drawGlyphs(const QString& text, int width, const QFont& font, qreal devicePixelRatio);
+};
+
+#endif // ROWRENDERER_H
@@ -0,0 +1,45 @@
+#include "startupmetrics.h"
+#include <QElapsedTimer>
+#include <QSet>
+#include <QByteArray>
+#include <QDebug>
+
+namespace {
+QElapsedTimer& startupTimer()
+{
+    static QElapsedTimer timer;
+    return timer;
+}
+
+QSet<QByteArray>& reachedMilestones()
+{
+    static QSet<QByteArray> milestones;
+    return milestones;
+}
+}
+
+namespace StartupMetrics {
+
+void start()
+{
+    startupTimer().start();
+}
+
+void mark(const char* milestone)
+{
+    // Cheap enough for the per-message path: the lookup does not allocate
+    QByteArray key = QByteArray::fromRawData(milestone, static_cast<int>(qstrlen(milestone)));
+    if (!startupTimer().isValid() || reachedMilestones().contains(key)) {
+        return;
+    }
+
+    reachedMilestones().insert(QByteArray(milestone));
+    qDebug().nospace() << "Startup: " << milestone << " after " << startupTimer().elapsed() << " ms";
+}
+
+qint64 elapsedMs()
+{
+    return startupTimer().isValid() ? startupTimer().elapsed() : 0;
+}
+
+}
@@ -0,0 +1,17 @@
+#ifndef STARTUPMETRICS_H
+#define STARTUPMETRICS_H
+
+#include <QtGlobal>
+
+// Process-wide startup timeline. start() is called first thing in main();
+// each milestone is logged once with the milliseconds elapsed since then,
+// e.g. "Startup: first message after 812 ms".
+namespace StartupMetrics {
+
+void start();
+void mark(const char* milestone);
+qint64 elapsedMs();
+
+}
+
+#endif // STARTUPMETRICS_H
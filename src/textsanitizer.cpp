@@ -0,0 +1,283 @@
+#include "textsanitizer.h"
+#include <QtAlgorithms>
+#include <QTextBoundaryFinder>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTSANITIZER_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TEXTSANITIZER_NEON
+#endif
+
+namespace {
+// More marks than this on one base character is decoration, not language
+const int MaxMarksPerBase = 4;
+// Longest run without a space before a break opportunity is inserted
+const int MaxUnbrokenRun = 30;
+
+bool isOutsidePrintableAscii(char16_t unit)
+{
+    return unit < 0x20 || unit > 0x7E;
+}
+
+bool isHtmlSpecial(char16_t unit)
+{
+    return unit == '&' || unit == '<' || unit == '>' || unit == '"' || unit == '\'';
+}
+
+// True if any unit is outside printable ASCII
+bool needsSanitizing(const char16_t* data, int size)
+{
+    int i = 0;
+#if defined(TEXTSANITIZER_SSE2)
+    const __m128i low = _mm_set1_epi16(0x20);
+    const __m128i span = _mm_set1_epi16(0x7E - 0x20);
+    for (; i + 8 <= size; i += 8) {
+        __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        // (unit - 0x20) saturating-minus span is non-zero exactly for units outside the range
+        __m128i outside = _mm_subs_epu16(_mm_sub_epi16(units, low), span);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(outside, _mm_setzero_si128())) != 0xFFFF) {
+            return true;
+        }
+    }
+#elif defined(TEXTSANITIZER_NEON)
+    const uint16x8_t low = vdupq_n_u16(0x20);
+    const uint16x8_t span = vdupq_n_u16(0x7E - 0x20);
+    for (; i + 8 <= size; i += 8) {
+        uint16x8_t units = vld1q_u16(reinterpret_cast<const uint16_t*>(data + i));
+        if (vmaxvq_u16(vcgtq_u16(vsubq_u16(units, low), span)) != 0) {
+            return true;
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (isOutsidePrintableAscii(data[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Folds one block of eight units into the run-length check; bit n of
+// spaceLanes is set when unit n is a space
+bool extendsRunTooFar(quint32 spaceLanes, int& run)
+{
+    if (spaceLanes == 0) {
+        run += 8;
+        return run > MaxUnbrokenRun;
+    }
+
+    int firstSpace = qCountTrailingZeroBits(spaceLanes);
+    if (run + firstSpace > MaxUnbrokenRun) {
+        return true;
+    }
+    run = 7 - (31 - qCountLeadingZeroBits(spaceLanes));
+    return false;
+}
+
+// True if any unit needs an entity or some run is long enough to need a break
+bool needsEscaping(const char16_t* data, int size)
+{
+    int i = 0;
+    int run = 0;
+#if defined(TEXTSANITIZER_SSE2)
+    const __m128i amp = _mm_set1_epi16('&');
+    const __m128i lt = _mm_set1_epi16('<');
+    const __m128i gt = _mm_set1_epi16('>');
+    const __m128i quot = _mm_set1_epi16('"');
+    const __m128i apos = _mm_set1_epi16('\'');
+    const __m128i space = _mm_set1_epi16(' ');
+    for (; i + 8 <= size; i += 8) {
+        __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(units, amp), _mm_cmpeq_epi16(units, lt)),
+                                       _mm_or_si128(_mm_cmpeq_epi16(units, gt), _mm_cmpeq_epi16(units, quot)));
+        special = _mm_or_si128(special, _mm_cmpeq_epi16(units, apos));
+        if (_mm_movemask_epi8(special) != 0) {
+            return true;
+        }
+
+        // Packing 16-bit lanes to bytes gives one movemask bit per unit
+        __m128i spaces = _mm_packs_epi16(_mm_cmpeq_epi16(units, space), _mm_setzero_si128());
+        if (extendsRunTooFar(static_cast<quint32>(_mm_movemask_epi8(spaces)), run)) {
+            return true;
+        }
+    }
+#elif defined(TEXTSANITIZER_NEON)
+    static const uint16_t laneBits[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint16x8_t bits = vld1q_u16(laneBits);
+    for (; i + 8 <= size; i += 8) {
+        uint16x8_t units = vld1q_u16(reinterpret_cast<const uint16_t*>(data + i));
+        uint16x8_t special = vorrq_u16(vorrq_u16(vceqq_u16(units, vdupq_n_u16('&')), vceqq_u16(units, vdupq_n_u16('<'))),
+                                       vorrq_u16(vceqq_u16(units, vdupq_n_u16('>')), vceqq_u16(units, vdupq_n_u16('"'))));
+        special = vorrq_u16(special, vceqq_u16(units, vdupq_n_u16('\'')));
+        if (vmaxvq_u16(special) != 0) {
+            return true;
+        }
+
+        uint16x8_t spaces = vandq_u16(vceqq_u16(units, vdupq_n_u16(' ')), bits);
+        if (extendsRunTooFar(vaddvq_u16(spaces), run)) {
+            return true;
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (isHtmlSpecial(data[i])) {
+            return true;
+        }
+        run = data[i] == ' ' ? 0 : run + 1;
+        if (run > MaxUnbrokenRun) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bidi embeddings/overrides/isolates and invisible format characters that can
+// reorder or hide the rest of the line; ZWJ/ZWNJ stay for emoji and scripts
+bool isStripped(char32_t codePoint)
+{
+    return codePoint == 0x061C
+        || codePoint == 0x200E || codePoint == 0x200F
+        || (codePoint >= 0x202A && codePoint <= 0x202E)
+        || (codePoint >= 0x2060 && codePoint <= 0x206F)
+        || codePoint == 0xFEFF
+        || (codePoint >= 0xFFF9 && codePoint <= 0xFFFB);
+}
+
+bool isMark(char32_t codePoint)
+{
+    QChar::Category category = QChar::category(codePoint);
+    return category == QChar::Mark_NonSpacing
+        || category == QChar::Mark_SpacingCombining
+        || category == QChar::Mark_Enclosing;
+}
+}
+
+namespace TextSanitizer {
+
+QString sanitize(const QString& text, int maxLength)
+{
+    const char16_t* data = reinterpret_cast<const char16_t*>(text.constData());
+    const int size = text.size();
+
+    if (size <= maxLength && !needsSanitizing(data, size)) {
+        return text;
+    }
+
+    QString out;
+    out.reserve(qMin(size, maxLength) + 1);
+    int marks = 0;
+    bool truncated = false;
+
+    for (int i = 0; i < size; ++i) {
+        char16_t unit = data[i];
+
+        if (!isOutsidePrintableAscii(unit)) {
+            if (out.size() >= maxLength) {
+                truncated = true;
+                break;
+            }
+            out.append(QChar(unit));
+            marks = 0;
+            continue;
+        }
+
+        char32_t codePoint = unit;
+        int units = 1;
+        if (QChar::isHighSurrogate(unit) && i + 1 < size && QChar::isLowSurrogate(data[i + 1])) {
+            codePoint = QChar::surrogateToUcs4(unit, data[i + 1]);
+            units = 2;
+        } else if (QChar::isSurrogate(unit)) {
+            codePoint = 0xFFFD;
+        }
+
+        // Line breaks would only stretch the row; other controls and bidi tricks go
+        bool whitespace = unit == '\t' || unit == '\n' || unit == '\r' || codePoint == 0x2028 || codePoint == 0x2029;
+        if (!whitespace && (unit < 0x20 || (unit >= 0x7F && unit <= 0x9F) || isStripped(codePoint))) {
+            i += units - 1;
+            continue;
+        }
+
+        if (!whitespace && isMark(codePoint)) {
+            if (++marks > MaxMarksPerBase) {
+                i += units - 1;
+                continue;
+            }
+        } else {
+            marks = 0;
+        }
+
+        if (out.size() + units > maxLength) {
+            truncated = true;
+            break;
+        }
+
+        if (whitespace) {
+            out.append(QChar(' '));
+        } else if (units == 2) {
+            out.append(QChar(data[i])).append(QChar(data[i + 1]));
+        } else {
+            out.append(QChar(static_cast<char16_t>(codePoint)));
+        }
+        i += units - 1;
+    }
+
+    if (truncated) {
+        out.append(QChar(0x2026));
+    }
+    return out;
+}
+
+QString escapeHtml(const QString& text)
+{
+    const char16_t* data = reinterpret_cast<const char16_t*>(text.constData());
+    const int size = text.size();
+
+    if (!needsEscaping(data, size)) {
+        return text;
+    }
+
+    QString out;
+    out.reserve(size + size / 8 + 16);
+    int run = 0;
+    // Only built once a run is long enough to need a break
+    QTextBoundaryFinder graphemes;
+
+    for (int i = 0; i < size; ++i) {
+        char16_t unit = data[i];
+
+        switch (unit) {
+        case '&': out.append(QLatin1String("&amp;")); break;
+        case '<': out.append(QLatin1String("&lt;")); break;
+        case '>': out.append(QLatin1String("&gt;")); break;
+        case '"': out.append(QLatin1String("&quot;")); break;
+        case '\'': out.append(QLatin1String("&#39;")); break;
+        case ' ':
+            out.append(QChar(' '));
+            run = 0;
+            continue;
+        default:
+            // Only break between grapheme clusters: never inside a surrogate
+            // pair, after a base before its marks, around a ZWJ, before a
+            // variation selector or between an emoji and its skin tone
+            if (run >= MaxUnbrokenRun) {
+                if (!graphemes.isValid()) {
+                    graphemes = QTextBoundaryFinder(QTextBoundaryFinder::Grapheme, text);
+                }
+                graphemes.setPosition(i);
+                if (graphemes.isAtBoundary()) {
+                    out.append(QLatin1String("&#8203;"));
+                    run = 0;
+                }
+            }
+            out.append(QChar(unit));
+            break;
+        }
+        ++run;
+    }
+
+    return out;
+}
+
+}
@@ -0,0 +1,26 @@
+#ifndef TEXTSANITIZER_H
+#define TEXTSANITIZER_H
+
+#include <QString>
+
+// Cleans chat text so a single hostile message can't stall layout. Both
+// functions make one pass over the text and return the input unchanged (no
+// allocation) when nothing needs doing; the check for that is vectorized
+// with SSE2 or NEON where available.
+namespace TextSanitizer {
+
+// Run once at ingest. Tabs and line breaks become spaces; other control
+// characters, bidi overrides and invisible format characters are dropped;
+// runs of combining marks are capped per base character (zalgo); the result
+// is cut at maxLength UTF-16 units with an ellipsis.
+QString sanitize(const QString& text, int maxLength = 500);
+
+// HTML-escapes text for the rich-text labels and inserts zero-width break
+// opportunities into unbroken runs so word wrap never has to lay out one
+// enormous word. Breaks only go between grapheme clusters, so emoji
+// sequences and marks stay whole.
+QString escapeHtml(const QString& text);
+
+}
+
+#endif // TEXTSANITIZER_H
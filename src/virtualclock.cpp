@@ -0,0 +1,83 @@
+#include "virtualclock.h"
+#include <QCoreApplication>
+
+VirtualClock::VirtualClock(qint64 startMs)
+    : m_now(startMs)
+    , m_armCount(0)
+{
+}
+
+VirtualClock::~VirtualClock()
+{
+}
+
+qint64 VirtualClock::nowMs() const
+{
+    return m_now;
+}
+
+bool VirtualClock::isVirtual() const
+{
+    return true;
+}
+
+void VirtualClock::advance(qint64 ms)
+{
+    advanceTo(m_now + ms);
+}
+
+void VirtualClock::advanceTo(qint64 targetMs)
+{
+    while (!m_schedule.isEmpty() && m_schedule.firstKey().first <= targetMs) {
+        fireFirst();
+    }
+    m_now = qMax(m_now, targetMs);
+}
+
+bool VirtualClock::advanceToNextTimer()
+{
+    if (m_schedule.isEmpty()) {
+        return false;
+    }
+    fireFirst();
+    return true;
+}
+
+int VirtualClock::armedTimerCount() const
+{
+    return m_schedule.size();
+}
+
+void VirtualClock::arm(ClockTimer* timer, int delayMs)
+{
+    // A zero interval repeating timer would never let time move on
+    DueKey key(m_now + qMax(delayMs, timer->isSingleShot() ? 0 : 1), m_armCount++);
+    m_schedule.insert(key, timer);
+    m_keys.insert(timer, key);
+}
+
+void VirtualClock::disarm(ClockTimer* timer)
+{
+    auto it = m_keys.find(timer);
+    if (it != m_keys.end()) {
+        m_schedule.remove(it.value());
+        m_keys.erase(it);
+    }
+}
+
+void VirtualClock::fireFirst()
+{
+    auto first = m_schedule.begin();
+    ClockTimer* timer = first.value();
+    m_now = qMax(m_now, first.key().first);
+    m_schedule.erase(first);
+    m_keys.remove(timer);
+
+    // Repeating timers are due again one interval after this expiry
+    if (!timer->isSingleShot()) {
+        arm(timer, timer->interval());
+    }
+    timer->fire();
+
+    QCoreApplication::sendPostedEvents();
+}
@@ -0,0 +1,44 @@
+#ifndef VIRTUALCLOCK_H
+#define VIRTUALCLOCK_H
+
+#include <QMap>
+#include <QHash>
+#include <QPair>
+#include "clock.h"
+
+// Simulated time: nothing happens until the owner advances the clock, then
+// every timer due in between fires in due order (ties in arming order) with
+// now() set to its due time. Queued events posted by a timeout are delivered
+// before the next timer, so a run is deterministic and takes only CPU time.
+class VirtualClock : public Clock {
+public:
+    explicit VirtualClock(qint64 startMs);
+    ~VirtualClock();
+
+    qint64 nowMs() const override;
+    bool isVirtual() const override;
+
+    void advance(qint64 ms);
+    void advanceTo(qint64 targetMs);
+
+    // Jumps straight to the next armed timer; false when none is armed
+    bool advanceToNextTimer();
+
+    int armedTimerCount() const;
+
+protected:
+    void arm(ClockTimer* timer, int delayMs) override;
+    void disarm(ClockTimer* timer) override;
+
+private:
+    typedef QPair<qint64, quint64> DueKey; // Due time, arming order
+
+    qint64 m_now;
+    quint64 m_armCount;
+    QMap<DueKey, ClockTimer*> m_schedule;
+    QHash<ClockTimer*, DueKey> m_keys;
+
+    void fireFirst();
+};
+
+#endif // VIRTUALCLOCK_H
@@ -0,0 +1,323 @@
+#include "websocketframereader.h"
+#include <cstring>
+
+namespace {
+// Refuse anything bigger than this rather than growing without bound
+const int MaxMessageBytes = 16 * 1024 * 1024;
+const int InitialBufferBytes = 64 * 1024;
+// RFC 6455 section 5.5
+const int MaxControlPayloadBytes = 125;
+
+// RFC 7692: the sender strips this sync-flush tail, the receiver puts it back
+const char DeflateTail[4] = { 0x00, 0x00, '\xff', '\xff' };
+
+enum Opcode {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    CloseOpcode = 0x8,
+    PingOpcode = 0x9,
+    PongOpcode = 0xA
+};
+}
+
+WebSocketFrameReader::WebSocketFrameReader()
+    : m_readPos(0)
+    , m_readEnd(0)
+    , m_messageSize(0)
+    , m_inMessage(false)
+    , m_messageCompressed(false)
+    , m_payload(nullptr)
+    , m_payloadLength(0)
+    , m_deflateNegotiated(false)
+    , m_serverNoContextTakeover(false)
+{
+    m_readBuffer.resize(InitialBufferBytes);
+    m_messageBuffer.resize(InitialBufferBytes);
+
+    // Raw deflate with the largest window decodes any window size the server picks
+    std::memset(&m_inflater, 0, sizeof(m_inflater));
+    inflateInit2(&m_inflater, -MAX_WBITS);
+}
+
+WebSocketFrameReader::~WebSocketFrameReader()
+{
+    inflateEnd(&m_inflater);
+}
+
+void WebSocketFrameReader::reset()
+{
+    m_readPos = 0;
+    m_readEnd = 0;
+    m_messageSize = 0;
+    m_inMessage = false;
+    m_messageCompressed = false;
+    m_payload = nullptr;
+    m_payloadLength = 0;
+    m_errorString.clear();
+    m_deflateNegotiated = false;
+    m_serverNoContextTakeover = false;
+    inflateReset(&m_inflater);
+}
+
+void WebSocketFrameReader::setDeflate(bool negotiated, bool serverNoContextTakeover)
+{
+    m_deflateNegotiated = negotiated;
+    m_serverNoContextTakeover = serverNoContextTakeover;
+}
+
+char* WebSocketFrameReader::reserve(int bytes)
+{
+    // Make room at the tail: compact first, grow only if the data still doesn't fit
+    if (m_readPos == m_readEnd) {
+        m_readPos = 0;
+        m_readEnd = 0;
+    }
+    if (m_readEnd + bytes > m_readBuffer.size()) {
+        if (m_readPos > 0) {
+            std::memmove(m_readBuffer.data(), m_readBuffer.constData() + m_readPos, m_readEnd - m_readPos);
+            m_readEnd -= m_readPos;
+            m_readPos = 0;
+        }
+        if (m_readEnd + bytes > m_readBuffer.size()) {
+            m_readBuffer.resize(qMax(m_readBuffer.size() * 2, m_readEnd + bytes));
+        }
+    }
+
+    return m_readBuffer.data() + m_readEnd;
+}
+
+void WebSocketFrameReader::commit(int bytes)
+{
+    m_readEnd += bytes;
+}
+
+void WebSocketFrameReader::append(const char* data, int length)
+{
+    std::memcpy(reserve(length), data, length);
+    commit(length);
+}
+
+QByteArray WebSocketFrameReader::pending() const
+{
+    return QByteArray::fromRawData(m_readBuffer.constData() + m_readPos, m_readEnd - m_readPos);
+}
+
+void WebSocketFrameReader::consume(int bytes)
+{
+    m_readPos = qMin(m_readEnd, m_readPos + bytes);
+}
+
+WebSocketFrameReader::Result WebSocketFrameReader::next()
+{
+    m_payload = nullptr;
+    m_payloadLength = 0;
+
+    for (;;) {
+        int available = m_readEnd - m_readPos;
+        if (available < 2) {
+            return NeedMore;
+        }
+
+        uchar* header = reinterpret_cast<uchar*>(m_readBuffer.data() + m_readPos);
+        bool fin = header[0] & 0x80;
+        bool rsv1 = header[0] & 0x40;
+        bool rsv23 = header[0] & 0x30;
+        int opcode = header[0] & 0x0F;
+        bool masked = header[1] & 0x80;
+        quint64 length = header[1] & 0x7F;
+        int headerSize = 2;
+
+        if (length == 126) {
+            if (available < 4) {
+                return NeedMore;
+            }
+            length = (quint64(header[2]) << 8) | header[3];
+            headerSize = 4;
+        } else if (length == 127) {
+            if (available < 10) {
+                return NeedMore;
+            }
+            length = 0;
+            for (int i = 2; i < 10; ++i) {
+                length = (length << 8) | header[i];
+            }
+            headerSize = 10;
+        }
+
+        if (rsv23) {
+            return fail("WebSocket protocol error: reserved bits set");
+        }
+        if (opcode & 0x8) {
+            // Control frames are never compressed (RFC 7692 section 6.1) or fragmented
+            if (rsv1) {
+                return fail("WebSocket protocol error: RSV1 set on a control frame");
+            }
+            if (!fin || length > quint64(MaxControlPayloadBytes)) {
+                return fail("WebSocket protocol error: fragmented or oversized control frame");
+            }
+        }
+        if (length > quint64(MaxMessageBytes)) {
+            return fail("WebSocket frame too large");
+        }
+
+        int maskOffset = headerSize;
+        if (masked) {
+            headerSize += 4;
+        }
+        if (available < headerSize + static_cast<int>(length)) {
+            return NeedMore; // Wait for the rest; reserve() grows the buffer as needed
+        }
+
+        // Servers must not mask, but unmasking in place costs nothing if one does
+        char* payload = m_readBuffer.data() + m_readPos + headerSize;
+        if (masked) {
+            for (quint64 i = 0; i < length; ++i) {
+                payload[i] ^= header[maskOffset + (i & 3)];
+            }
+        }
+
+        m_readPos += headerSize + static_cast<int>(length);
+        Result result = handleFrame(opcode, fin, rsv1, payload, static_cast<int>(length));
+        if (result != NeedMore) {
+            return result;
+        }
+    }
+}
+
+WebSocketFrameReader::Result WebSocketFrameReader::handleFrame(int opcode, bool fin, bool rsv1,
+                                                               const char* payload, int length)
+{
+    switch (opcode) {
+    case CloseOpcode:
+    case PingOpcode:
+        m_payload = payload;
+        m_payloadLength = length;
+        return opcode == CloseOpcode ? Close : Ping;
+    case PongOpcode:
+        return Pong;
+    case Text:
+    case Binary:
+        if (m_inMessage) {
+            return fail("WebSocket protocol error: new message inside a fragmented one");
+        }
+        if (rsv1 && !m_deflateNegotiated) {
+            return fail("WebSocket protocol error: compressed frame without permessage-deflate");
+        }
+
+        // The common case: a whole uncompressed message goes out as a view, no copy
+        if (fin && !rsv1) {
+            m_payload = payload;
+            m_payloadLength = length;
+            return Message;
+        }
+
+        m_inMessage = true;
+        m_messageCompressed = rsv1;
+        m_messageSize = 0;
+        break;
+    case Continuation:
+        if (!m_inMessage) {
+            return fail("WebSocket protocol error: unexpected continuation frame");
+        }
+        if (rsv1) {
+            return fail("WebSocket protocol error: RSV1 set on a continuation frame");
+        }
+        break;
+    default:
+        return fail(QString("WebSocket protocol error: unknown opcode %1").arg(opcode));
+    }
+
+    bool ok = m_messageCompressed ? inflateMessage(payload, length) : appendMessage(payload, length);
+    if (!ok) {
+        return Error;
+    }
+
+    if (!fin) {
+        return NeedMore; // Keep reading fragments
+    }
+
+    if (m_messageCompressed) {
+        if (!inflateMessage(DeflateTail, sizeof(DeflateTail))) {
+            return Error;
+        }
+        if (m_serverNoContextTakeover) {
+            inflateReset(&m_inflater);
+        }
+    }
+    m_inMessage = false;
+    m_payload = m_messageBuffer.constData();
+    m_payloadLength = m_messageSize;
+    return Message;
+}
+
+bool WebSocketFrameReader::appendMessage(const char* data, int length)
+{
+    if (m_messageSize + length > MaxMessageBytes) {
+        fail("WebSocket message too large");
+        return false;
+    }
+    if (m_messageSize + length > m_messageBuffer.size()) {
+        m_messageBuffer.resize(qMax(m_messageBuffer.size() * 2, m_messageSize + length));
+    }
+
+    std::memcpy(m_messageBuffer.data() + m_messageSize, data, length);
+    m_messageSize += length;
+    return true;
+}
+
+bool WebSocketFrameReader::inflateMessage(const char* data, int length)
+{
+    m_inflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    m_inflater.avail_in = static_cast<uInt>(length);
+
+    for (;;) {
+        if (m_messageBuffer.size() - m_messageSize < 4096) {
+            if (m_messageBuffer.size() >= MaxMessageBytes) {
+                fail("WebSocket message too large");
+                return false;
+            }
+            m_messageBuffer.resize(qMin(MaxMessageBytes, m_messageBuffer.size() * 2));
+        }
+
+        m_inflater.next_out = reinterpret_cast<Bytef*>(m_messageBuffer.data() + m_messageSize);
+        m_inflater.avail_out = static_cast<uInt>(m_messageBuffer.size() - m_messageSize);
+
+        int result = inflate(&m_inflater, Z_SYNC_FLUSH);
+        m_messageSize = m_messageBuffer.size() - static_cast<int>(m_inflater.avail_out);
+
+        if (result == Z_STREAM_END) {
+            // The server ended the deflate stream; the next message starts a new one
+            inflateReset(&m_inflater);
+            if (m_inflater.avail_in == 0) {
+                return true;
+            }
+        } else if (result == Z_BUF_ERROR || (result == Z_OK && m_inflater.avail_in == 0)) {
+            // Either no more progress is possible or all input was consumed;
+            // if the output filled up there may be more pending, so go round again
+            if (m_inflater.avail_out != 0 || result == Z_BUF_ERROR) {
+                return true;
+            }
+        } else if (result != Z_OK) {
+            fail(QString("permessage-deflate error: %1").arg(m_inflater.msg ? m_inflater.msg : "corrupt data"));
+            return false;
+        }
+    }
+}
+
+QByteArray WebSocketFrameReader::payload() const
+{
+    return QByteArray::fromRawData(m_payload, m_payloadLength);
+}
+
+QString WebSocketFrameReader::errorString() const
+{
+    return m_errorString;
+}
+
+WebSocketFrameReader::Result WebSocketFrameReader::fail(const QString& message)
+{
+    m_errorString = message;
+    m_inMessage = false;
+    return Error;
+}
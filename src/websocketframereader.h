@@ -0,0 +1,73 @@
+#ifndef WEBSOCKETFRAMEREADER_H
+#define WEBSOCKETFRAMEREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <zlib.h>
+
+// Socket-free RFC 6455 frame parser with permessage-deflate (RFC 7692)
+// decompression, used by DeflateWebSocketTransport and its tests.
+//
+// Socket data is read into one reusable buffer and parsed in place: an
+// uncompressed frame is returned as a view into that buffer, a compressed or
+// fragmented one is reassembled into a second reusable buffer. Nothing is
+// allocated per message once the buffers have grown to the working size.
+class WebSocketFrameReader {
+public:
+    enum Result {
+        NeedMore, // No complete frame buffered
+        Message,  // payload() is a whole text or binary message
+        Ping,     // payload() is the ping data to echo
+        Pong,
+        Close,    // payload() is the close status and reason
+        Error     // Protocol violation; errorString() says which
+    };
+
+    WebSocketFrameReader();
+    ~WebSocketFrameReader();
+    Q_DISABLE_COPY(WebSocketFrameReader)
+
+    // Drops buffered data and decompression state for a new connection
+    void reset();
+    void setDeflate(bool negotiated, bool serverNoContextTakeover);
+
+    // Writes land directly in the buffer: reserve room, fill it, commit
+    char* reserve(int bytes);
+    void commit(int bytes);
+    void append(const char* data, int length);
+
+    // Bytes not parsed yet (the handshake response is read from here first)
+    QByteArray pending() const;
+    void consume(int bytes);
+
+    Result next();
+
+    // Valid until the next call to next(), append() or reserve()
+    QByteArray payload() const;
+    QString errorString() const;
+
+private:
+    QByteArray m_readBuffer;
+    int m_readPos;
+    int m_readEnd;
+
+    QByteArray m_messageBuffer;
+    int m_messageSize;
+    bool m_inMessage;
+    bool m_messageCompressed;
+
+    const char* m_payload;
+    int m_payloadLength;
+    QString m_errorString;
+
+    z_stream m_inflater;
+    bool m_deflateNegotiated;
+    bool m_serverNoContextTakeover;
+
+    Result handleFrame(int opcode, bool fin, bool rsv1, const char* payload, int length);
+    bool appendMessage(const char* data, int length);
+    bool inflateMessage(const char* data, int length);
+    Result fail(const QString& message);
+};
+
+#endif // WEBSOCKETFRAMEREADER_H
@@ -0,0 +1,48 @@
+#include "websockettransport.h"
+
+WebSocketTransport::WebSocketTransport(QObject* parent)
+    : ChatTransport(parent)
+{
+    connect(&m_webSocket, &QWebSocket::connected, this, &ChatTransport::connected);
+    connect(&m_webSocket, &QWebSocket::disconnected, this, &ChatTransport::disconnected);
+    connect(&m_webSocket, &QWebSocket::textMessageReceived, this, &WebSocketTransport::onTextMessageReceived);
+    connect(&m_webSocket, &QWebSocket::errorOccurred, this, [this]() {
+        emit errorOccurred(m_webSocket.errorString());
+    });
+}
+
+void WebSocketTransport::open(const QUrl& url)
+{
+    m_webSocket.open(url);
+}
+
+void WebSocketTransport::close()
+{
+    if (m_webSocket.isValid()) {
+        m_webSocket.close();
+    }
+}
+
+bool WebSocketTransport::isConnected() const
+{
+    return m_webSocket.state() == QAbstractSocket::ConnectedState;
+}
+
+void WebSocketTransport::sendText(const QByteArray& utf8)
+{
+    m_webSocket.sendTextMessage(QString::fromUtf8(utf8));
+}
+
+QString WebSocketTransport::errorString() const
+{
+    return m_webSocket.errorString();
+}
+
+void WebSocketTransport::onTextMessageReceived(const QString& message)
+{
+    // QWebSocket has already decoded to UTF-16, so this round trip can't be avoided here
+    QByteArray frame = message.toUtf8();
+    m_wireBytes += frame.size();
+    m_messageBytes += frame.size();
+    emit frameReceived(frame);
+}
@@ -0,0 +1,28 @@
+#ifndef WEBSOCKETTRANSPORT_H
+#define WEBSOCKETTRANSPORT_H
+
+#include "chattransport.h"
+#include <QWebSocket>
+
+// Transport on top of QWebSocket. QWebSocket does not negotiate
+// permessage-deflate, so every frame arrives uncompressed.
+class WebSocketTransport : public ChatTransport {
+    Q_OBJECT
+
+public:
+    explicit WebSocketTransport(QObject* parent = nullptr);
+
+    void open(const QUrl& url) override;
+    void close() override;
+    bool isConnected() const override;
+    void sendText(const QByteArray& utf8) override;
+    QString errorString() const override;
+
+private slots:
+    void onTextMessageReceived(const QString& message);
+
+private:
+    QWebSocket m_webSocket;
+};
+
+#endif // WEBSOCKETTRANSPORT_H
@@ -0,0 +1,124 @@
+#include <QtTest>
+#include "chatfilterengine.h"
+
+namespace {
+ChatFilterEngine::Rules rules(const QStringList& blocked, const QStringList& masked, const QStringList& highlighted)
+{
+    ChatFilterEngine::Rules rules;
+    rules.blockedPhrases = blocked;
+    rules.maskedPhrases = masked;
+    rules.highlightPhrases = highlighted;
+    return rules;
+}
+
+// The text apply() leaves behind, with its actions
+QString applied(const ChatFilterEngine& engine, const QString& text, ChatFilterEngine::Actions* actions = nullptr)
+{
+    ChatMessage message("viewer", text);
+    ChatFilterEngine::Actions result = engine.apply(message);
+    if (actions) {
+        *actions = result;
+    }
+    return message.message();
+}
+}
+
+class TestChatFilterEngine : public QObject {
+    Q_OBJECT
+
+private slots:
+    void foldTextNormalizes();
+    void masksMapBackToOriginal_data();
+    void masksMapBackToOriginal();
+    void surrogatePairs();
+    void failLinksInheritOutputs();
+};
+
+void TestChatFilterEngine::foldTextNormalizes()
+{
+    QCOMPARE(ChatFilterEngine::foldText("Hello"), QString("hello"));
+    QCOMPARE(ChatFilterEngine::foldText(QString::fromUtf8("CAF\xC3\x89")), QString("cafe"));
+    QCOMPARE(ChatFilterEngine::foldText(QString::fromUtf8("\xEF\xBC\xA2\xEF\xBD\x81\xEF\xBD\x84")), QString("bad"));
+    QCOMPARE(ChatFilterEngine::foldText(QString::fromUtf8("\xEF\xAC\x81ne")), QString("fine"));
+    QCOMPARE(ChatFilterEngine::foldText(QString::fromUtf8("b\xE2\x80\x8B" "ad")), QString("bad"));
+}
+
+void TestChatFilterEngine::masksMapBackToOriginal_data()
+{
+    QTest::addColumn<QString>("phrase");
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("ascii case") << "bad" << "so BAD, bad" << "so ***, ***";
+    QTest::newRow("precomposed accent") << "cafe" << QString::fromUtf8("a CAF\xC3\x89 latte")
+                                        << "a **** latte";
+    QTest::newRow("fullwidth") << "bad" << QString::fromUtf8("x \xEF\xBC\xA2\xEF\xBD\x81\xEF\xBD\x84 y")
+                               << "x *** y";
+    // One ligature unit folds to two; the match still starts at the ligature
+    QTest::newRow("ligature") << "fine" << QString::fromUtf8("so \xEF\xAC\x81ne day") << "so *** day";
+    QTest::newRow("kelvin sign") << "ok" << QString::fromUtf8("o\xE2\x84\xAA!") << "**!";
+    // Zero-width characters inside the phrase are masked with it
+    QTest::newRow("zero width") << "bad" << QString::fromUtf8("b\xE2\x80\x8B" "ad") << "****";
+    QTest::newRow("phrase with space") << "go away" << "please GO  AWAY now" << "please GO  AWAY now";
+    QTest::newRow("spaces kept") << "go away" << "please Go Away now" << "please ** **** now";
+    QTest::newRow("overlapping") << "aba" << "ababa" << "*****";
+}
+
+void TestChatFilterEngine::masksMapBackToOriginal()
+{
+    QFETCH(QString, phrase);
+    QFETCH(QString, text);
+    QFETCH(QString, expected);
+
+    ChatFilterEngine engine;
+    engine.setRules(rules({}, { phrase }, {}));
+
+    ChatFilterEngine::Actions actions;
+    QCOMPARE(applied(engine, text, &actions), expected);
+    QCOMPARE(bool(actions & ChatFilterEngine::Mask), expected != text);
+}
+
+void TestChatFilterEngine::surrogatePairs()
+{
+    ChatFilterEngine engine;
+    engine.setRules(rules({}, { QString::fromUtf8("\xF0\x9F\x92\xA9"), "bad" }, {}));
+
+    // Both halves of a pair are masked together
+    QCOMPARE(applied(engine, QString::fromUtf8("a \xF0\x9F\x92\xA9 b")), QString("a ** b"));
+
+    // Mathematical bold letters are pairs that fold to plain ASCII
+    QCOMPARE(applied(engine, QString::fromUtf8("so \xF0\x9D\x90\x9B\xF0\x9D\x90\x9A\xF0\x9D\x90\x9D")),
+             QString("so ******"));
+
+    // A lone surrogate is left alone and does not break matching after it
+    QString lone = QString(QChar(0xD83D)) + "bad";
+    QString masked = applied(engine, lone);
+    QCOMPARE(masked.at(0), QChar(0xD83D));
+    QCOMPARE(masked.mid(1), QString("***"));
+    QCOMPARE(applied(engine, "bad" + QString(QChar(0xD83D))), QString("***") + QChar(0xD83D));
+}
+
+void TestChatFilterEngine::failLinksInheritOutputs()
+{
+    ChatFilterEngine engine;
+    engine.setRules(rules({ "cat" }, { "he" }, { "she", "concatenate" }));
+
+    // Inside "she", the shorter "he" only matches through the failure link
+    ChatFilterEngine::Actions actions;
+    QCOMPARE(applied(engine, "ushers", &actions), QString("us**rs"));
+    QVERIFY(actions == (ChatFilterEngine::Mask | ChatFilterEngine::Highlight));
+
+    // Likewise "cat" ends while the walk is still inside "concatenate"
+    applied(engine, "concat", &actions);
+    QVERIFY(actions & ChatFilterEngine::Drop);
+
+    applied(engine, "nothing to see", &actions);
+    QVERIFY(actions == ChatFilterEngine::Pass);
+
+    // The longest masked phrase ending at a position wins
+    engine.setRules(rules({}, { "b", "abb" }, {}));
+    QTRY_COMPARE(applied(engine, "xabbx"), QString("x***x"));
+}
+
+QTEST_GUILESS_MAIN(TestChatFilterEngine)
+#include "tst_chatfilterengine.moc"
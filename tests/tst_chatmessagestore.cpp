@@ -0,0 +1,154 @@
+#include <QtTest>
+#include "chatmessagestore.h"
+#include "memorybudget.h"
+
+namespace {
+ChatMessage message(const QString& id, qint64 senderId = 1, const QString& text = "hello")
+{
+    ChatMessage message("viewer" + QString::number(senderId), text);
+    message.setMessageId(id);
+    message.setSenderId(senderId);
+    return message;
+}
+
+// Five senders in turn, so every sender has messages across the whole ring
+void appendSequences(KickChatClient& client, qint64 first, qint64 end)
+{
+    for (qint64 sequence = first; sequence < end; ++sequence) {
+        emit client.messageReceived(message("id" + QString::number(sequence), sequence % 5 + 1));
+    }
+}
+
+// Every held sequence maps to its own message and back; nothing older is indexed
+void verifyLayout(const ChatMessageStore& store)
+{
+    for (qint64 sequence = store.firstSequence(); sequence < store.nextSequence(); ++sequence) {
+        QString id = "id" + QString::number(sequence);
+        QCOMPARE(store.at(sequence).messageId(), id);
+        QCOMPARE(store.sequenceOf(id), sequence);
+    }
+    QCOMPARE(store.sequenceOf("id" + QString::number(store.firstSequence() - 1)), qint64(-1));
+}
+
+// The IDs a ban of senderId must report: their held, not yet deleted messages
+QStringList heldIds(const ChatMessageStore& store, qint64 senderId)
+{
+    QStringList ids;
+    for (qint64 sequence = store.firstSequence(); sequence < store.nextSequence(); ++sequence) {
+        if (store.at(sequence).senderId() == senderId && !store.at(sequence).isDeleted()) {
+            ids.append(store.at(sequence).messageId());
+        }
+    }
+    return ids;
+}
+}
+
+class TestChatMessageStore : public QObject {
+    Q_OBJECT
+
+private slots:
+    void repeatedIdsNotAppended();
+    void shrinkAndRegrowKeepLayout();
+};
+
+void TestChatMessageStore::repeatedIdsNotAppended()
+{
+    KickChatClient client;
+    ChatMessageStore store(&client, nullptr, 100);
+    QSignalSpy appended(&store, &ChatMessageStore::messageAppended);
+
+    emit client.messageReceived(message("a"));
+    emit client.messageReceived(message("b"));
+    store.removeMessage("b");
+
+    // The same history page again, with one new message after it
+    emit client.messageReceived(message("a"));
+    emit client.messageReceived(message("b"));
+    emit client.messageReceived(message("c"));
+
+    QCOMPARE(appended.size(), 3);
+    QCOMPARE(store.size(), 3);
+    QCOMPARE(store.sequenceOf("c"), qint64(2));
+    QVERIFY(store.at(store.sequenceOf("b")).isDeleted());
+    QTRY_COMPARE(store.searchIndex()->size(), 3);
+
+    // Messages without an ID cannot be told apart and are all kept
+    emit client.messageReceived(message(QString()));
+    emit client.messageReceived(message(QString()));
+    QCOMPARE(store.size(), 5);
+}
+
+void TestChatMessageStore::shrinkAndRegrowKeepLayout()
+{
+    KickChatClient client;
+    // A zero ceiling pins the accounted limit to its minimum, whatever the RSS
+    MemoryBudget budget(0);
+    ChatMessageStore store(&client, &budget, 300);
+
+    // Unreleasable bytes that decide how far over the limit the budget is
+    QObject ballastOwner;
+    qint64 ballast = 0;
+    budget.registerConsumer(&ballastOwner, "Ballast", MemoryBudget::WidgetPool, [&ballast]() { return ballast; });
+
+    // Wrapped once, so the oldest message is not in slot 0
+    appendSequences(client, 0, 420);
+    QTRY_COMPARE(store.searchIndex()->size(), 420);
+    QCOMPARE(store.firstSequence(), qint64(120));
+    verifyLayout(store);
+
+    // Over budget by exactly the 50 oldest messages
+    qint64 excess = 0;
+    for (qint64 sequence = 120; sequence < 170; ++sequence) {
+        excess += store.at(sequence).memoryUsage();
+    }
+    ballast = budget.accountedLimit() - budget.accountedBytes() + excess;
+    budget.enforce();
+
+    QCOMPARE(store.capacity(), 250);
+    QCOMPARE(store.size(), 250);
+    QCOMPARE(store.firstSequence(), qint64(170));
+    verifyLayout(store);
+
+    // New messages overwrite the oldest in place in the smaller ring
+    appendSequences(client, 420, 450);
+    QCOMPARE(store.size(), 250);
+    QCOMPARE(store.firstSequence(), qint64(200));
+    verifyLayout(store);
+
+    // The sender index only holds sequences still in the ring
+    QSignalSpy removed(&store, &ChatMessageStore::messagesRemoved);
+    QStringList expected = heldIds(store, 3);
+    QCOMPARE(expected.size(), qsizetype(50));
+    store.removeUserMessages(3);
+    QCOMPARE(removed.size(), 1);
+    QCOMPARE(removed.at(0).at(0).toStringList(), expected);
+    for (qint64 sequence = store.firstSequence(); sequence < store.nextSequence(); ++sequence) {
+        QCOMPARE(store.at(sequence).isDeleted(), store.at(sequence).senderId() == 3);
+    }
+
+    // Headroom again: back to full capacity, then filled and wrapped
+    ballast = 0;
+    budget.enforce();
+    QCOMPARE(store.capacity(), 300);
+    QCOMPARE(store.size(), 250);
+    verifyLayout(store);
+
+    appendSequences(client, 450, 530);
+    QCOMPARE(store.size(), 300);
+    QCOMPARE(store.firstSequence(), qint64(230));
+    verifyLayout(store);
+
+    expected = heldIds(store, 4);
+    QCOMPARE(expected.size(), qsizetype(60));
+    store.removeUserMessages(4);
+    QCOMPARE(removed.size(), 2);
+    QCOMPARE(removed.at(1).at(0).toStringList(), expected);
+
+    // Sender 3 only has what arrived after their ban left to report
+    QCOMPARE(heldIds(store, 3).size(), qsizetype(16));
+    store.removeMessage("id529");
+    QVERIFY(store.at(529).isDeleted());
+}
+
+QTEST_GUILESS_MAIN(TestChatMessageStore)
+#include "tst_chatmessagestore.moc"
@@ -0,0 +1,145 @@
+#include <QtTest>
+#include "chatsearchindex.h"
+
+namespace {
+const qint64 BaseMs = 1700000000000LL;
+
+// One message per second from alternating senders
+ChatMessage message(int index, const QString& text)
+{
+    return ChatMessage(index % 2 ? "Bob" : "alice", text, 0, QDateTime::fromMSecsSinceEpoch(BaseMs + index * 1000LL));
+}
+
+QDateTime at(int index)
+{
+    return QDateTime::fromMSecsSinceEpoch(BaseMs + index * 1000LL);
+}
+}
+
+class TestChatSearchIndex : public QObject {
+    Q_OBJECT
+
+private slots:
+    void termsMatchNewestFirst();
+    void prefixMergesTerms();
+    void fromMatchesSender();
+    void timeRangeBoundsResults();
+    void limitStopsEarly();
+    void releaseOldestKeepsDocIds();
+};
+
+void TestChatSearchIndex::termsMatchNewestFirst()
+{
+    ChatSearchIndex index;
+    index.addMessage(message(0, "hello world"));
+    index.addMessage(message(1, "Hello, there"));
+    index.addMessage(message(2, "goodbye world"));
+    QTRY_COMPARE(index.size(), 3);
+
+    QCOMPARE(index.search("hello"), QList<quint32>({ 1, 0 }));
+    QCOMPARE(index.search("HELLO,"), QList<quint32>({ 1, 0 }));
+    QCOMPARE(index.search("world"), QList<quint32>({ 2, 0 }));
+    QCOMPARE(index.search("hello world"), QList<quint32>({ 0 }));
+    QVERIFY(index.search("hello missing").isEmpty());
+    QVERIFY(index.search("").isEmpty());
+    QCOMPARE(index.message(1).message(), QString("Hello, there"));
+}
+
+void TestChatSearchIndex::prefixMergesTerms()
+{
+    ChatSearchIndex index;
+    index.addMessage(message(0, "gaming tonight"));
+    index.addMessage(message(1, "game over"));
+    index.addMessage(message(2, "nothing here"));
+    index.addMessage(message(3, "games and gamers games"));
+    index.addMessage(message(4, "gam"));
+    QTRY_COMPARE(index.size(), 5);
+
+    // A document matching several terms of the prefix is returned once
+    QCOMPARE(index.search("gam*"), QList<quint32>({ 4, 3, 1, 0 }));
+    QCOMPARE(index.search("game*"), QList<quint32>({ 3, 1 }));
+    QCOMPARE(index.search("game* over"), QList<quint32>({ 1 }));
+    QVERIFY(index.search("zz*").isEmpty());
+}
+
+void TestChatSearchIndex::fromMatchesSender()
+{
+    ChatSearchIndex index;
+    for (int i = 0; i < 6; ++i) {
+        index.addMessage(message(i, "message " + QString::number(i)));
+    }
+    QTRY_COMPARE(index.size(), 6);
+
+    QCOMPARE(index.search("from:bob"), QList<quint32>({ 5, 3, 1 }));
+    QCOMPARE(index.search("from:@Alice"), QList<quint32>({ 4, 2, 0 }));
+    QCOMPARE(index.search("from:al*"), QList<quint32>({ 4, 2, 0 }));
+    QCOMPARE(index.search("from:bob 3"), QList<quint32>({ 3 }));
+    QVERIFY(index.search("from:carol").isEmpty());
+}
+
+void TestChatSearchIndex::timeRangeBoundsResults()
+{
+    ChatSearchIndex index;
+    for (int i = 0; i < 10; ++i) {
+        index.addMessage(message(i, "tick"));
+    }
+    QTRY_COMPARE(index.size(), 10);
+
+    // Both ends are inclusive
+    QCOMPARE(index.search("tick", at(3), at(6)), QList<quint32>({ 6, 5, 4, 3 }));
+    QCOMPARE(index.search("tick", at(8)), QList<quint32>({ 9, 8 }));
+    QCOMPARE(index.search("tick", QDateTime(), at(1)), QList<quint32>({ 1, 0 }));
+    QCOMPARE(index.search("from:bob", at(2), at(6)), QList<quint32>({ 5, 3 }));
+    QVERIFY(index.search("tick", at(20)).isEmpty());
+    QVERIFY(index.search("tick", at(6), at(3)).isEmpty());
+}
+
+void TestChatSearchIndex::limitStopsEarly()
+{
+    ChatSearchIndex index;
+    for (int i = 0; i < 100; ++i) {
+        index.addMessage(message(i, i % 10 ? "common" : "common rare"));
+    }
+    QTRY_COMPARE(index.size(), 100);
+
+    QCOMPARE(index.search("common", QDateTime(), QDateTime(), 3), QList<quint32>({ 99, 98, 97 }));
+    QCOMPARE(index.search("rare common", QDateTime(), QDateTime(), 3), QList<quint32>({ 90, 80, 70 }));
+    QCOMPARE(index.search("comm* rare", at(25), at(65), 10), QList<quint32>({ 60, 50, 40, 30 }));
+    QVERIFY(index.search("common", QDateTime(), QDateTime(), 0).isEmpty());
+}
+
+void TestChatSearchIndex::releaseOldestKeepsDocIds()
+{
+    ChatSearchIndex index;
+    for (int i = 0; i < 1500; ++i) {
+        index.addMessage(message(i, i < 300 ? "early" : "late " + QString::number(i)));
+    }
+    QTRY_COMPARE(index.size(), 1500);
+    qint64 before = index.memoryUsage();
+
+    // Only documents beyond the newest thousand can go
+    QVERIFY(index.releaseOldest(before * 2) > 0);
+    QCOMPARE(index.size(), 1000);
+    QCOMPARE(index.firstDocId(), quint32(500));
+    QVERIFY(index.memoryUsage() < before);
+    QCOMPARE(index.releaseOldest(before), qint64(0));
+
+    // Released terms are gone; the rest keep their doc IDs
+    QVERIFY(index.search("early").isEmpty());
+    QCOMPARE(index.search("late"), index.search("late", QDateTime(), QDateTime(), 1000).mid(0, 100));
+    QCOMPARE(index.search("late", QDateTime(), QDateTime(), 2000).size(), qsizetype(1000));
+    QCOMPARE(index.search("late", QDateTime(), QDateTime(), 2000).last(), quint32(500));
+    QCOMPARE(index.search("700"), QList<quint32>({ 700 }));
+    QCOMPARE(index.message(700).message(), QString("late 700"));
+    QVERIFY(index.message(499).message().isEmpty());
+    QCOMPARE(index.search("late", at(0), at(600)).last(), quint32(500));
+    QCOMPARE(index.messages(498, 4).size(), qsizetype(2));
+
+    // New documents continue the numbering
+    index.addMessage(message(1500, "after release"));
+    QTRY_COMPARE(index.size(), 1001);
+    QCOMPARE(index.search("after"), QList<quint32>({ 1500 }));
+}
+
+QTEST_GUILESS_MAIN(TestChatSearchIndex)
+#include "tst_chatsearchindex.moc"
@@ -0,0 +1,154 @@
+#include <QtTest>
+#include <cmath>
+#include "chatstatistics.h"
+
+namespace {
+// On a five minute boundary, so every window's slices start here
+const qint64 BaseMs = 1700000100000LL;
+const qint64 Second = 1000;
+const qint64 Minute = 60 * Second;
+
+ChatMessage message(const QString& user, qint64 atMs, const QStringList& emotes = QStringList())
+{
+    ChatMessage message(user, "hi", 0, QDateTime::fromMSecsSinceEpoch(atMs));
+    message.setEmotes(emotes);
+    return message;
+}
+
+void record(ChatStatistics& statistics, const QString& user, int count, qint64 atMs,
+            const QStringList& emotes = QStringList())
+{
+    for (int i = 0; i < count; ++i) {
+        statistics.record(message(user, atMs, emotes));
+    }
+}
+
+QStringList keys(const QList<ChatStatistics::Ranked>& ranked)
+{
+    QStringList result;
+    for (const ChatStatistics::Ranked& item : ranked) {
+        result.append(item.key);
+    }
+    return result;
+}
+}
+
+class TestChatStatistics : public QObject {
+    Q_OBJECT
+
+private slots:
+    void windowsExpireBySlice();
+    void idleGapExpiresEverything();
+    void uniqueChattersWithinError_data();
+    void uniqueChattersWithinError();
+    void topListFollowsExpiry();
+};
+
+void TestChatStatistics::windowsExpireBySlice()
+{
+    ChatStatistics statistics;
+    record(statistics, "alice", 5, BaseMs);
+    record(statistics, "bob", 2, BaseMs + 30 * Second);
+
+    QCOMPARE(statistics.messageCount(ChatStatistics::OneMinute, BaseMs + 30 * Second), qint64(7));
+
+    // A window covers its length plus up to one slice
+    QCOMPARE(statistics.messageCount(ChatStatistics::OneMinute, BaseMs + 69 * Second), qint64(7));
+    QCOMPARE(statistics.messageCount(ChatStatistics::OneMinute, BaseMs + 70 * Second), qint64(2));
+    QCOMPARE(statistics.messageCount(ChatStatistics::OneMinute, BaseMs + 100 * Second), qint64(0));
+
+    QCOMPARE(statistics.messageCount(ChatStatistics::FiveMinutes, BaseMs + 5 * Minute + 59 * Second), qint64(7));
+    QCOMPARE(statistics.messageCount(ChatStatistics::FiveMinutes, BaseMs + 6 * Minute), qint64(0));
+
+    QCOMPARE(statistics.messageCount(ChatStatistics::SixtyMinutes, BaseMs + 64 * Minute), qint64(7));
+    QCOMPARE(statistics.messageCount(ChatStatistics::SixtyMinutes, BaseMs + 65 * Minute), qint64(0));
+}
+
+void TestChatStatistics::idleGapExpiresEverything()
+{
+    ChatStatistics statistics;
+    record(statistics, "alice", 3, BaseMs);
+    record(statistics, "bob", 4, BaseMs + 2 * Second);
+    QCOMPARE(statistics.messagesPerMinute(BaseMs + 5 * Second), qint64(7));
+    QCOMPARE(statistics.messagesPerSecond(BaseMs + 5 * Second), 0.7);
+
+    // Hours without chat, longer than any ring, and nothing is left over
+    qint64 later = BaseMs + 3 * 60 * Minute + 7 * Second;
+    QCOMPARE(statistics.messagesPerMinute(later), qint64(0));
+    QCOMPARE(statistics.messagesPerSecond(later), 0.0);
+    for (int i = 0; i < ChatStatistics::WindowCount; ++i) {
+        ChatStatistics::Window window = static_cast<ChatStatistics::Window>(i);
+        QCOMPARE(statistics.messageCount(window, later), qint64(0));
+        QCOMPARE(statistics.uniqueChatters(window, later), qint64(0));
+        QVERIFY(statistics.topChatters(window, later).isEmpty());
+    }
+
+    // Chat after the gap starts from clean slices
+    record(statistics, "carol", 2, later);
+    QCOMPARE(statistics.messageCount(ChatStatistics::SixtyMinutes, later), qint64(2));
+    QCOMPARE(statistics.uniqueChatters(ChatStatistics::SixtyMinutes, later), qint64(1));
+    QCOMPARE(keys(statistics.topChatters(ChatStatistics::FiveMinutes, later)), QStringList({ "carol" }));
+}
+
+void TestChatStatistics::uniqueChattersWithinError_data()
+{
+    QTest::addColumn<int>("chatters");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+    QTest::newRow("50000") << 50000;
+}
+
+void TestChatStatistics::uniqueChattersWithinError()
+{
+    QFETCH(int, chatters);
+
+    ChatStatistics statistics;
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < chatters; ++i) {
+            statistics.record(message("viewer" + QString::number(i), BaseMs + round * Second));
+        }
+    }
+
+    // 1024 registers give a standard error of 1.04 / sqrt(1024); allow three
+    qint64 estimate = statistics.uniqueChatters(ChatStatistics::FiveMinutes, BaseMs + 3 * Second);
+    double error = std::abs(estimate - chatters) / double(chatters);
+    QVERIFY2(error < 3 * 1.04 / 32, qPrintable(QString("estimated %1").arg(estimate)));
+    QCOMPARE(statistics.uniqueChatters(ChatStatistics::OneMinute, BaseMs + 3 * Second), estimate);
+
+    QCOMPARE(statistics.uniqueChatters(ChatStatistics::OneMinute, BaseMs + 70 * Second), qint64(0));
+    QCOMPARE(statistics.uniqueChatters(ChatStatistics::SixtyMinutes, BaseMs + 70 * Second), estimate);
+}
+
+void TestChatStatistics::topListFollowsExpiry()
+{
+    ChatStatistics statistics;
+    record(statistics, "alice", 10, BaseMs, { "KEKW" });
+    record(statistics, "bob", 5, BaseMs, { "LUL", "KEKW" });
+    record(statistics, "bob", 3, BaseMs + 30 * Second, { "PogU" });
+    record(statistics, "carol", 7, BaseMs + 30 * Second, { "PogU", "LUL" });
+
+    QList<ChatStatistics::Ranked> top = statistics.topChatters(ChatStatistics::OneMinute, BaseMs + 30 * Second);
+    QCOMPARE(keys(top), QStringList({ "alice", "bob", "carol" }));
+    QCOMPARE(top.at(1).count, quint32(8));
+    QCOMPARE(keys(statistics.topEmotes(ChatStatistics::OneMinute, BaseMs + 30 * Second)),
+             QStringList({ "KEKW", "LUL", "PogU" }));
+
+    // The first slice expires: alice drops out and bob falls behind carol
+    top = statistics.topChatters(ChatStatistics::OneMinute, BaseMs + 70 * Second);
+    QCOMPARE(keys(top), QStringList({ "carol", "bob" }));
+    QCOMPARE(top.at(0).count, quint32(7));
+    QCOMPARE(top.at(1).count, quint32(3));
+    QCOMPARE(keys(statistics.topEmotes(ChatStatistics::OneMinute, BaseMs + 70 * Second)),
+             QStringList({ "PogU", "LUL" }));
+
+    // Longer windows still hold the whole session
+    QCOMPARE(keys(statistics.topChatters(ChatStatistics::FiveMinutes, BaseMs + 70 * Second)),
+             QStringList({ "alice", "bob", "carol" }));
+    QVERIFY(statistics.topChatters(ChatStatistics::OneMinute, BaseMs + 100 * Second).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestChatStatistics)
+#include "tst_chatstatistics.moc"
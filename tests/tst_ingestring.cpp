@@ -0,0 +1,291 @@
+#include <QtTest>
+#include <cstring>
+#include <vector>
+#include "ingestring.h"
+
+namespace {
+const int SmallCapacity = 512;
+
+// A segment in ordinary memory; one IngestRing writes, the other reads, like
+// the helper and the GUI do across processes
+class Segment {
+public:
+    explicit Segment(int capacity)
+        : m_memory(IngestRing::segmentSize(capacity) / sizeof(quint64) + 1)
+        , reader(m_memory.data())
+        , writer(m_memory.data())
+    {
+        reader.initialize(capacity);
+    }
+
+    char* bytes() { return reinterpret_cast<char*>(m_memory.data()); }
+
+    // The write position follows the magic and capacity fields
+    void setWritePosition(quint64 position) { std::memcpy(bytes() + 8, &position, sizeof(position)); }
+
+private:
+    std::vector<quint64> m_memory;
+
+public:
+    IngestRing reader;
+    IngestRing writer;
+};
+
+ChatMessage message(const QString& text)
+{
+    ChatMessage message("viewer", text, 0x53fc18, QDateTime::fromMSecsSinceEpoch(1700000000000LL));
+    message.setReceivedAt(QDateTime::fromMSecsSinceEpoch(1700000000500LL));
+    message.setSenderId(77);
+    message.setRoles(ChatMessage::Moderator | ChatMessage::Subscriber);
+    message.setMessageId("id-" + text.left(8));
+    return message;
+}
+
+// The header in front of a payload the reader was handed
+void overwriteHeader(const IngestRing::Record& record, quint32 size, quint32 type)
+{
+    char* header = const_cast<char*>(record.payload) - 2 * sizeof(quint32);
+    std::memcpy(header, &size, sizeof(size));
+    std::memcpy(header + sizeof(size), &type, sizeof(type));
+}
+}
+
+class TestIngestRing : public QObject {
+    Q_OBJECT
+
+private slots:
+    void recordsRoundTrip();
+    void wrapSkipsTailWithPadding();
+    void fullRingDrops();
+    void oversizedRecordDropped();
+    void corruptHeader_data();
+    void corruptHeader();
+    void positionsTooFarApart();
+    void stringPastPayload();
+    void resetRecovers();
+};
+
+void TestIngestRing::recordsRoundTrip()
+{
+    Segment segment(SmallCapacity * 4);
+    QVERIFY(segment.writer.isValid());
+
+    QVERIFY(segment.writer.writeMessage(message("hello chat")));
+    QVERIFY(segment.writer.writeDeleted("deleted-id"));
+    QVERIFY(segment.writer.writeBanned(1234, "spammer"));
+    QVERIFY(segment.writer.writeStatus(IngestRing::Error, "went wrong"));
+
+    IngestRing::Record record;
+    QVERIFY(segment.reader.peek(&record));
+    QCOMPARE(record.type, IngestRing::Message);
+    ChatMessage decoded("", "");
+    QVERIFY(IngestRing::decodeMessage(record, &decoded));
+    ChatMessage expected = message("hello chat");
+    QCOMPARE(decoded.username(), expected.username());
+    QCOMPARE(decoded.message(), expected.message());
+    QCOMPARE(decoded.usernameColor(), expected.usernameColor());
+    QCOMPARE(decoded.timestamp(), expected.timestamp());
+    QCOMPARE(decoded.receivedAt(), expected.receivedAt());
+    QCOMPARE(decoded.senderId(), expected.senderId());
+    QVERIFY(decoded.roles() == expected.roles());
+    QCOMPARE(decoded.messageId(), expected.messageId());
+    segment.reader.release();
+
+    int offset = 0;
+    QString text;
+    QVERIFY(segment.reader.peek(&record));
+    QCOMPARE(record.type, IngestRing::Deleted);
+    QVERIFY(IngestRing::decodeString(record, &offset, &text));
+    QCOMPARE(text, QString("deleted-id"));
+    segment.reader.release();
+
+    offset = 0;
+    qint64 senderId = 0;
+    QVERIFY(segment.reader.peek(&record));
+    QCOMPARE(record.type, IngestRing::Banned);
+    QVERIFY(IngestRing::decodeInt64(record, &offset, &senderId));
+    QVERIFY(IngestRing::decodeString(record, &offset, &text));
+    QCOMPARE(senderId, qint64(1234));
+    QCOMPARE(text, QString("spammer"));
+    segment.reader.release();
+
+    offset = 0;
+    QVERIFY(segment.reader.peek(&record));
+    QCOMPARE(record.type, IngestRing::Error);
+    QVERIFY(IngestRing::decodeString(record, &offset, &text));
+    QCOMPARE(text, QString("went wrong"));
+    segment.reader.release();
+
+    QVERIFY(!segment.reader.peek(&record));
+    QVERIFY(!segment.reader.isCorrupt());
+}
+
+void TestIngestRing::wrapSkipsTailWithPadding()
+{
+    Segment segment(SmallCapacity);
+
+    // Uneven sizes so the wrap point lands inside a record several times
+    int wraps = 0;
+    const char* previous = nullptr;
+    for (int i = 0; i < 60; ++i) {
+        QString text(i * 7 % 70, QChar('a' + i % 26));
+        QVERIFY(segment.writer.writeMessage(message(text)));
+
+        IngestRing::Record record;
+        QVERIFY(segment.reader.peek(&record));
+        ChatMessage decoded("", "");
+        QVERIFY(IngestRing::decodeMessage(record, &decoded));
+        QCOMPARE(decoded.message(), text);
+        if (previous && record.payload < previous) {
+            ++wraps;
+        }
+        previous = record.payload;
+        segment.reader.release();
+    }
+
+    QVERIFY(wraps >= 2);
+    QVERIFY(!segment.reader.isCorrupt());
+    QCOMPARE(segment.writer.droppedCount(), quint64(0));
+}
+
+void TestIngestRing::fullRingDrops()
+{
+    Segment segment(SmallCapacity);
+
+    int written = 0;
+    while (segment.writer.writeMessage(message(QString::number(written)))) {
+        ++written;
+    }
+    QVERIFY(written > 1);
+    QCOMPARE(segment.writer.droppedCount(), quint64(1));
+
+    // Nothing already published is lost, and the oldest comes out first
+    IngestRing::Record record;
+    for (int i = 0; i < written; ++i) {
+        QVERIFY(segment.reader.peek(&record));
+        ChatMessage decoded("", "");
+        QVERIFY(IngestRing::decodeMessage(record, &decoded));
+        QCOMPARE(decoded.message(), QString::number(i));
+        segment.reader.release();
+    }
+    QVERIFY(!segment.reader.peek(&record));
+
+    QVERIFY(segment.writer.writeMessage(message("room again")));
+    QCOMPARE(segment.writer.droppedCount(), quint64(1));
+}
+
+void TestIngestRing::oversizedRecordDropped()
+{
+    Segment segment(SmallCapacity);
+
+    QVERIFY(!segment.writer.writeMessage(message(QString(SmallCapacity, 'x'))));
+    QCOMPARE(segment.writer.droppedCount(), quint64(1));
+
+    IngestRing::Record record;
+    QVERIFY(!segment.reader.peek(&record));
+}
+
+void TestIngestRing::corruptHeader_data()
+{
+    QTest::addColumn<quint32>("size");
+    QTest::addColumn<quint32>("type");
+
+    QTest::newRow("empty padding") << quint32(0) << quint32(IngestRing::Padding);
+    QTest::newRow("empty message") << quint32(0) << quint32(IngestRing::Message);
+    QTest::newRow("shorter than header") << quint32(4) << quint32(IngestRing::Message);
+    QTest::newRow("unaligned") << quint32(44) << quint32(IngestRing::Message);
+    QTest::newRow("past the end") << quint32(SmallCapacity + 8) << quint32(IngestRing::Padding);
+    QTest::newRow("past the write position") << quint32(SmallCapacity / 2) << quint32(IngestRing::Message);
+    QTest::newRow("huge") << quint32(0xFFFFFFF8) << quint32(IngestRing::Message);
+    QTest::newRow("unknown type") << quint32(64) << quint32(99);
+}
+
+void TestIngestRing::corruptHeader()
+{
+    QFETCH(quint32, size);
+    QFETCH(quint32, type);
+
+    Segment segment(SmallCapacity);
+    QVERIFY(segment.writer.writeMessage(message("hello")));
+
+    IngestRing::Record record;
+    QVERIFY(segment.reader.peek(&record));
+    overwriteHeader(record, size, type);
+
+    // Refused straight away instead of looping or reading out of bounds
+    QVERIFY(!segment.reader.peek(&record));
+    QVERIFY(segment.reader.isCorrupt());
+    QVERIFY(!segment.reader.peek(&record));
+}
+
+void TestIngestRing::positionsTooFarApart()
+{
+    Segment segment(SmallCapacity);
+    QVERIFY(segment.writer.writeMessage(message("hello")));
+    segment.setWritePosition(SmallCapacity * 3);
+
+    IngestRing::Record record;
+    QVERIFY(!segment.reader.peek(&record));
+    QVERIFY(segment.reader.isCorrupt());
+}
+
+void TestIngestRing::stringPastPayload()
+{
+    Segment segment(SmallCapacity);
+    QVERIFY(segment.writer.writeMessage(message("hello")));
+    QVERIFY(segment.writer.writeDeleted("deleted-id"));
+
+    // The username length follows three 64-bit and two 32-bit fields
+    IngestRing::Record record;
+    QVERIFY(segment.reader.peek(&record));
+    quint32 length = 0x7FFFFFFF;
+    std::memcpy(const_cast<char*>(record.payload) + 32, &length, sizeof(length));
+    ChatMessage decoded("", "");
+    QVERIFY(!IngestRing::decodeMessage(record, &decoded));
+
+    // One character too many for the payload
+    length = 6;
+    std::memcpy(const_cast<char*>(record.payload) + 32, &length, sizeof(length));
+    QVERIFY(IngestRing::decodeMessage(record, &decoded));
+    length = quint32(record.payloadSize);
+    std::memcpy(const_cast<char*>(record.payload) + 32, &length, sizeof(length));
+    QVERIFY(!IngestRing::decodeMessage(record, &decoded));
+    segment.reader.release();
+
+    QVERIFY(segment.reader.peek(&record));
+    int offset = record.payloadSize - 2;
+    QString text;
+    QVERIFY(!IngestRing::decodeString(record, &offset, &text));
+    offset = record.payloadSize - 4;
+    qint64 value;
+    QVERIFY(!IngestRing::decodeInt64(record, &offset, &value));
+}
+
+void TestIngestRing::resetRecovers()
+{
+    Segment segment(SmallCapacity);
+    QVERIFY(segment.writer.writeMessage(message("hello")));
+    QVERIFY(segment.writer.writeMessage(message("world")));
+
+    IngestRing::Record record;
+    QVERIFY(segment.reader.peek(&record));
+    overwriteHeader(record, 0, IngestRing::Padding);
+    QVERIFY(!segment.reader.peek(&record));
+    QVERIFY(segment.reader.isCorrupt());
+
+    // What was left is dropped and a new writer starts from an empty ring
+    segment.reader.reset();
+    QVERIFY(!segment.reader.isCorrupt());
+    QVERIFY(!segment.reader.peek(&record));
+
+    IngestRing writer(segment.bytes());
+    QVERIFY(writer.isValid());
+    QVERIFY(writer.writeMessage(message("after restart")));
+    QVERIFY(segment.reader.peek(&record));
+    ChatMessage decoded("", "");
+    QVERIFY(IngestRing::decodeMessage(record, &decoded));
+    QCOMPARE(decoded.message(), QString("after restart"));
+}
+
+QTEST_GUILESS_MAIN(TestIngestRing)
+#include "tst_ingestring.moc"
@@ -0,0 +1,121 @@
+#include <QtTest>
+#include <algorithm>
+#include "messagepipeline.h"
+#include "preparestages.h"
+
+namespace {
+// Drops every message from a given user
+class DropStage {
+public:
+    explicit DropStage(const QString& username = QString())
+        : m_username(username)
+    {
+    }
+
+    static const char* name() { return "drop"; }
+
+    void process(QList<ChatMessage>& batch)
+    {
+        batch.erase(std::remove_if(batch.begin(), batch.end(), [this](const ChatMessage& message) {
+                        return message.username() == m_username;
+                    }),
+                    batch.end());
+    }
+
+private:
+    QString m_username;
+};
+
+class CountStage {
+public:
+    static const char* name() { return "count"; }
+
+    void process(QList<ChatMessage>& batch) { count += int(batch.size()); }
+
+    int count = 0;
+};
+}
+
+class TestMessagePipeline : public QObject {
+    Q_OBJECT
+
+private slots:
+    void prepareSanitizes();
+    void prepareTokenizesEmotes();
+    void stagesRunInOrderAndDropEnds();
+    void timingsAdd();
+};
+
+void TestMessagePipeline::prepareSanitizes()
+{
+    QList<ChatMessage> batch;
+    batch.append(ChatMessage(QString("mod") + QChar(0x202E) + "erator", QString(600, 'a')));
+    const QString clean("nothing to do here");
+    batch.append(ChatMessage("viewer", clean));
+
+    PreparePipeline pipeline;
+    pipeline.process(batch);
+
+    QCOMPARE(batch.at(0).username(), QString("moderator"));
+    QCOMPARE(batch.at(0).message().size(), qsizetype(501));
+    // Clean text is not copied
+    QVERIFY(batch.at(1).message().constData() == clean.constData());
+}
+
+void TestMessagePipeline::prepareTokenizesEmotes()
+{
+    QList<ChatMessage> batch;
+    batch.append(ChatMessage("viewer", "hi [emote:37226:KEKW] [emote:1:] and [emote:39261:Pog]"));
+    batch.append(ChatMessage("viewer", "no emotes, just [brackets]"));
+    batch.append(ChatMessage("viewer", "broken [emote:12"));
+
+    PreparePipeline pipeline;
+    pipeline.process(batch);
+
+    QCOMPARE(batch.at(0).emotes(), QStringList({ "KEKW", "Pog" }));
+    QVERIFY(batch.at(1).emotes().isEmpty());
+    QVERIFY(batch.at(2).emotes().isEmpty());
+}
+
+void TestMessagePipeline::stagesRunInOrderAndDropEnds()
+{
+    MessagePipeline<DropStage, CountStage> pipeline(DropStage("spammer"), CountStage());
+
+    QList<ChatMessage> batch;
+    batch.append(ChatMessage("spammer", "buy followers"));
+    batch.append(ChatMessage("viewer", "hello"));
+    pipeline.process(batch);
+    QCOMPARE(batch.size(), qsizetype(1));
+    QCOMPARE(pipeline.stage<1>().count, 1);
+
+    // Nothing left after the first stage: the second does not run at all
+    QList<ChatMessage> spam;
+    spam.append(ChatMessage("spammer", "buy followers"));
+    pipeline.process(spam);
+    QVERIFY(spam.isEmpty());
+
+    QList<StageTiming> timings = pipeline.timings();
+    QCOMPARE(timings.at(0).batches, qint64(2));
+    QCOMPARE(timings.at(0).messagesIn, qint64(3));
+    QCOMPARE(timings.at(0).messagesOut, qint64(1));
+    QCOMPARE(timings.at(1).batches, qint64(1));
+}
+
+void TestMessagePipeline::timingsAdd()
+{
+    PreparePipeline live;
+    PreparePipeline history;
+
+    QList<ChatMessage> batch;
+    batch.append(ChatMessage("viewer", "one"));
+    live.process(batch);
+    batch.append(ChatMessage("viewer", "two"));
+    history.process(batch);
+
+    live.addTimings(history.timings());
+    QCOMPARE(live.timings().at(0).batches, qint64(2));
+    QCOMPARE(live.timings().at(1).messagesIn, qint64(3));
+}
+
+QTEST_GUILESS_MAIN(TestMessagePipeline)
+#include "tst_messagepipeline.moc"
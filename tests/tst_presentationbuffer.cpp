@@ -0,0 +1,133 @@
+#include <QtTest>
+#include <memory>
+#include "virtualclock.h"
+#include "presentationbuffer.h"
+#include "admissioncontroller.h"
+
+namespace {
+const qint64 StartMs = 1700000000000LL;
+const int TickMs = 250;
+
+QList<ChatMessage> burst(int count, qint64 timestampMs)
+{
+    QList<ChatMessage> messages;
+    for (int i = 0; i < count; ++i) {
+        messages.append(ChatMessage("viewer", QString("message %1").arg(i), 0xFFFFFF,
+                                    QDateTime::fromMSecsSinceEpoch(timestampMs)));
+    }
+    return messages;
+}
+}
+
+class TestPresentationBuffer : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void burstIsSpreadOverDelay();
+    void bufferedBurstIsAdmitted();
+    void unbufferedBurstIsSampled();
+
+private:
+    std::unique_ptr<VirtualClock> m_clock;
+};
+
+void TestPresentationBuffer::init()
+{
+    m_clock.reset(new VirtualClock(StartMs));
+    Clock::setInstance(m_clock.get());
+}
+
+void TestPresentationBuffer::cleanup()
+{
+    Clock::setInstance(nullptr);
+    m_clock.reset();
+}
+
+void TestPresentationBuffer::burstIsSpreadOverDelay()
+{
+    PresentationBuffer buffer;
+    buffer.setDelay(1000);
+    for (const ChatMessage& message : burst(40, StartMs)) {
+        buffer.push(message, m_clock->nowMs());
+    }
+
+    QList<int> released;
+    ClockTimer tick;
+    connect(&tick, &ClockTimer::timeout, this, [&]() {
+        released.append(int(buffer.takeDue(m_clock->nowMs(), 0).size()));
+    });
+    buffer.takeDue(m_clock->nowMs(), 0);
+    tick.start(TickMs);
+    m_clock->advance(PresentationBuffer::MaxLatencyFactor * 1000);
+
+    // The first tick gets its even share of one delay (40 over four ticks),
+    // later ticks no more, and nothing waits past the latency bound
+    QCOMPARE(released.first(), 10);
+    int total = 0;
+    for (int count : released) {
+        QVERIFY(count <= released.first());
+        total += count;
+    }
+    QCOMPARE(total, 40);
+    QCOMPARE(buffer.size(), 0);
+}
+
+void TestPresentationBuffer::bufferedBurstIsAdmitted()
+{
+    // What the overlay does each display tick: release at the render budget,
+    // then admit at presentation time
+    PresentationBuffer buffer;
+    buffer.setDelay(1000);
+    AdmissionController admission;
+    admission.setMaxRate(20);
+
+    // One clump, all stamped by the server in the same instant
+    for (const ChatMessage& message : burst(40, StartMs - 300)) {
+        buffer.push(message, m_clock->nowMs());
+    }
+
+    int admitted = 0;
+    QList<qint64> releasedAt;
+    ClockTimer tick;
+    connect(&tick, &ClockTimer::timeout, this, [&]() {
+        const qint64 nowMs = Clock::instance()->nowMs();
+        for (const ChatMessage& message : buffer.takeDue(nowMs, admission.admitRate())) {
+            releasedAt.append(nowMs);
+            if (admission.admit(message, nowMs)) {
+                ++admitted;
+            }
+        }
+        admission.tick(nowMs);
+    });
+    buffer.takeDue(m_clock->nowMs(), admission.admitRate());
+    tick.start(TickMs);
+    m_clock->advance(3000);
+
+    // Released at the admission rate, so the bucket keeps up with all of it
+    QCOMPARE(buffer.size(), 0);
+    QCOMPARE(admitted, 40);
+    QCOMPARE(admission.suppressedCount(), quint64(0));
+    QVERIFY(releasedAt.last() - releasedAt.first() >= 1500);
+}
+
+void TestPresentationBuffer::unbufferedBurstIsSampled()
+{
+    AdmissionController admission;
+    admission.setMaxRate(20);
+
+    // The same clump presented in one go only gets one second's worth of tokens
+    int admitted = 0;
+    for (const ChatMessage& message : burst(40, StartMs)) {
+        if (admission.admit(message, m_clock->nowMs())) {
+            ++admitted;
+        }
+    }
+    QCOMPARE(admitted, 20);
+    QCOMPARE(admission.suppressedCount(), quint64(20));
+}
+
+QTEST_GUILESS_MAIN(TestPresentationBuffer)
+#include "tst_presentationbuffer.moc"
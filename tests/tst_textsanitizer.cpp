@@ -0,0 +1,217 @@
+#include <QtTest>
+#include <QRandomGenerator>
+#include "textsanitizer.h"
+
+namespace {
+const QLatin1String ZeroWidthSpace("&#8203;");
+
+// What the vectorized pre-checks must agree with, one unit at a time
+bool needsSanitizingScalar(const QString& text, int maxLength)
+{
+    if (text.size() > maxLength) {
+        return true;
+    }
+    for (QChar c : text) {
+        if (c.unicode() < 0x20 || c.unicode() > 0x7E) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool needsEscapingScalar(const QString& text)
+{
+    int run = 0;
+    for (QChar c : text) {
+        if (c == '&' || c == '<' || c == '>' || c == '"' || c == '\'') {
+            return true;
+        }
+        run = c == ' ' ? 0 : run + 1;
+        if (run > 30) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The fast path hands back the input itself
+bool returnedInput(const QString& input, const QString& output)
+{
+    return input.constData() == output.constData();
+}
+}
+
+class TestTextSanitizer : public QObject {
+    Q_OBJECT
+
+private slots:
+    void cleanTextIsReturnedAsIs();
+    void lineBreaksAndControls();
+    void bidiAndFormatCharactersStripped();
+    void zalgoCapped();
+    void truncation();
+    void truncationKeepsSurrogatePairs();
+    void loneSurrogateReplaced();
+    void escapesEntities();
+    void breaksLongRuns();
+    void breaksKeepGraphemes_data();
+    void breaksKeepGraphemes();
+    void sanitizeFastPathMatchesScalar();
+    void escapeFastPathMatchesScalar();
+};
+
+void TestTextSanitizer::cleanTextIsReturnedAsIs()
+{
+    const QString message("hello chat, this is a perfectly ordinary message");
+    QVERIFY(returnedInput(message, TextSanitizer::sanitize(message)));
+    QVERIFY(returnedInput(message, TextSanitizer::escapeHtml(message)));
+}
+
+void TestTextSanitizer::lineBreaksAndControls()
+{
+    QCOMPARE(TextSanitizer::sanitize(QString("a\tb\nc\r\nd")), QString("a b c  d"));
+    QCOMPARE(TextSanitizer::sanitize(QString("a") + QChar(0x2028) + "b"), QString("a b"));
+    QCOMPARE(TextSanitizer::sanitize(QString("a") + QChar(0x01) + QChar(0x7F) + QChar(0x85) + "b"), QString("ab"));
+}
+
+void TestTextSanitizer::bidiAndFormatCharactersStripped()
+{
+    QString text = QString("abc") + QChar(0x202E) + "def" + QChar(0x2066) + "x" + QChar(0x2069)
+        + QChar(0x200F) + QChar(0xFEFF) + "y";
+    QCOMPARE(TextSanitizer::sanitize(text), QString("abcdefxy"));
+
+    // Joiners shape emoji and scripts, they stay
+    QString joined = QString("a") + QChar(0x200D) + "b" + QChar(0x200C) + "c";
+    QCOMPARE(TextSanitizer::sanitize(joined), joined);
+}
+
+void TestTextSanitizer::zalgoCapped()
+{
+    const QChar acute(0x0301);
+    QString text = QString("a") + QString(10, acute) + "b" + QString(6, acute) + "c" + QString(2, acute);
+    QString expected = QString("a") + QString(4, acute) + "b" + QString(4, acute) + "c" + QString(2, acute);
+    QCOMPARE(TextSanitizer::sanitize(text), expected);
+}
+
+void TestTextSanitizer::truncation()
+{
+    QString result = TextSanitizer::sanitize(QString(600, 'a'));
+    QCOMPARE(result.size(), qsizetype(501));
+    QVERIFY(result.startsWith(QString(500, 'a')));
+    QCOMPARE(result.back(), QChar(0x2026));
+
+    QCOMPARE(TextSanitizer::sanitize(QString(64, 'u'), 64), QString(64, 'u'));
+    QCOMPARE(TextSanitizer::sanitize(QString(65, 'u'), 64), QString(64, 'u') + QChar(0x2026));
+}
+
+void TestTextSanitizer::truncationKeepsSurrogatePairs()
+{
+    // The emoji would end one unit past the limit; it goes whole
+    QString text = QString(499, 'a') + QString::fromUtf8("\xF0\x9F\x98\x80") + "b";
+    QCOMPARE(TextSanitizer::sanitize(text, 500), QString(499, 'a') + QChar(0x2026));
+}
+
+void TestTextSanitizer::loneSurrogateReplaced()
+{
+    QString text = QString("a") + QChar(0xD83D) + "b" + QChar(0xDE00);
+    QCOMPARE(TextSanitizer::sanitize(text), QString("a") + QChar(0xFFFD) + "b" + QChar(0xFFFD));
+}
+
+void TestTextSanitizer::escapesEntities()
+{
+    QCOMPARE(TextSanitizer::escapeHtml(QString("<b>&\"'")), QString("&lt;b&gt;&amp;&quot;&#39;"));
+}
+
+void TestTextSanitizer::breaksLongRuns()
+{
+    QString result = TextSanitizer::escapeHtml(QString(70, 'x'));
+    QCOMPARE(result.count(ZeroWidthSpace), qsizetype(2));
+    QCOMPARE(QString(result).remove(ZeroWidthSpace), QString(70, 'x'));
+
+    // Spaces reset the run
+    QString words = QString(30, 'x') + " " + QString(30, 'y');
+    QVERIFY(returnedInput(words, TextSanitizer::escapeHtml(words)));
+}
+
+void TestTextSanitizer::breaksKeepGraphemes_data()
+{
+    QTest::addColumn<QString>("cluster");
+    QTest::addColumn<int>("lead");
+
+    // lead puts a unit inside the cluster at the point a naive break would land
+    QTest::newRow("skin tone") << QString::fromUtf8("\xF0\x9F\x91\x8D\xF0\x9F\x8F\xBD") << 28;
+    QTest::newRow("zwj family") << QString::fromUtf8("\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7") << 29;
+    QTest::newRow("vs16") << QString::fromUtf8("\xE2\x9D\xA4\xEF\xB8\x8F") << 29;
+    QTest::newRow("keycap") << QString::fromUtf8("1\xEF\xB8\x8F\xE2\x83\xA3") << 29;
+    QTest::newRow("flag") << QString::fromUtf8("\xF0\x9F\x87\xA9\xF0\x9F\x87\xAA") << 28;
+    QTest::newRow("combining") << QString::fromUtf8("e\xCC\x81\xCC\x82") << 29;
+}
+
+void TestTextSanitizer::breaksKeepGraphemes()
+{
+    QFETCH(QString, cluster);
+    QFETCH(int, lead);
+
+    QString text = QString(lead, 'a') + cluster + QString(10, 'b');
+    QString result = TextSanitizer::escapeHtml(text);
+
+    QVERIFY2(result.contains(cluster), qPrintable(result));
+    QVERIFY(result.contains(ZeroWidthSpace));
+    QCOMPARE(QString(result).remove(ZeroWidthSpace), text);
+}
+
+void TestTextSanitizer::sanitizeFastPathMatchesScalar()
+{
+    // Every lane of several vector blocks plus the scalar tail, with units
+    // just inside and just outside printable ASCII
+    const QList<char16_t> units = { 0x00, 0x1F, 0x20, 0x7E, 0x7F, 0x80, 0xE9, 0x7FFF, 0x8000, 0xFFFF };
+    for (int size = 1; size <= 40; ++size) {
+        for (int position = 0; position < size; ++position) {
+            for (char16_t unit : units) {
+                QString text(size, 'a');
+                text[position] = QChar(unit);
+                bool expected = !needsSanitizingScalar(text, 500);
+                QVERIFY2(returnedInput(text, TextSanitizer::sanitize(text)) == expected,
+                         qPrintable(QString("size %1 position %2 unit %3").arg(size).arg(position).arg(uint(unit), 0, 16)));
+            }
+        }
+    }
+}
+
+void TestTextSanitizer::escapeFastPathMatchesScalar()
+{
+    const QList<char16_t> specials = { '&', '<', '>', '"', '\'' };
+    for (int size = 1; size <= 40; ++size) {
+        for (int position = 0; position < size; ++position) {
+            for (char16_t unit : specials) {
+                QString text(size, ' ');
+                text[position] = QChar(unit);
+                QVERIFY(!returnedInput(text, TextSanitizer::escapeHtml(text)));
+            }
+        }
+    }
+
+    // Random spacing exercises runs that cross block boundaries
+    QRandomGenerator random(39);
+    for (int iteration = 0; iteration < 20000; ++iteration) {
+        int size = random.bounded(0, 97);
+        int spaceOdds = random.bounded(2, 40);
+        QString text;
+        for (int i = 0; i < size; ++i) {
+            int roll = random.bounded(1000);
+            if (roll < 2) {
+                text += QChar('<');
+            } else if (roll % spaceOdds == 0) {
+                text += QChar(' ');
+            } else {
+                text += QChar('a' + roll % 26);
+            }
+        }
+
+        bool expected = !needsEscapingScalar(text);
+        QVERIFY2(returnedInput(text, TextSanitizer::escapeHtml(text)) == expected, qPrintable(text));
+    }
+}
+
+QTEST_GUILESS_MAIN(TestTextSanitizer)
+#include "tst_textsanitizer.moc"
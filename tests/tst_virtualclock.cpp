@@ -0,0 +1,230 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QSettings>
+#include <QNetworkAccessManager>
+#include <memory>
+#include "virtualclock.h"
+#include "kickchatclient.h"
+#include "chatroomresolver.h"
+
+namespace {
+const qint64 StartMs = 1700000000000LL;
+
+// Never touches the network; the test decides when it connects or fails
+class FakeTransport : public ChatTransport {
+public:
+    int openCount = 0;
+    bool connectedState = false;
+
+    void open(const QUrl&) override { ++openCount; }
+    void close() override { connectedState = false; }
+    bool isConnected() const override { return connectedState; }
+    void sendText(const QByteArray&) override {}
+    QString errorString() const override { return QString(); }
+};
+
+// Answers every request with one JSON body, then closes
+class JsonServer : public QTcpServer {
+public:
+    explicit JsonServer(const QByteArray& body)
+        : m_body(body)
+    {
+        connect(this, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket* socket = nextPendingConnection()) {
+                connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() {
+                    QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+                    socket->setProperty("request", request);
+                    if (!request.contains("\r\n\r\n")) {
+                        return;
+                    }
+                    socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n"
+                                  "Content-Length: " + QByteArray::number(m_body.size()) + "\r\n\r\n" + m_body);
+                    socket->disconnectFromHost();
+                });
+                connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            }
+        });
+    }
+
+private:
+    QByteArray m_body;
+};
+}
+
+class TestVirtualClock : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void timersFireInDueOrder();
+    void reconnectBacksOff();
+    void reconnectGivesUp();
+    void chatroomEntryExpires();
+    void chatroomNotPersistedWhenVirtual();
+
+private:
+    QTemporaryDir m_settingsDir;
+    std::unique_ptr<VirtualClock> m_clock;
+};
+
+void TestVirtualClock::initTestCase()
+{
+    // Keep the real settings file out of it
+    QVERIFY(m_settingsDir.isValid());
+    QSettings::setDefaultFormat(QSettings::IniFormat);
+    QSettings::setPath(QSettings::IniFormat, QSettings::UserScope, m_settingsDir.path());
+}
+
+void TestVirtualClock::init()
+{
+    QSettings("KickChatOverlay", "Settings").clear();
+
+    // Installed before anything creates a ClockTimer
+    m_clock.reset(new VirtualClock(StartMs));
+    Clock::setInstance(m_clock.get());
+}
+
+void TestVirtualClock::cleanup()
+{
+    Clock::setInstance(nullptr);
+    m_clock.reset();
+}
+
+void TestVirtualClock::timersFireInDueOrder()
+{
+    ClockTimer late;
+    late.setSingleShot(true);
+    ClockTimer repeating;
+    QList<QPair<QString, qint64>> fired;
+    connect(&late, &ClockTimer::timeout, this, [&]() { fired.append(qMakePair(QString("late"), m_clock->nowMs())); });
+    connect(&repeating, &ClockTimer::timeout, this, [&]() { fired.append(qMakePair(QString("repeat"), m_clock->nowMs())); });
+
+    late.start(250);
+    repeating.start(100);
+    m_clock->advance(300);
+
+    QCOMPARE(fired.size(), 4);
+    QCOMPARE(fired.at(0), qMakePair(QString("repeat"), StartMs + 100));
+    QCOMPARE(fired.at(1), qMakePair(QString("repeat"), StartMs + 200));
+    QCOMPARE(fired.at(2), qMakePair(QString("late"), StartMs + 250));
+    QCOMPARE(fired.at(3), qMakePair(QString("repeat"), StartMs + 300));
+    QCOMPARE(m_clock->nowMs(), StartMs + 300);
+    QVERIFY(!late.isActive());
+}
+
+void TestVirtualClock::reconnectBacksOff()
+{
+    KickChatClient client;
+    client.setApiBaseUrl(QUrl("http://127.0.0.1:1"));
+    FakeTransport* transport = new FakeTransport;
+    client.setTransport(transport);
+
+    client.connectToChannel("somechannel");
+    QCOMPARE(transport->openCount, 1);
+
+    // Each failure waits twice as long as the one before
+    const int delays[] = { 1000, 2000, 4000, 8000, 16000 };
+    for (int attempt = 0; attempt < 5; ++attempt) {
+        emit transport->errorOccurred("connection refused");
+
+        m_clock->advance(delays[attempt] - 1);
+        QCOMPARE(transport->openCount, attempt + 1);
+        m_clock->advance(1);
+        QCOMPARE(transport->openCount, attempt + 2);
+    }
+
+    // A connection that comes up starts the backoff over
+    transport->connectedState = true;
+    emit transport->connected();
+    transport->connectedState = false;
+    emit transport->disconnected();
+    m_clock->advance(1000);
+    QCOMPARE(transport->openCount, 7);
+}
+
+void TestVirtualClock::reconnectGivesUp()
+{
+    KickChatClient client;
+    client.setApiBaseUrl(QUrl("http://127.0.0.1:1"));
+    FakeTransport* transport = new FakeTransport;
+    client.setTransport(transport);
+    QSignalSpy errors(&client, &KickChatClient::error);
+
+    client.connectToChannel("somechannel");
+    for (int attempt = 0; attempt < 5; ++attempt) {
+        emit transport->errorOccurred("connection refused");
+        while (transport->openCount < attempt + 2) {
+            QVERIFY(m_clock->advanceToNextTimer());
+        }
+    }
+    QCOMPARE(transport->openCount, 6);
+
+    emit transport->errorOccurred("connection refused");
+    QVERIFY(errors.last().first().toString().contains("Maximum reconnection attempts"));
+
+    // An hour later nothing has been retried
+    m_clock->advance(60 * 60 * 1000);
+    QCOMPARE(transport->openCount, 6);
+}
+
+void TestVirtualClock::chatroomEntryExpires()
+{
+    {
+        QVariantMap values;
+        values.insert("id", 42);
+        values.insert("resolvedAt", StartMs - 1000);
+        QVariantMap stored;
+        stored.insert("somechannel", values);
+        QSettings("KickChatOverlay", "Settings").setValue("chatrooms", stored);
+    }
+
+    QNetworkAccessManager networkManager;
+    ChatroomResolver resolver(&networkManager);
+    resolver.setTtl(60 * 1000);
+
+    bool stale = true;
+    QCOMPARE(resolver.cachedChatroomId("SomeChannel", &stale), qint64(42));
+    QVERIFY(!stale);
+
+    m_clock->advance(59 * 1000 - 1);
+    QCOMPARE(resolver.cachedChatroomId("somechannel", &stale), qint64(42));
+    QVERIFY(!stale);
+
+    // Still returned once stale; the caller revalidates it
+    m_clock->advance(1);
+    QCOMPARE(resolver.cachedChatroomId("somechannel", &stale), qint64(42));
+    QVERIFY(stale);
+}
+
+void TestVirtualClock::chatroomNotPersistedWhenVirtual()
+{
+    JsonServer server("{\"chatroom\":{\"id\":7}}");
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QNetworkAccessManager networkManager;
+    ChatroomResolver resolver(&networkManager);
+    resolver.setApiBaseUrl(QUrl(QString("http://127.0.0.1:%1").arg(server.serverPort())));
+    QSignalSpy resolved(&resolver, &ChatroomResolver::resolved);
+
+    resolver.resolve("somechannel");
+    QVERIFY(resolved.wait(5000));
+    QCOMPARE(resolver.cachedChatroomId("somechannel"), qint64(7));
+    QVERIFY(!QSettings("KickChatOverlay", "Settings").value("chatrooms").toMap().contains("somechannel"));
+
+    // With the wall clock the same lookup is kept for the next run
+    Clock::setInstance(nullptr);
+    ChatroomResolver wallClockResolver(&networkManager);
+    wallClockResolver.setApiBaseUrl(QUrl(QString("http://127.0.0.1:%1").arg(server.serverPort())));
+    QSignalSpy wallClockResolved(&wallClockResolver, &ChatroomResolver::resolved);
+    wallClockResolver.resolve("otherchannel");
+    QVERIFY(wallClockResolved.wait(5000));
+    QVERIFY(QSettings("KickChatOverlay", "Settings").value("chatrooms").toMap().contains("otherchannel"));
+}
+
+QTEST_GUILESS_MAIN(TestVirtualClock)
+#include "tst_virtualclock.moc"
@@ -0,0 +1,275 @@
+#include <QtTest>
+#include <zlib.h>
+#include <cstring>
+#include "websocketframereader.h"
+
+namespace {
+enum Opcode {
+    Continuation = 0x0,
+    Text = 0x1,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA
+};
+
+// Server-to-client frame (unmasked unless a mask key is given)
+QByteArray frame(int opcode, const QByteArray& payload, bool fin = true, bool rsv1 = false,
+                 const QByteArray& mask = QByteArray())
+{
+    QByteArray out;
+    out.append(static_cast<char>((fin ? 0x80 : 0) | (rsv1 ? 0x40 : 0) | opcode));
+
+    char maskBit = mask.isEmpty() ? 0 : static_cast<char>(0x80);
+    quint64 length = payload.size();
+    if (length < 126) {
+        out.append(static_cast<char>(maskBit | length));
+    } else if (length < 65536) {
+        out.append(static_cast<char>(maskBit | 126));
+        out.append(static_cast<char>(length >> 8));
+        out.append(static_cast<char>(length & 0xFF));
+    } else {
+        out.append(static_cast<char>(maskBit | 127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out.append(static_cast<char>((length >> shift) & 0xFF));
+        }
+    }
+
+    if (mask.isEmpty()) {
+        return out + payload;
+    }
+    out += mask;
+    for (int i = 0; i < payload.size(); ++i) {
+        out.append(payload.at(i) ^ mask.at(i & 3));
+    }
+    return out;
+}
+
+// permessage-deflate sender with context takeover
+class Deflater {
+public:
+    Deflater()
+    {
+        std::memset(&m_stream, 0, sizeof(m_stream));
+        deflateInit2(&m_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    }
+    ~Deflater() { deflateEnd(&m_stream); }
+
+    QByteArray compress(const QByteArray& message)
+    {
+        QByteArray out(static_cast<int>(deflateBound(&m_stream, message.size())) + 16, Qt::Uninitialized);
+        m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(message.constData()));
+        m_stream.avail_in = static_cast<uInt>(message.size());
+        m_stream.next_out = reinterpret_cast<Bytef*>(out.data());
+        m_stream.avail_out = static_cast<uInt>(out.size());
+        deflate(&m_stream, Z_SYNC_FLUSH);
+        out.resize(out.size() - static_cast<int>(m_stream.avail_out));
+        out.chop(4); // RFC 7692 strips the 00 00 ff ff tail
+        return out;
+    }
+
+private:
+    z_stream m_stream;
+};
+}
+
+class TestWebSocketFrameReader : public QObject {
+    Q_OBJECT
+
+private slots:
+    void wholeTextFrame();
+    void extendedLengths();
+    void multipleFramesInOneRead();
+    void frameSplitAcrossReads();
+    void fragmentedMessageWithInterleavedPing();
+    void maskedFrame();
+    void compressedMessagesShareContext();
+    void compressedFragmentedMessage();
+    void closeFrame();
+    void rsv1OnControlFrame();
+    void rsv1WithoutNegotiation();
+    void fragmentedControlFrame();
+    void oversizedControlFrame();
+    void unexpectedContinuation();
+    void newMessageInsideFragmentedOne();
+};
+
+void TestWebSocketFrameReader::wholeTextFrame()
+{
+    WebSocketFrameReader reader;
+    reader.append(frame(Text, "hello"));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), QByteArray("hello"));
+    QCOMPARE(reader.next(), WebSocketFrameReader::NeedMore);
+}
+
+void TestWebSocketFrameReader::extendedLengths()
+{
+    WebSocketFrameReader reader;
+    QByteArray medium(300, 'm');
+    QByteArray large(70000, 'l');
+    reader.append(frame(Text, medium));
+    reader.append(frame(Text, large));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), medium);
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), large);
+}
+
+void TestWebSocketFrameReader::multipleFramesInOneRead()
+{
+    WebSocketFrameReader reader;
+    reader.append(frame(Text, "one") + frame(Pong, "") + frame(Text, "two"));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), QByteArray("one"));
+    QCOMPARE(reader.next(), WebSocketFrameReader::Pong);
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), QByteArray("two"));
+    QCOMPARE(reader.next(), WebSocketFrameReader::NeedMore);
+}
+
+void TestWebSocketFrameReader::frameSplitAcrossReads()
+{
+    WebSocketFrameReader reader;
+    QByteArray bytes = frame(Text, QByteArray(200, 'x'));
+
+    // One byte per read, including through the 16-bit length field
+    for (int i = 0; i < bytes.size() - 1; ++i) {
+        reader.append(bytes.constData() + i, 1);
+        QCOMPARE(reader.next(), WebSocketFrameReader::NeedMore);
+    }
+    reader.append(bytes.constData() + bytes.size() - 1, 1);
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), QByteArray(200, 'x'));
+}
+
+void TestWebSocketFrameReader::fragmentedMessageWithInterleavedPing()
+{
+    WebSocketFrameReader reader;
+    reader.append(frame(Text, "Hel", false));
+    QCOMPARE(reader.next(), WebSocketFrameReader::NeedMore);
+
+    // Control frames may arrive between fragments
+    reader.append(frame(Ping, "p") + frame(Continuation, "lo ", false));
+    QCOMPARE(reader.next(), WebSocketFrameReader::Ping);
+    QCOMPARE(reader.payload(), QByteArray("p"));
+    QCOMPARE(reader.next(), WebSocketFrameReader::NeedMore);
+
+    reader.append(frame(Continuation, "world"));
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), QByteArray("Hello world"));
+}
+
+void TestWebSocketFrameReader::maskedFrame()
+{
+    WebSocketFrameReader reader;
+    reader.append(frame(Text, "masked payload", true, false, QByteArray("\x12\x34\x56\x78", 4)));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), QByteArray("masked payload"));
+}
+
+void TestWebSocketFrameReader::compressedMessagesShareContext()
+{
+    WebSocketFrameReader reader;
+    reader.setDeflate(true, false);
+    Deflater deflater;
+
+    QByteArray first = R"({"event":"App\\Events\\ChatMessageEvent","data":"{\"content\":\"hello\"}"})";
+    QByteArray second = R"({"event":"App\\Events\\ChatMessageEvent","data":"{\"content\":\"again\"}"})";
+
+    reader.append(frame(Text, deflater.compress(first), true, true));
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), first);
+
+    // The second frame back-references the first one's text
+    QByteArray secondCompressed = deflater.compress(second);
+    QVERIFY(secondCompressed.size() < second.size() / 2);
+    reader.append(frame(Text, secondCompressed, true, true));
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), second);
+}
+
+void TestWebSocketFrameReader::compressedFragmentedMessage()
+{
+    WebSocketFrameReader reader;
+    reader.setDeflate(true, false);
+    Deflater deflater;
+
+    QByteArray message(5000, 'z');
+    QByteArray compressed = deflater.compress(message);
+    int half = compressed.size() / 2;
+
+    // RSV1 is only set on the first fragment
+    reader.append(frame(Text, compressed.left(half), false, true));
+    reader.append(frame(Continuation, compressed.mid(half)));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Message);
+    QCOMPARE(reader.payload(), message);
+}
+
+void TestWebSocketFrameReader::closeFrame()
+{
+    WebSocketFrameReader reader;
+    QByteArray status("\x03\xe8" "bye", 5);
+    reader.append(frame(Close, status) + frame(Text, "after close"));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Close);
+    QCOMPARE(reader.payload(), status);
+}
+
+void TestWebSocketFrameReader::rsv1OnControlFrame()
+{
+    WebSocketFrameReader reader;
+    reader.setDeflate(true, false);
+    reader.append(frame(Ping, "p", true, true));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Error);
+    QVERIFY(reader.errorString().contains("RSV1"));
+}
+
+void TestWebSocketFrameReader::rsv1WithoutNegotiation()
+{
+    WebSocketFrameReader reader;
+    reader.append(frame(Text, "not really compressed", true, true));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Error);
+}
+
+void TestWebSocketFrameReader::fragmentedControlFrame()
+{
+    WebSocketFrameReader reader;
+    reader.append(frame(Ping, "p", false));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Error);
+}
+
+void TestWebSocketFrameReader::oversizedControlFrame()
+{
+    WebSocketFrameReader reader;
+    reader.append(frame(Close, QByteArray(126, 'c')));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Error);
+}
+
+void TestWebSocketFrameReader::unexpectedContinuation()
+{
+    WebSocketFrameReader reader;
+    reader.append(frame(Continuation, "orphan"));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Error);
+}
+
+void TestWebSocketFrameReader::newMessageInsideFragmentedOne()
+{
+    WebSocketFrameReader reader;
+    reader.append(frame(Text, "first", false) + frame(Text, "second"));
+
+    QCOMPARE(reader.next(), WebSocketFrameReader::Error);
+}
+
+QTEST_GUILESS_MAIN(TestWebSocketFrameReader)
+#include "tst_websocketframereader.moc"